@@ -15,6 +15,16 @@
 #include <chrono>       // For std::chrono::milliseconds
 #include <cstdlib>      // For system() calls
 #include <cstdio>       // For snprintf function
+#include <cstring>      // For memcpy
+#include <functional>   // For std::function callbacks
+#include <mutex>        // For serialising service mode output
+#include <sstream>      // For splitting job lines
+#include <algorithm>    // For std::sort, std::min
+#include <limits>       // For infinity in the --compare table
+#include <memory>       // For std::unique_ptr
+#include <atomic>       // For the next index in threadParallelFor
+#include <exception>    // For passing errors out of worker threads
+#include <cerrno>       // For range errors from strtoul
 
 // Bella SDK includes - external libraries for 3D rendering
 #include "../bella_engine_sdk/src/bella_sdk/bella_engine.h" // For rendering and scene creation in Bella
@@ -31,6 +41,23 @@
 #include "../oom/oom_bella_misc.h"    // oomer's hlper code for bella misc code
 #include "../oom/oom_bella_engine.h"  // oomer's helper code for bella rendering
 
+// vox2bella's own helpers
+#include "vox2bella_vox.h"            // buffer based .vox chunk reader
+#include "vox2bella_convert.h"        // stepwise .vox to Bella conversion, also used by embedding programs
+#include "vox2bella_shm.h"            // shared-memory voxel input from a running editor
+#include "vox2bella_jobs.h"           // priority job queue for the service modes
+#include "vox2bella_metrics.h"        // Prometheus metrics for the long-running modes
+#include "vox2bella_usd.h"            // instanced .usda export
+#include "vox2bella_snapshot.h"       // progressive snapshots of long renders
+#include "vox2bella_compare.h"        // image comparison for the --compare harness
+#include "vox2bella_queue.h"          // shared-directory job queue for several nodes
+#include "vox2bella_prefork.h"        // forked worker processes for the service modes
+#include "vox2bella_orbit.h"          // orbit frames reprojected from rendered keyframes
+#include "vox2bella_impostor.h"       // impostor atlases from a grid of views
+#include "vox2bella_record.h"         // recording and replay of scene calls
+#include "vox2bella_corpus.h"         // synthetic .vox files for benchmarks
+#include "vox2bella_pack.h"           // tar and pack archives for batches of small files
+
 
 /*
 VOX File Format Structure Explanation:
@@ -52,374 +79,1403 @@ If a chunk has no sub-chunks, its "children bytes" value will be zero.
 The children bytes value tells the program how many bytes to skip if it's not concerned with child chunk data.
 */
 
-// Global variable to track if we've found a color palette in the file
-bool has_palette = false;
-
 // Forward declarations of functions - tells the compiler that these functions exist 
 // and will be defined later in the file
 std::string initializeGlobalLicense();
 std::string initializeGlobalThirdPartyLicences();
 
-// Struct: A custom data type that groups multiple variables together
-// This struct defines the header format for .vox files
-struct VoxHeader 
-{
-    char magic[4];    // "VOX " - Identifier string that marks a valid .vox file
-    uint32_t version; // Version number of the file format (uint32_t is a 32-bit unsigned integer)
-};
-
-// Struct for chunk headers in the .vox file
-// A chunk is a section of data in the file with a specific purpose
-struct ChunkHeader 
-{
-    char id[4];              // 4-character identifier for the chunk type (e.g., "SIZE", "XYZI")
-    uint32_t contentBytes;   // Number of bytes of content in this chunk
-    uint32_t childrenBytes;  // Number of bytes in child chunks
-};
-
-// Struct to store material properties from the .vox file
-struct Material {
-    int32_t materialId;  // ID number for this material
-    // This map stores various properties a material can have
-    // std::variant allows the value to be different types (string, float, or bool)
-    std::map<std::string, std::variant<std::string, float, bool>> properties;
-};
-
 // Function to print material properties to the console
 // The 'const' keyword means this function won't modify the material parameter
 // The '&' means the parameter is passed by reference (avoiding a copy of the data)
-void printMaterialProperties(const Material& matl) {
-    // For each property, check if it exists and print it if it does
-    // The 'count' method on a map returns how many items match the key (0 or 1)
-    if (matl.properties.count("_type") > 0 ) 
+void printMaterialProperties(const vox2bella::vox::Material& matl) {
+    using namespace vox2bella::vox;
+    // For each property, check if it was in the file and print it if it was
+    static const char* typeNames[] = { "_diffuse", "_metal", "_glass", "_emit", "_blend", "_media" };
+    if (matl.has(Key_type))   std::cout << "_type: "   << typeNames[matl.type] << std::endl;
+    if (matl.has(Key_weight)) std::cout << "_weight: " << matl.weight << std::endl;
+    if (matl.has(Key_rough))  std::cout << "_rough: "  << matl.rough << std::endl;
+    if (matl.has(Key_spec))   std::cout << "_spec: "   << matl.spec << std::endl;
+    if (matl.has(Key_ior))    std::cout << "_ior: "    << matl.ior << std::endl;
+    if (matl.has(Key_att))    std::cout << "_att: "    << matl.att << std::endl;
+    if (matl.has(Key_flux))   std::cout << "_flux: "   << matl.flux << std::endl;
+}
+
+// Observer class for monitoring scene events
+// This is a custom implementation of the SceneObserver interface from Bella SDK
+// The SceneObserver is called when various events occur in the scene
+struct Observer : public dl::bella_sdk::SceneObserver
+{   
+    bool inEventGroup = false; // Flag to track if we're in an event group
+        
+    // Override methods from SceneObserver to provide custom behavior
+    
+    // Called when a node is added to the scene
+    void onNodeAdded( dl::bella_sdk::Node node ) override
+    {   
+        dl::logInfo("%sNode added: %s", inEventGroup ? "  " : "", node.name().buf());
+    }
+    
+    // Called when a node is removed from the scene
+    void onNodeRemoved( dl::bella_sdk::Node node ) override
     {
-        // std::get<std::string> extracts the string value from the variant
-        std::cout << "_type: " << std::get<std::string>(matl.properties.at("_type")) << std::endl;
+        dl::logInfo("%sNode removed: %s", inEventGroup ? "  " : "", node.name().buf());
     }
-
-    if (matl.properties.count("_weight") > 0 )
+    
+    // Called when an input value changes
+    void onInputChanged( dl::bella_sdk::Input input ) override
     {
-        // Here we're extracting a float value from the variant
-        std::cout << "_weight: " << std::get<float>(matl.properties.at("_weight")) << std::endl;
+        dl::logInfo("%sInput changed: %s", inEventGroup ? "  " : "", input.path().buf());
     }
-
-    // Similar checks for other material properties
-    if (matl.properties.count("_rough") > 0 )
+    
+    // Called when an input is connected to something
+    void onInputConnected( dl::bella_sdk::Input input ) override
     {
-        std::cout << "_rough: " << std::get<float>(matl.properties.at("_rough")) << std::endl;
+        dl::logInfo("%sInput connected: %s", inEventGroup ? "  " : "", input.path().buf());
     }
-
-    if (matl.properties.count("_spec") > 0 )
+    
+    // Called at the start of a group of related events
+    void onBeginEventGroup() override
     {
-        std::cout << "_spec: " << std::get<float>(matl.properties.at("_spec")) << std::endl;
+        inEventGroup = true;
+        dl::logInfo("Event group begin.");
     }
-
-    if (matl.properties.count("_ior") > 0 )
+    
+    // Called at the end of a group of related events
+    void onEndEventGroup() override
     {
-        std::cout << "_ior: " << std::get<float>(matl.properties.at("_ior")) << std::endl;
+        inEventGroup = false;
+        dl::logInfo("Event group end.");
     }
+};
 
-    if (matl.properties.count("_att") > 0 )
+// Function to build the whole Bella scene for one input
+// Parameters:
+// - belScene: An empty scene with definitions loaded (the engine's scene, or a standalone one)
+// - filePath: The .vox file to read (ignored when shmSegment is given)
+// - voxPath: Used to name the render outputs
+// - shmSegment: An already opened shared-memory segment, or nullptr to read filePath
+// - options: Emit mode, model selection, crop box and the onModelDone callback
+// - voxelCount: Receives the number of voxels emitted, may be nullptr
+//
+// Returns false after printing the reason if the input could not be read
+// Long-running services use options.onModelDone as a safe point to pause low priority work
+bool buildScene( dl::bella_sdk::Scene belScene,
+                 const std::string& filePath,
+                 const std::filesystem::path& voxPath,
+                 vox2bella::shm::SegmentReader* shmSegment,
+                 const vox2bella::ConvertOptions& options,
+                 size_t* voxelCount
+               )
+{
+    if (!shmSegment)
     {
-        std::cout << "_att: " << std::get<float>(matl.properties.at("_att")) << std::endl;
+        // .vox files go through the same stepwise converter that embedding programs use,
+        // here without a time budget
+        vox2bella::Converter converter;
+        converter.begin(belScene, filePath, voxPath.stem().string(), options);
+        if (!converter.finish())
+            return false;
+        if (voxelCount) *voxelCount = converter.voxelCount();
+        return true;
     }
 
-    if (matl.properties.count("_flux") > 0 )
+    // Shared-memory input: convert straight from the mapped segment, no copy and no chunk parsing
+    if (options.emit != vox2bella::EmitInstanced)
+        std::cerr << "Warning: shared-memory input is always emitted as box instances" << std::endl;
+    if (options.model >= 0 || !options.modelName.empty())
+        std::cerr << "Warning: shared-memory input holds a single model, --model is ignored" << std::endl;
+    const vox2bella::Crop& crop = options.crop;
+    std::ostream& out = options.progress ? *options.progress : std::cout;
+
+    // The validated copy, the live header may change while the editor writes
+    const vox2bella::shm::SegmentHeader& shmHeader = shmSegment->header();
+    const uint8_t* payload = shmSegment->payload();
+    uint32_t palette[256];
+    std::memcpy(palette, vox2bella::vox::defaultPalette, sizeof(palette));
+    if (shmHeader.flags & vox2bella::shm::FlagHasPalette)
+        std::memcpy(palette, shmHeader.palette, sizeof(palette));
+
+    vox2bella::setupScene(belScene, voxPath.stem().string());
+    vox2bella::materials::MaterialSpec specs[256];
+    vox2bella::materials::mapPalette(palette, {}, specs);
+    dl::bella_sdk::Node materials[256];
+    vox2bella::createPaletteMaterials(belScene, specs, materials, options.record);
+    auto voxel = vox2bella::createVoxelBox(belScene, options.record);
+
+    vox2bella::Extents extents;
+    uint32_t numEmitted = 0;
+    auto emit = [&](uint8_t x, uint8_t y, uint8_t z, uint8_t colorIndex) {
+        if (crop.enabled && (x < crop.min[0] || x > crop.max[0] || y < crop.min[1] || y > crop.max[1] || z < crop.min[2] || z > crop.max[2]))
+            return;
+        extents.add(x, y, z);
+        vox2bella::emitVoxelInstance(belScene, voxel, materials[colorIndex], numEmitted++, x, y, z, options.record);
+    };
+
+    out << "Size: " << shmHeader.sizeX << "x" << shmHeader.sizeY << "x" << shmHeader.sizeZ << std::endl;
+    if (shmHeader.layout == vox2bella::shm::LayoutPackedXYZI)
+    {
+        out << "Number of Voxels: " << shmHeader.numVoxels << std::endl;
+        for (uint32_t i = 0; i < shmHeader.numVoxels; ++i) {
+            const uint8_t* xyzi = payload + i * 4;
+            emit(xyzi[0], xyzi[1], xyzi[2], xyzi[3]);
+        }
+    }
+    else
     {
-        std::cout << "_flux: " << std::get<float>(matl.properties.at("_flux")) << std::endl;
+        // Dense grid: one color index per cell, x fastest, 0 means empty
+        const uint32_t sizeX = shmHeader.sizeX, sizeY = shmHeader.sizeY, sizeZ = shmHeader.sizeZ;
+        for (uint32_t z = 0; z < sizeZ; ++z)
+            for (uint32_t y = 0; y < sizeY; ++y)
+            {
+                const uint8_t* row = payload + (size_t(z) * sizeY + y) * sizeX;
+                for (uint32_t x = 0; x < sizeX; ++x)
+                    if (row[x] != 0)
+                        emit(x, y, z, row[x]);
+            }
+        out << "Number of Voxels: " << numEmitted << std::endl;
     }
+    if (options.onModelDone) options.onModelDone();
+
+    if (!shmSegment->unchanged())
+        std::cerr << "Warning: the editor modified the shared-memory segment during conversion" << std::endl;
+    shmSegment->close();
+
+    vox2bella::frameCamera(belScene, extents, options.record, out);
+    if (options.preset) vox2bella::applyRenderPreset(belScene, *options.preset, nullptr, options.record);
+    if (voxelCount) *voxelCount = numEmitted;
+    return true;
 }
 
-// Default color palette used if a .vox file doesn't provide its own
-// This is an array of 256 unsigned integers, where each integer represents an RGBA color
-// Format: 0xAARRGGBB (Alpha, Red, Green, Blue)
-unsigned int palette[256] = {
-    0x00000000, 0xffffffff, 0xffccffff, 0xff99ffff, 0xff66ffff, 0xff33ffff, 0xff00ffff, 0xffffccff, 0xffccccff, 0xff99ccff, 0xff66ccff, 0xff33ccff, 0xff00ccff, 0xffff99ff, 0xffcc99ff, 0xff9999ff,
-    0xff6699ff, 0xff3399ff, 0xff0099ff, 0xffff66ff, 0xffcc66ff, 0xff9966ff, 0xff6666ff, 0xff3366ff, 0xff0066ff, 0xffff33ff, 0xffcc33ff, 0xff9933ff, 0xff6633ff, 0xff3333ff, 0xff0033ff, 0xffff00ff,
-    0xffcc00ff, 0xff9900ff, 0xff6600ff, 0xff3300ff, 0xff0000ff, 0xffffffcc, 0xffccffcc, 0xff99ffcc, 0xff66ffcc, 0xff33ffcc, 0xff00ffcc, 0xffffcccc, 0xffcccccc, 0xff99cccc, 0xff66cccc, 0xff33cccc,
-    0xff00cccc, 0xffff99cc, 0xffcc99cc, 0xff9999cc, 0xff6699cc, 0xff3399cc, 0xff0099cc, 0xffff66cc, 0xffcc66cc, 0xff9966cc, 0xff6666cc, 0xff3366cc, 0xff0066cc, 0xffff33cc, 0xffcc33cc, 0xff9933cc,
-    0xff6633cc, 0xff3333cc, 0xff0033cc, 0xffff00cc, 0xffcc00cc, 0xff9900cc, 0xff6600cc, 0xff3300cc, 0xff0000cc, 0xffffff99, 0xffccff99, 0xff99ff99, 0xff66ff99, 0xff33ff99, 0xff00ff99, 0xffffcc99,
-    0xffcccc99, 0xff99cc99, 0xff66cc99, 0xff33cc99, 0xff00cc99, 0xffff9999, 0xffcc9999, 0xff999999, 0xff669999, 0xff339999, 0xff009999, 0xffff6699, 0xffcc6699, 0xff996699, 0xff666699, 0xff336699,
-    0xff006699, 0xffff3399, 0xffcc3399, 0xff993399, 0xff663399, 0xff333399, 0xff003399, 0xffff0099, 0xffcc0099, 0xff990099, 0xff660099, 0xff330099, 0xff000099, 0xffffff66, 0xffccff66, 0xff99ff66,
-    0xff66ff66, 0xff33ff66, 0xff00ff66, 0xffffcc66, 0xffcccc66, 0xff99cc66, 0xff66cc66, 0xff33cc66, 0xff00cc66, 0xffff9966, 0xffcc9966, 0xff999966, 0xff669966, 0xff339966, 0xff009966, 0xffff6666,
-    0xffcc6666, 0xff996666, 0xff666666, 0xff336666, 0xff006666, 0xffff3366, 0xffcc3366, 0xff993366, 0xff663366, 0xff333366, 0xff003366, 0xffff0066, 0xffcc0066, 0xff990066, 0xff660066, 0xff330066,
-    0xff000066, 0xffffff33, 0xffccff33, 0xff99ff33, 0xff66ff33, 0xff33ff33, 0xff00ff33, 0xffffcc33, 0xffcccc33, 0xff99cc33, 0xff66cc33, 0xff33cc33, 0xff00cc33, 0xffff9933, 0xffcc9933, 0xff999933,
-    0xff669933, 0xff339933, 0xff009933, 0xffff6633, 0xffcc6633, 0xff996633, 0xff666633, 0xff336633, 0xff006633, 0xffff3333, 0xffcc3333, 0xff993333, 0xff663333, 0xff333333, 0xff003333, 0xffff0033,
-    0xffcc0033, 0xff990033, 0xff660033, 0xff330033, 0xff000033, 0xffffff00, 0xffccff00, 0xff99ff00, 0xff66ff00, 0xff33ff00, 0xff00ff00, 0xffffcc00, 0xffcccc00, 0xff99cc00, 0xff66cc00, 0xff33cc00,
-    0xff00cc00, 0xffff9900, 0xffcc9900, 0xff999900, 0xff669900, 0xff339900, 0xff009900, 0xffff6600, 0xffcc6600, 0xff996600, 0xff666600, 0xff336600, 0xff006600, 0xffff3300, 0xffcc3300, 0xff993300,
-    0xff663300, 0xff333300, 0xff003300, 0xffff0000, 0xffcc0000, 0xff990000, 0xff660000, 0xff330000, 0xff0000ee, 0xff0000dd, 0xff0000bb, 0xff0000aa, 0xff000088, 0xff000077, 0xff000055, 0xff000044,
-    0xff000022, 0xff000011, 0xff00ee00, 0xff00dd00, 0xff00bb00, 0xff00aa00, 0xff008800, 0xff007700, 0xff005500, 0xff004400, 0xff002200, 0xff001100, 0xffee0000, 0xffdd0000, 0xffbb0000, 0xffaa0000,
-    0xff880000, 0xff770000, 0xff550000, 0xff440000, 0xff220000, 0xff110000, 0xffeeeeee, 0xffdddddd, 0xffbbbbbb, 0xffaaaaaa, 0xff888888, 0xff777777, 0xff555555, 0xff444444, 0xff222222, 0xff111111
-};
+// Function to run fn(0) .. fn(count - 1) on one thread per core, for conversions run
+// from the command line. An exception from fn is rethrown once all threads are done.
+void threadParallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+    std::atomic<size_t> next{ 0 };
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto work = [&] {
+        for (size_t i; (i = next.fetch_add(1)) < count;)
+        {
+            try { fn(i); }
+            catch (...) { std::lock_guard<std::mutex> lock(errorMutex); if (!error) error = std::current_exception(); }
+        }
+    };
+    unsigned helpers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count) - 1;
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < helpers; ++t) threads.emplace_back(work);
+    work();
+    for (std::thread& t : threads) t.join();
+    if (error) std::rethrow_exception(error);
+}
 
-// Commented out: Alternative way to store the voxel palette
-//std::vector<uint8_t> voxelPalette;
+// Function to parse a whole number 0..max written in decimal digits only (no sign or spaces)
+bool parseUnsigned(const std::string& text, unsigned long max, unsigned long& value)
+{
+    if (text.empty() || text[0] < '0' || text[0] > '9') return false;
+    errno = 0;
+    char* end = nullptr;
+    value = std::strtoul(text.c_str(), &end, 10);
+    return errno == 0 && *end == '\0' && value <= max;
+}
 
-// Function to read a chunk from the .vox file
-// Parameters:
-// - file: Reference to the input file stream 
-// - palette: Array of colors
-// - voxelPalette: Vector to store color indices for each voxel
-// - sceneWrite: The Bella scene being created
-// - voxel: A node representing a voxel in the scene
-//
-// This function is recursively callable, meaning it can call itself to handle nested chunks
-void readChunk( std::ifstream& file, 
-                unsigned int (&palette)[256],
-                std::vector<uint8_t> (&voxelPalette),
-                dl::bella_sdk::Scene belScene,
-                dl::bella_sdk::Node voxel,
-                uint8_t& minX, uint8_t& minY, uint8_t& minZ,
-                uint8_t& maxX, uint8_t& maxY, uint8_t& maxZ,
-                bool& hasVoxels
-              ) 
+// Function to read the --emit, --model, --crop, --quality and --noautorender options
+// Returns false after printing the reason if one of them is malformed
+bool argConvertOptions(dl::Args& args, vox2bella::ConvertOptions& options)
 {
-    // Read the chunk header from the file
-    ChunkHeader chunkHeader;
-    // reinterpret_cast is a C++ feature that converts one pointer type to another
-    // It's used here to treat the ChunkHeader struct as a sequence of bytes for reading
-    file.read(reinterpret_cast<char*>(&chunkHeader), sizeof(ChunkHeader));
-
-    // Convert the 4-character ID to a string for easier comparison
-    std::string chunkId(chunkHeader.id, 4);
-    // Debug print statements (commented out)
-    //std::cout << "Chunk ID: " << chunkId << std::endl;
-    //std::cout << "Content Bytes: " << chunkHeader.contentBytes << std::endl;
-    //std::cout << "Children Bytes: " << chunkHeader.childrenBytes << std::endl;
-
-    // Create a vector to store the chunk content
-    // 'content' is a dynamic array that will hold all the data in this chunk
-    std::vector<uint8_t> content(chunkHeader.contentBytes);
-    file.read(reinterpret_cast<char*>(content.data()), chunkHeader.contentBytes);
-    
-    // Process the chunk based on its ID
-    // Different chunk types contain different data and need special handling
-    
-    /* Commented out PACK chunk handling
-    if (chunkId == "PACK") 
+    if (args.have("--emit")) {
+        std::string emit = args.value("--emit").buf();
+        if (emit == "mesh") options.emit = vox2bella::EmitMesh;
+        else if (emit == "world") options.emit = vox2bella::EmitWorld;
+        else if (emit != "instanced") {
+            std::cerr << "Error: --emit expects instanced, mesh or world, got '" << emit << "'" << std::endl;
+            return false;
+        }
+    }
+
+    if (args.have("--model"))
     {
-        uint32_t packSize = *reinterpret_cast<uint32_t*>(content.data());
-        std::cout << packSize << std::endl;
-    */
-    
-    if (chunkId == "SIZE") 
-    {
-        // SIZE chunk contains the dimensions of the voxel model (width, height, depth)
-        // Read the XYZ size values from the content bytes
-        uint32_t x = *reinterpret_cast<uint32_t*>(content.data());
-        uint32_t y = *reinterpret_cast<uint32_t*>(content.data() + 4);
-        uint32_t z = *reinterpret_cast<uint32_t*>(content.data() + 8);
-        std::cout << "Size: " << x << "x" << y << "x" << z << std::endl;
-    } 
-    else if (chunkId == "XYZI") 
-    {
-        // XYZI chunk contains the voxel data - locations and colors of each voxel
-        // First 4 bytes contain the number of voxels
-        uint32_t numVoxels = *reinterpret_cast<uint32_t*>(content.data());
-        std::cout << "Number of Voxels: " << numVoxels << std::endl;
-
-        // Process each voxel
-        // The voxel data is stored as a sequence of (x,y,z,colorIndex) values
-        auto groupxform = belScene.createNode("xform", "group", "group");
-        groupxform.parentTo(belScene.world());
-        dl::Mat4 xformMatrix1 = dl::Mat4 { 0, -1, 0, 0, 
-                                          1, 0, 0, 0, 
-                                          0, 0, 1, 0, 
-                                          0, 0, 0, 1};
-        groupxform["steps"][0]["xform"] = xformMatrix1;
-        for (uint32_t i = 0; i < numVoxels; ++i) {
-            
-            // Read voxel position (x,y,z) and color index
-            // +4 offset is because the first 4 bytes contain numVoxels
-            uint8_t x = content[4 + (i * 4) + 0];
-            uint8_t y = content[4 + (i * 4) + 1];
-            uint8_t z = content[4 + (i * 4) + 2];
-            uint8_t colorIndex = content[4 + (i * 4) + 3];
-            
-            // Update extents for camera positioning
-            if (!hasVoxels) {
-                // First voxel - initialize min/max
-                minX = maxX = x;
-                minY = maxY = y;
-                minZ = maxZ = z;
-                hasVoxels = true;
-            } else {
-                // Update min/max values
-                if (x < minX) minX = x;
-                if (x > maxX) maxX = x;
-                if (y < minY) minY = y;
-                if (y > maxY) maxY = y;
-                if (z < minZ) minZ = z;
-                if (z > maxZ) maxZ = z;
-            } 
-            
-            // Create a unique name for this voxel's transform node
-            dl::String voxXformName = dl::String("voxXform") + dl::String(i);
-            // Create a transform node in the Bella scene
-            auto xform = belScene.createNode("xform", voxXformName, voxXformName);
-            // Set this transform's parent to the world root
-            //xform.parentTo(groupxform);
-            xform.parentTo(belScene.world());
-            // Parent the voxel geometry to this transform
-            voxel.parentTo(xform);
-            // Set the transform matrix to position the voxel at (x,y,z)
-            // This is a 4x4 transformation matrix - standard in 3D graphics
-            xform["steps"][0]["xform"] = dl::Mat4 { 1, 0, 0, 0, 
-                                                0, 1, 0, 0, 
-                                                0, 0, 1, 0, 
-                                                static_cast<double>(x*1), 
-                                                static_cast<double>(y*1), 
-                                                static_cast<double>(z*1), 1};
-            // Store the color index for this voxel
-            voxelPalette.push_back(colorIndex);
+        // A number selects a model by index, anything else is a transform name from the scene graph
+        std::string model = args.value("--model").buf();
+        if (!model.empty() && model.find_first_not_of("0123456789") == std::string::npos)
+        {
+            unsigned long index = 0;
+            if (!parseUnsigned(model, std::numeric_limits<int>::max(), index)) {
+                std::cerr << "Error: --model index " << model << " is too large" << std::endl;
+                return false;
+            }
+            options.model = static_cast<int>(index);
         }
-    } 
-    // Basic recognition of other chunk types - just printing their names
-    else if (chunkId == "rCAM")
+        else if (model.size() > 1 && model[0] == '-' && model.find_first_not_of("0123456789", 1) == std::string::npos)
+        {
+            std::cerr << "Error: --model index must not be negative" << std::endl;
+            return false;
+        }
+        else
+            options.modelName = model;
+    }
+
+    if (args.have("--crop") && !vox2bella::parseCrop(args.value("--crop").buf(), options.crop))
     {
-        std::cout << "rCAM" << std::endl; // Camera settings chunk
-    } 
-    else if (chunkId == "PACK")
+        std::cerr << "Error: --crop expects x0,y0,z0:x1,y1,z1 with coordinates 0..255" << std::endl;
+        return false;
+    }
+
+    if (args.have("--quality"))
     {
-        std::cout << "PACK" << std::endl; // Pack chunk (number of models)
-    } 
-    else if (chunkId == "rOBJ")
+        options.preset = vox2bella::findRenderPreset(args.value("--quality").buf());
+        if (!options.preset) {
+            std::cerr << "Error: --quality must be draft, review or final" << std::endl;
+            return false;
+        }
+    }
+    if (args.have("--noautorender"))
+        options.autoRender = false;
+    return true;
+}
+
+// Function to convert one .vox file into a scene that has its definitions loaded
+// and write it as a .bsz file
+bool convertInto(dl::bella_sdk::Scene belScene, const std::string& voxFile, const std::string& bszFile,
+                 const vox2bella::ConvertOptions& options, size_t* voxelCount)
+{
+    if (!buildScene(belScene, voxFile, std::filesystem::path(voxFile), nullptr, options, voxelCount))
+        return false;
+    return belScene.write(dl::String(bszFile.c_str()));
+}
+
+// Function to convert a .vox file held in memory to a .bsz file in its own standalone scene
+// 'name' is the file's name, used to name the render outputs
+bool convertBytes(const std::vector<uint8_t>& vox, const std::string& name, const std::string& bszFile,
+                  const vox2bella::ConvertOptions& options, size_t* voxelCount)
+{
+    dl::bella_sdk::Scene belScene;
+    belScene.loadDefs();
+    vox2bella::Converter converter;
+    converter.begin(belScene, vox.data(), vox.size(), std::filesystem::path(name).stem().string(), options);
+    if (!converter.finish())
+        return false;
+    if (voxelCount) *voxelCount = converter.voxelCount();
+    return belScene.write(dl::String(bszFile.c_str()));
+}
+
+// Function to convert one .vox file to a .bsz file in its own standalone scene
+// Used by the service modes, which run several of these at the same time
+bool convertFile(const std::string& voxFile, const std::string& bszFile, const vox2bella::ConvertOptions& options, size_t* voxelCount)
+{
+    dl::bella_sdk::Scene belScene;
+    belScene.loadDefs();
+    return convertInto(belScene, voxFile, bszFile, options, voxelCount);
+}
+
+// Function to write a .vox file as a .usda next to it
+// Returns false after printing the reason if the file could not be read or written
+bool exportUsd(const std::string& voxFile, const std::filesystem::path& voxPath)
+{
+    std::ifstream file(voxFile, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file." << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    vox2bella::vox::ChunkParser parser;
+    std::string error;
+    bool ok = parser.begin(data.data(), data.size(), error);
+    while (ok && !parser.done())
+        ok = parser.parse(SIZE_MAX, error);
+
+    std::filesystem::path usdPath = voxPath;
+    usdPath.replace_extension(".usda");
+    if (ok)
+        ok = vox2bella::usd::writeUsda(usdPath.string(), parser, data.data(), voxPath.filename().string(), error);
+    if (!ok) {
+        std::cerr << "Error: " << error << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << usdPath.string() << ": " << parser.models.size() << " models" << std::endl;
+    return true;
+}
+
+// Numeric options and the values they accept, an empty value keeps the default
+struct NumberArg
+{
+    const char* name;
+    unsigned long min, max;
+};
+const unsigned long anyUnsigned = std::numeric_limits<unsigned>::max();
+const NumberArg numberArgs[] = {
+    { "--orbit", 1, std::numeric_limits<int>::max() },
+    { "--orbitkey", 0, anyUnsigned },
+    { "--orbitdisocclusion", 0, 100 },
+    { "--impostortile", 1, 4096 },
+    { "--proxy", 0, anyUnsigned },
+    { "--snapshotinterval", 0, anyUnsigned },
+    { "--snapshotupdates", 0, anyUnsigned },
+    { "--compareres", 0, anyUnsigned },
+    { "--psnrmin", 0, anyUnsigned },
+    { "--ssimmin", 0, 100 },
+    { "--workers", 0, anyUnsigned },
+    { "--interactivelimit", 0, anyUnsigned },
+    { "--batchlimit", 0, anyUnsigned },
+    { "--lease", 0, anyUnsigned },
+    { "--splitvoxels", 0, anyUnsigned },
+    { "--metricsinterval", 0, anyUnsigned },
+    { "--metricsport", 0, 65535 },
+    { "--replayruns", 0, anyUnsigned },
+    { "--scalebench", 0, anyUnsigned },
+    { "--scalejobs", 0, anyUnsigned },
+};
+
+// Function to check every numeric option that was given before any mode starts
+// Returns false after printing the first malformed or out of range one
+bool checkNumberArgs(dl::Args& args)
+{
+    for (const NumberArg& arg : numberArgs)
     {
-        std::cout << "rOBJ" << std::endl; // Rendering settings
-    } 
-    else if (chunkId == "nTRN")
+        if (!args.have(arg.name)) continue;
+        std::string text = args.value(arg.name).buf();
+        unsigned long value = 0;
+        if (text.empty()) continue;
+        if (!parseUnsigned(text, arg.max, value) || value < arg.min) {
+            std::cerr << "Error: " << arg.name << " expects a whole number from " << arg.min << " to " << arg.max << ", got '" << text << "'" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to read an unsigned number option, keeping 'fallback' if it's missing, empty or 0
+// The value has been checked by checkNumberArgs() already
+unsigned argUnsigned(dl::Args& args, const char* name, unsigned fallback)
+{
+    unsigned long value = 0;
+    if (!args.have(name) || !parseUnsigned(args.value(name).buf(), anyUnsigned, value)) return fallback;
+    return value > 0 ? static_cast<unsigned>(value) : fallback;
+}
+
+// Function to estimate the work of converting a file without opening it: a record is
+// 4 bytes, so its size bounds the voxel count (0 if it can't be read)
+uint64_t estimateCost(const std::string& input)
+{
+    std::error_code ec;
+    const uintmax_t bytes = std::filesystem::file_size(input, ec);
+    return ec ? 0 : uint64_t(bytes) / 4;
+}
+
+// Function to read a service job line "interactive|batch <in.vox> [out.bsz]"
+// Without an output the .bsz goes to the current directory like the single file mode
+bool parseJobLine(const std::string& line, vox2bella::jobs::Priority& priority, std::string& input, std::string& output)
+{
+    std::istringstream fields(line);
+    std::string cls;
+    if (!(fields >> cls) || !vox2bella::jobs::parsePriority(cls, priority) || !(fields >> input)) return false;
+    if (!(fields >> output)) output = std::filesystem::path(input).stem().string() + ".bsz";
+    return true;
+}
+
+// Function to collect the .vox files named by --batch or --queueadd: a directory's
+// .vox files, or a single file
+// Returns false after printing the reason if the directory can't be read
+bool listVoxFiles(const std::filesystem::path& path, std::vector<std::filesystem::path>& files)
+{
+    if (!std::filesystem::is_directory(path)) {
+        files.push_back(path);
+        return true;
+    }
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(path, ec))
+        if (entry.path().extension() == ".vox") files.push_back(entry.path());
+    if (ec) {
+        std::cerr << "Error: cannot read directory " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to add jobs to the shared queue named by --jobqueue, outputs go next to the inputs
+// Paths are made absolute so workers started from other directories find them
+int runQueueAdd(dl::Args& args)
+{
+    if (!args.have("--jobqueue")) {
+        std::cerr << "Error: --queueadd needs --jobqueue" << std::endl;
+        return 1;
+    }
+    vox2bella::queue::SharedQueue sharedQueue;
+    std::string error;
+    if (!sharedQueue.open(args.value("--jobqueue").buf(), argUnsigned(args, "--lease", 60), error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    std::vector<std::filesystem::path> files;
+    if (!listVoxFiles(args.value("--queueadd").buf(), files)) return 1;
+    unsigned added = 0;
+    for (const std::filesystem::path& file : files)
     {
-        std::cout << "nTRN" << std::endl; // Node transform
-    } 
-    else if (chunkId == "nGRP")
+        std::filesystem::path input = std::filesystem::absolute(file);
+        std::filesystem::path output = input;
+        output.replace_extension(".bsz");
+        if (!sharedQueue.add(input.string(), output.string(), estimateCost(input.string()), error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        ++added;
+    }
+    std::cout << "Queued " << added << " jobs in " << args.value("--jobqueue").buf() << std::endl;
+    return 0;
+}
+
+// Runs the conversions of a synthetic corpus (vox2bella_corpus.h) with 1 to
+// --scalejobs of them at once in this process, each into its own scene, and prints
+// throughput and latency per level. Every conversion is recorded, and its scene
+// calls must match those of the serial run. Returns 1 on a mismatch or failure.
+int runScaling(dl::Args& args)
+{
+    const unsigned count = args.value("--scalebench").isEmpty() ? 32 : argUnsigned(args, "--scalebench", 32);
+    const unsigned maxJobs = argUnsigned(args, "--scalejobs", std::max(1u, std::thread::hardware_concurrency()));
+    vox2bella::ConvertOptions options;
+    if (!argConvertOptions(args, options)) return 1;
+    const std::vector<vox2bella::corpus::SyntheticFile> corpus = vox2bella::corpus::generate(count);
+    uint64_t corpusVoxels = 0;
+    for (const auto& file : corpus) corpusVoxels += file.voxels;
+
+    // Converts one file and hashes (FNV-1a) the scene calls it made. Every scene call
+    // of the converter goes through record::RecordingScene, so the log is the scene.
+    auto convert = [&](const vox2bella::corpus::SyntheticFile& file, uint64_t& hash) {
+        dl::bella_sdk::Scene belScene;
+        belScene.loadDefs();
+        vox2bella::record::SceneLog log;
+        vox2bella::ConvertOptions jobOptions = options;
+        jobOptions.record = &log;
+        vox2bella::Converter converter;
+        converter.begin(belScene, file.data.data(), file.data.size(), std::filesystem::path(file.name).stem().string(), jobOptions);
+        if (!converter.finish()) return false;
+        hash = 14695981039346656037ull;
+        for (uint8_t b : log.data()) hash = (hash ^ b) * 1099511628211ull;
+        return true;
+    };
+
+    // The converter reports every file on stdout, which is silenced while a level runs
+    struct NullBuffer : std::streambuf { int overflow(int c) override { return c; } } nullBuffer;
+    std::streambuf* console = std::cout.rdbuf();
+
+    std::cout << "Scaling: " << corpus.size() << " synthetic files, " << corpusVoxels << " voxels, 1 to " << maxJobs
+              << " conversions at once" << std::endl;
+    std::printf("%5s %9s %9s %8s %9s %9s %9s %10s\n", "jobs", "files/s", "Mvox/s", "speedup", "p50 ms", "p95 ms", "max ms", "mismatch");
+    std::vector<uint64_t> serial(corpus.size(), 0);
+    double serialRate = 0.0;
+    int result = 0;
+    for (unsigned jobs = 1; jobs <= maxJobs; ++jobs)
     {
-        std::cout << "nGRP" << std::endl; // Node group
-    } 
-    else if (chunkId == "nSHP")
+        std::vector<uint64_t> hashes(corpus.size(), 0);
+        std::vector<double> latency(corpus.size(), 0.0);
+        std::atomic<size_t> next{ 0 };
+        std::atomic<unsigned> failed{ 0 };
+        std::cout.rdbuf(&nullBuffer);
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < jobs; ++t)
+            threads.emplace_back([&] {
+                for (size_t i = next++; i < corpus.size(); i = next++)
+                {
+                    const auto jobStart = std::chrono::steady_clock::now();
+                    if (!convert(corpus[i], hashes[i])) ++failed;
+                    latency[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - jobStart).count();
+                }
+            });
+        for (std::thread& thread : threads) thread.join();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout.rdbuf(console);
+
+        if (jobs == 1) {
+            serial = hashes;
+            serialRate = corpus.size() / seconds;
+        }
+        size_t mismatches = 0;
+        for (size_t i = 0; i < corpus.size(); ++i)
+            if (hashes[i] != serial[i]) ++mismatches;
+        std::sort(latency.begin(), latency.end());
+        // Nearest rank: the smallest latency at least p of the files stay within
+        auto percentile = [&](double p) {
+            if (latency.empty()) return 0.0;
+            const size_t rank = size_t(std::ceil(p * double(latency.size())));
+            return latency[std::min(latency.size(), std::max<size_t>(rank, 1)) - 1] * 1000.0;
+        };
+        const double rate = corpus.size() / seconds;
+        std::printf("%5u %9.1f %9.2f %7.2fx %9.1f %9.1f %9.1f %10zu\n", jobs, rate, corpusVoxels / seconds / 1e6,
+                    serialRate > 0 ? rate / serialRate : 0.0, percentile(0.5), percentile(0.95), percentile(1.0), mismatches);
+        if (failed || mismatches) {
+            std::cerr << "Error: " << failed << " conversions failed, " << mismatches << " differ from the serial run with " << jobs << " at once" << std::endl;
+            result = 1;
+        }
+    }
+    return result;
+}
+
+// Lists (--packlist) or extracts (--packextract, into the current directory) the
+// entries of a pack written by --packout, or of a tar file
+int runPack(dl::Args& args)
+{
+    const bool extract = args.have("--packextract");
+    const std::string path = args.value(extract ? "--packextract" : "--packlist").buf();
+    vox2bella::pack::ArchiveReader archive;
+    std::string error;
+    if (!archive.open(path, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    uint64_t total = 0;
+    int result = 0;
+    for (const vox2bella::pack::Entry& entry : archive.entries())
     {
-        std::cout << "nSHP" << std::endl; // Node shape
-    } 
-    else if (chunkId == "MATL")
+        total += entry.size;
+        if (!extract) {
+            std::cout << entry.size << "\t" << entry.name << std::endl;
+            continue;
+        }
+        if (vox2bella::pack::unsafeName(entry.name)) {
+            std::cerr << "Warning: skipping " << entry.name << ", it would land outside the current directory" << std::endl;
+            continue;
+        }
+        // Read first, so an entry that can't be read leaves no empty file behind
+        std::vector<uint8_t> bytes;
+        if (!archive.read(entry, bytes, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            result = 1;
+            continue;
+        }
+        std::filesystem::path out(entry.name);
+        std::error_code ec;
+        if (out.has_parent_path()) std::filesystem::create_directories(out.parent_path(), ec);
+        std::ofstream file(out, std::ios::binary);
+        if (!file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()))) {
+            std::cerr << "Error: cannot write " << entry.name << std::endl;
+            result = 1;
+        }
+    }
+    std::cout << archive.entries().size() << " entries, " << total << " bytes" << (extract ? " extracted" : "") << std::endl;
+    return result;
+}
+
+// Function to start publishing metrics if --metricsfile or --metricsport was given
+// Returns false after printing the reason if the socket could not be opened
+bool startMetrics(dl::Args& args, vox2bella::metrics::Exporter& exporter)
+{
+    std::string metricsFile = args.have("--metricsfile") ? args.value("--metricsfile").buf() : "";
+    int port = static_cast<int>(argUnsigned(args, "--metricsport", 0));
+    if (metricsFile.empty() && port == 0) return true;
+
+    double interval = argUnsigned(args, "--metricsinterval", 10);
+    std::string error;
+    if (!exporter.start(metricsFile, interval, port, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to time one engine render and record it in the metrics
+// With a snapshotter, progressive snapshots are written while waiting and once more at the end
+void renderAndWait(dl::bella_sdk::Engine& engine, vox2bella::snapshot::Snapshotter* snapshots = nullptr)
+{
+    auto start = std::chrono::steady_clock::now();
+    if (snapshots) snapshots->reset();
+    engine.start();
+    while(engine.rendering()) { 
+        if (snapshots) {
+            // Wake up more often so snapshots appear close to when they were due
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            if (snapshots->writePending())
+                std::cout << "Snapshot written to " << snapshots->path() << std::endl;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        }
+    }
+    if (snapshots) snapshots->writePending(true);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    vox2bella::metrics::Registry::global().observe("vox2bella_render_seconds", "", seconds);
+}
+
+// Function to render an orbit of numFrames frames as frame_%04d.png, only every keyEvery-th
+// frame (and the last) through the engine. The frames in between are reprojected from the
+// two rendered keyframes around them, see vox2bella_orbit.h. A frame with more than
+// maxDisoccluded of its voxel pixels hidden in both keyframes is rendered instead.
+// The first reprojected frame is also rendered and compared; below psnrMin dB every
+// remaining frame is rendered, which also catches a lens the reprojection doesn't model.
+bool renderInterpolatedOrbit(dl::bella_sdk::Engine& engine, int numFrames, int keyEvery,
+                             const vox2bella::orbit::VoxelWorld& world, double maxDisoccluded, double psnrMin)
+{
+    auto belScene = engine.scene();
+    auto belCameraXform = belScene.cameraPath().parent();
+
+    // The same cumulative orbit steps as a fully rendered orbit, recorded per frame
+    std::vector<dl::Mat4> matrices;
+    for (int i = 0; i < numFrames; i++) {
+        dl::bella_sdk::orbitCamera(belScene.cameraPath(), dl::Vec2 {i*0.05, 0.0});
+        matrices.push_back(belCameraXform["steps"][0]["xform"].asMat4());
+    }
+
+    // Without a field of view or voxels there is nothing to reproject with
+    double fov = belScene.camera()["lens"].asNode()["steps"][0]["fov"].asReal();
+    if (fov <= 0 || world.empty()) {
+        std::cout << "Warning: cannot reproject this camera, rendering every frame" << std::endl;
+        keyEvery = 1;
+    }
+
+    vox2bella::snapshot::Snapshotter image("", 0, 0);
+    engine.subscribe(&image);
+    int rendered = 0, reprojected = 0;
+
+    // Renders frame i and writes it, 'key' receives the image and its camera
+    auto renderFrame = [&](int i, vox2bella::orbit::Keyframe& key) {
+        std::cout << "📹 Rendering frame " << (i + 1) << "/" << numFrames << std::endl;
+        {
+            dl::bella_sdk::Scene::EventScope es(belScene);
+            belCameraXform["steps"][0]["xform"] = matrices[i];
+        }
+        belScene.beautyPass()["outputName"] = dl::String::format("frame_%04d", i);
+        renderAndWait(engine, &image);
+        uint32_t width = 0, height = 0;
+        if (!image.latest(key.rgba, width, height)) {
+            std::cerr << "Error: no image rendered for orbit frame " << (i + 1) << std::endl;
+            return false;
+        }
+        double m[16];
+        for (int k = 0; k < 16; ++k) m[k] = matrices[i][k];
+        key.camera = vox2bella::orbit::Camera::fromMatrix(m, fov, width, height);
+        char name[32];
+        snprintf(name, sizeof(name), "frame_%04d.png", i);
+        vox2bella::snapshot::writePng(name, key.rgba.data(), width, height);
+        ++rendered;
+        return true;
+    };
+
+    // Keyframes: every keyEvery-th frame, and the last one so every frame lies between two
+    std::vector<int> keys;
+    for (int i = 0; i < numFrames; i += keyEvery) keys.push_back(i);
+    if (keys.back() != numFrames - 1) keys.push_back(numFrames - 1);
+
+    bool reproject = keyEvery > 1, checked = false, ok = true;
+    vox2bella::orbit::Keyframe a, b, frame;
+    ok = renderFrame(keys[0], a);
+    if (ok && reproject) vox2bella::orbit::traceIds(world, a);
+    for (size_t s = 1; ok && s < keys.size(); ++s)
     {
-        // MATL chunk contains material definitions
-        Material material;
-        size_t offset = 0;
+        if (!(ok = renderFrame(keys[s], b))) break;
+        if (reproject) vox2bella::orbit::traceIds(world, b);
+        for (int i = keys[s - 1] + 1; ok && i < keys[s]; ++i)
+        {
+            if (reproject)
+            {
+                double m[16];
+                for (int k = 0; k < 16; ++k) m[k] = matrices[i][k];
+                auto camera = vox2bella::orbit::Camera::fromMatrix(m, fov, a.camera.width, a.camera.height);
+                double t = double(i - keys[s - 1]) / double(keys[s] - keys[s - 1]);
+                std::vector<uint8_t> pixels;
+                double disoccluded = vox2bella::orbit::synthesize(world, a, b, camera, t, pixels);
+                if (disoccluded <= maxDisoccluded && !checked)
+                {
+                    // Self-check against the real frame, which is then kept
+                    checked = true;
+                    if (!(ok = renderFrame(i, frame))) break;
+                    double psnr = frame.rgba.size() == pixels.size()
+                                ? vox2bella::compare::psnr(frame.rgba.data(), pixels.data(), camera.width, camera.height) : 0.0;
+                    std::cout << "Reprojection check on frame " << (i + 1) << ": " << psnr << " dB" << std::endl;
+                    if (psnr < psnrMin) {
+                        std::cout << "Warning: reprojected frames fall below " << psnrMin << " dB, rendering every frame" << std::endl;
+                        reproject = false;
+                    }
+                    continue;
+                }
+                if (disoccluded <= maxDisoccluded)
+                {
+                    char name[32];
+                    snprintf(name, sizeof(name), "frame_%04d.png", i);
+                    vox2bella::snapshot::writePng(name, pixels.data(), camera.width, camera.height);
+                    std::cout << "🧩 Frame " << (i + 1) << " reprojected (" << disoccluded * 100.0 << "% disoccluded)" << std::endl;
+                    ++reprojected;
+                    continue;
+                }
+            }
+            ok = renderFrame(i, frame);
+        }
+        std::swap(a, b);
+    }
+    engine.unsubscribe(&image);
+    std::cout << rendered << " frames rendered, " << reprojected << " reprojected" << std::endl;
+    return ok;
+}
 
-        // Read material ID (first 4 bytes)
-        material.materialId = *reinterpret_cast<const int32_t*>(content.data() + offset);
-        std::cout << "MaterialID:" << material.materialId << std::endl;
-        offset += 4; // Move offset past the ID
-        
-        // Skip 4 bytes (possibly a dictionary size or other metadata)
-        uint32_t junk = *reinterpret_cast<uint32_t*>(content.data() + offset);
-        //std::cout << "junk:" << junk << std::endl;
-        offset += 4;
-
-        // Parse material properties
-        // The material data format is a series of key-value pairs:
-        // [key length][key string][value length][value string]
-        while (offset < content.size()) {
-            // Read key length
-            uint32_t keyLength = *reinterpret_cast<uint32_t*>(content.data() + offset);
-            offset += 4;
-
-            // Read key string
-            std::string key(reinterpret_cast<char*>(content.data() + offset), keyLength);
-            std::cout << "Key: " << key << std::endl; // Debug print
-            offset += keyLength;
-            
-            // Read value length
-            uint32_t valueLength = *reinterpret_cast<uint32_t*>(content.data() + offset);
-            //std::cout << valueLength << std::endl;
-            offset += 4;
-            
-            // Read value string
-            std::string valueStr(reinterpret_cast<char*>(content.data() + offset), valueLength);
-            std::cout << "Value: " << valueStr << std::endl; // Debug print
-            offset += valueLength;
-            
-            // Store the property as a string
-            material.properties[key] = valueStr;
+// Function to bake an impostor atlas: one render per view of 'grid' around the voxels,
+// all in this engine session, packed into <stem>_impostor.png. Depth and normal atlases
+// come from a ray cast through the voxels, the layout is written to <stem>_impostor.json.
+// See vox2bella_impostor.h. The camera is put back afterwards.
+bool renderImpostors(dl::bella_sdk::Engine& engine, const vox2bella::orbit::VoxelWorld& world, const vox2bella::impostor::ViewGrid& grid,
+                     uint32_t tile, bool withDepth, bool withNormal, const std::string& stem)
+{
+    using namespace vox2bella::impostor;
+    auto belScene = engine.scene();
+    auto belCameraXform = belScene.cameraPath().parent();
+    double fov = belScene.camera()["lens"].asNode()["steps"][0]["fov"].asReal();
+    if (fov <= 0 || world.empty()) {
+        std::cerr << "Error: impostors need voxels and a camera lens with a field of view" << std::endl;
+        return false;
+    }
+
+    // The target and radius frameCamera gives zoomExtents, every view at the distance
+    // where that sphere fits the tile
+    Layout layout;
+    int lo[3], hi[3];
+    world.bounds(lo, hi);
+    double diagonal = 0.0;
+    for (int a = 0; a < 3; ++a) {
+        layout.target[a] = (lo[a] + hi[a]) / 2.0;
+        diagonal += double(hi[a] - lo[a] + 1) * double(hi[a] - lo[a] + 1);
+    }
+    layout.radius = std::sqrt(diagonal) / 2.0;
+    layout.distance = fitDistance(layout.radius, fov, tile, tile);
+    layout.fov = fov;
+    layout.tileWidth = layout.tileHeight = tile;
+    layout.grid = grid;
+    layout.color = stem + "_impostor.png";
+    if (withDepth) layout.depth = stem + "_impostor_depth.png";
+    if (withNormal) layout.normal = stem + "_impostor_normal.png";
+
+    const dl::Mat4 original = belCameraXform["steps"][0]["xform"].asMat4();
+    belScene.camera()["resolution"] = dl::Vec2{ double(tile), double(tile) };
+    // Every view renders over the same engine output, it is removed at the end
+    const std::string viewName = stem + "_impostor_view";
+    belScene.beautyPass()["outputName"] = dl::String(viewName.c_str());
+
+    Atlas color(tile, tile, grid.azimuths, grid.elevations);
+    Atlas depth(withDepth ? tile : 0, tile, grid.azimuths, grid.elevations);
+    Atlas normal(withNormal ? tile : 0, tile, grid.azimuths, grid.elevations);
+    vox2bella::snapshot::Snapshotter image("", 0, 0);
+    engine.subscribe(&image);
+    std::vector<double> matrices;
+    bool ok = true;
+    const int views = grid.azimuths * grid.elevations;
+    for (int row = 0; ok && row < grid.elevations; ++row)
+        for (int column = 0; ok && column < grid.azimuths; ++column)
+        {
+            double m[16];
+            viewMatrix(layout.target, layout.distance, grid.azimuth(column), grid.elevation(row), m);
+            matrices.insert(matrices.end(), m, m + 16);
+            std::cout << "📐 Rendering view " << (row * grid.azimuths + column + 1) << "/" << views
+                      << " (azimuth " << grid.azimuth(column) << ", elevation " << grid.elevation(row) << ")" << std::endl;
+            {
+                dl::bella_sdk::Scene::EventScope es(belScene);
+                dl::Mat4 matrix;
+                for (int k = 0; k < 16; ++k) matrix[k] = m[k];
+                belCameraXform["steps"][0]["xform"] = matrix;
+            }
+            renderAndWait(engine, &image);
+            std::vector<uint8_t> rgba, depthTile, normalTile;
+            uint32_t width = 0, height = 0;
+            if (!image.latest(rgba, width, height) || width != tile || height != tile) {
+                std::cerr << "Error: no " << tile << "x" << tile << " image rendered for impostor view " << (row * grid.azimuths + column + 1) << std::endl;
+                ok = false;
+                break;
+            }
+            auto camera = vox2bella::orbit::Camera::fromMatrix(m, fov, width, height);
+            traceTile(world, camera, layout.distance - layout.radius, layout.distance + layout.radius, rgba,
+                      withDepth ? &depthTile : nullptr, withNormal ? &normalTile : nullptr);
+            color.place(column, row, rgba);
+            if (withDepth) depth.place(column, row, depthTile);
+            if (withNormal) normal.place(column, row, normalTile);
         }
-    } 
-    // More chunk types that are identified but not fully processed
-    else if (chunkId == "MATT")
+    engine.unsubscribe(&image);
     {
-        std::cout << "MATT" << std::endl; // Legacy material chunk
-    } 
-    else if (chunkId == "LAYR")
+        dl::bella_sdk::Scene::EventScope es(belScene);
+        belCameraXform["steps"][0]["xform"] = original;
+    }
+    std::remove((viewName + ".jpg").c_str());
+    std::remove((viewName + ".png").c_str());
+    if (!ok) return false;
+
+    ok = vox2bella::snapshot::writePng(layout.color, color.data(), color.width(), color.height())
+      && (!withDepth || vox2bella::snapshot::writePng(layout.depth, depth.data(), depth.width(), depth.height()))
+      && (!withNormal || vox2bella::snapshot::writePng(layout.normal, normal.data(), normal.width(), normal.height()));
+    std::ofstream json(stem + "_impostor.json");
+    json << layoutJson(layout, matrices);
+    if (!ok || !json.flush()) {
+        std::cerr << "Error: could not write the impostor atlas" << std::endl;
+        return false;
+    }
+    std::cout << "✅ " << views << " views baked into " << layout.color << " (" << color.width() << "x" << color.height()
+              << "), layout in " << stem << "_impostor.json" << std::endl;
+    return true;
+}
+
+// Replays a scene log written with --record into fresh scenes, --replayruns times,
+// and prints how long each kind of Bella call took in the fastest run. The log's
+// writes go to <log name>_replay.bsz, so the original scene is left alone.
+int runReplay(dl::Args& args)
+{
+    using namespace vox2bella::record;
+    const std::filesystem::path logPath(args.value("--replay").buf());
+    std::vector<uint8_t> log;
+    std::string error;
+    if (!loadLog(logPath.string(), log, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    const std::string writePath = (logPath.parent_path() / (logPath.stem().string() + "_replay.bsz")).string();
+    const unsigned runs = std::max(1u, argUnsigned(args, "--replayruns", 1));
+
+    ReplayStats best;
+    for (unsigned run = 0; run < runs; ++run)
     {
-        std::cout << "LAYR" << std::endl; // Layer chunk
-    } 
-    else if (chunkId == "IMAP")
+        // A fresh scene per run, set up like the converter sets up its scene
+        dl::bella_sdk::Scene belScene;
+        belScene.loadDefs();
+        vox2bella::setupScene(belScene, logPath.stem().string());
+        ReplayStats stats;
+        if (!replay(belScene, log, writePath, stats, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        std::cout << "Run " << run + 1 << ": " << stats.totalSeconds * 1000.0 << " ms" << std::endl;
+        if (run == 0 || stats.totalSeconds < best.totalSeconds) best = stats;
+    }
+
+    // One line per kind of call: count, total and per-call time
+    auto row = [](const char* name, size_t count, double seconds) {
+        if (!count) return;
+        std::printf("%-18s %10zu %12.2f %10.3f\n", name, count, seconds * 1000.0, seconds * 1e6 / double(count));
+    };
+    std::printf("%-18s %10s %12s %10s\n", "call", "count", "ms", "us/call");
+    row("createNode", best.creates, best.createSeconds);
+    row("parentTo", best.parents, best.parentSeconds);
+    row("deleteNode", best.deletes, best.deleteSeconds);
+    for (int k = 0; k < NumValueKinds; ++k)
+        row((std::string("set ") + valueKindName(ValueKind(k))).c_str(), best.sets[k], best.setSeconds[k]);
+    row("write", best.writes, best.writeSeconds);
+    std::printf("%-18s %10s %12.2f\n", "log decoding", "", best.decodeSeconds * 1000.0);
+    std::printf("%-18s %10s %12.2f\n", "total", "", best.totalSeconds * 1000.0);
+    return 0;
+}
+
+// Regression harness: renders every .vox in a directory (or one file) through each
+// emission mode at a fixed low resolution and seed on the CPU, and compares each
+// image with the reference mode's image. Prints a speed-versus-fidelity table.
+// Returns 1 if any image falls below --psnrmin or --ssimmin
+int runCompare(dl::Args& args)
+{
+    struct Mode
     {
-        std::cout << "IMAP" << std::endl; // Index map chunk
-    } 
-    else if (chunkId == "NOTE")
+        const char* name;
+        vox2bella::ConvertOptions options;
+    };
+    std::vector<Mode> modes;
+    modes.push_back({ "instanced", vox2bella::ConvertOptions() }); // reference, the original look
+    modes.back().options.autoRender = false;
+    modes.push_back({ "mesh", vox2bella::ConvertOptions() });
+    modes.back().options.emit = vox2bella::EmitMesh;
+    modes.back().options.autoRender = false;
+    modes.push_back({ "auto", vox2bella::ConvertOptions() });   // content-driven bounces and noise target
+    modes.push_back({ "draft", vox2bella::ConvertOptions() });
+    modes.back().options.preset = vox2bella::findRenderPreset("draft");
+
+    std::vector<std::filesystem::path> files;
+    std::filesystem::path input = args.value("--compare").buf();
+    if (std::filesystem::is_directory(input)) {
+        for (const auto& entry : std::filesystem::directory_iterator(input))
+            if (entry.path().extension() == ".vox") files.push_back(entry.path());
+        std::sort(files.begin(), files.end());
+    } else {
+        files.push_back(input);
+    }
+    if (files.empty()) {
+        std::cerr << "Error: no .vox files to compare in " << input.string() << std::endl;
+        return 1;
+    }
+
+    const double psnrMin = argUnsigned(args, "--psnrmin", 30);
+    const double ssimMin = argUnsigned(args, "--ssimmin", 95) / 100.0;
+    const unsigned size = argUnsigned(args, "--compareres", 160);
+
+    struct Totals { double seconds = 0, worstPsnr = std::numeric_limits<double>::infinity(), worstSsim = 1.0; unsigned failed = 0; };
+    std::vector<Totals> totals(modes.size());
+    bool anyFailed = false;
+
+    std::printf("%-24s %-10s %9s %8s %9s %7s\n", "file", "mode", "seconds", "speedup", "psnr", "ssim");
+    for (const std::filesystem::path& file : files)
     {
-        std::cout << "NOTE" << std::endl; // Annotations
+        std::vector<uint8_t> reference;
+        uint32_t refWidth = 0, refHeight = 0;
+        double refSeconds = 0;
+        for (size_t m = 0; m < modes.size(); ++m)
+        {
+            // A fresh engine per render so nothing carries over between modes
+            dl::bella_sdk::Engine engine;
+            engine.scene().loadDefs();
+            auto belScene = engine.scene();
+            if (!buildScene(belScene, file.string(), file, nullptr, modes[m].options, nullptr))
+                return 1;
+
+            // Same image size, seed and device for every mode, so only the geometry
+            // and sampling differ
+            belScene.camera()["resolution"] = dl::Vec2{ double(size), double(size) };
+            belScene.settings()["seed"] = dl::Int(1);
+            belScene.settings()["useGpu"] = false;
+
+            vox2bella::snapshot::Snapshotter image("", 0, 0);
+            engine.subscribe(&image);
+            auto start = std::chrono::steady_clock::now();
+            renderAndWait(engine, &image);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            engine.unsubscribe(&image);
+
+            std::vector<uint8_t> pixels;
+            uint32_t width = 0, height = 0;
+            if (!image.latest(pixels, width, height)) {
+                std::cerr << "Error: no image rendered for " << file.string() << " (" << modes[m].name << ")" << std::endl;
+                return 1;
+            }
+
+            double psnr = std::numeric_limits<double>::infinity(), ssim = 1.0;
+            if (m == 0) {
+                reference = pixels;
+                refWidth = width;
+                refHeight = height;
+                refSeconds = seconds;
+            } else if (width != refWidth || height != refHeight) {
+                psnr = 0;
+                ssim = 0;
+            } else {
+                psnr = vox2bella::compare::psnr(reference.data(), pixels.data(), width, height);
+                ssim = vox2bella::compare::ssim(reference.data(), pixels.data(), width, height);
+            }
+
+            bool failed = psnr < psnrMin || ssim < ssimMin;
+            if (failed) {
+                // Keep the offending image for a look
+                std::string failPath = file.stem().string() + "_" + modes[m].name + "_fail.png";
+                vox2bella::snapshot::writePng(failPath, pixels.data(), width, height);
+                anyFailed = true;
+                ++totals[m].failed;
+            }
+            totals[m].seconds += seconds;
+            totals[m].worstPsnr = std::min(totals[m].worstPsnr, psnr);
+            totals[m].worstSsim = std::min(totals[m].worstSsim, ssim);
+            std::printf("%-24s %-10s %9.2f %7.2fx %9.2f %7.4f%s\n", file.filename().string().c_str(), modes[m].name,
+                        seconds, seconds > 0 ? refSeconds / seconds : 0.0, psnr, ssim, failed ? "  FAIL" : "");
+        }
     }
-    //... handle other chunk ID's.
 
-    // Process child chunks if any
-    // First get current position in the file
-    std::streampos currentPosition = file.tellg();
-    // Calculate where child chunks end
-    std::streampos childrenEnd = currentPosition + static_cast<std::streamoff>(chunkHeader.childrenBytes);
-    // Read child chunks until we reach the end of the children section
-    while(file.tellg() < childrenEnd){
-        // Recursively call readChunk to process each child chunk
-        readChunk(file, palette, voxelPalette, belScene, voxel, minX, minY, minZ, maxX, maxY, maxZ, hasVoxels);
+    std::printf("\n%-10s %12s %8s %11s %10s %7s\n", "mode", "total secs", "speedup", "worst psnr", "worst ssim", "failed");
+    for (size_t m = 0; m < modes.size(); ++m)
+        std::printf("%-10s %12.2f %7.2fx %11.2f %10.4f %7u\n", modes[m].name, totals[m].seconds,
+                    totals[m].seconds > 0 ? totals[0].seconds / totals[m].seconds : 0.0,
+                    totals[m].worstPsnr, totals[m].worstSsim, totals[m].failed);
+    return anyFailed ? 1 : 0;
+}
+
+// Service modes: --batch converts a directory, --daemon keeps reading jobs from stdin
+// Both feed the same priority scheduler, see vox2bella_jobs.h
+// Job lines look like: interactive|batch <input.vox> [output.bsz]
+// Service modes with --prefork: every job is converted in a worker process forked
+// from this one after the SDK and the scene definitions are set up, see vox2bella_prefork.h.
+// Jobs come from --batch and, with --daemon, from stdin like the threaded service.
+int runPrefork(dl::Args& args)
+{
+#if defined(_WIN32)
+    std::cerr << "Error: --prefork needs fork(), which Windows doesn't have" << std::endl;
+    return 1;
+#else
+    using namespace vox2bella::jobs;
+    if (args.have("--jobqueue") || args.have("--metricsfile") || args.have("--metricsport")) {
+        std::cerr << "Error: --prefork can't be combined with --jobqueue or metrics, they need threads in the parent" << std::endl;
+        return 1;
     }
+    if (args.have("--packout") || (args.have("--batch") && vox2bella::pack::isArchive(args.value("--batch").buf()))) {
+        std::cerr << "Error: --prefork reads and writes plain files, archive input and --packout need the threaded service" << std::endl;
+        return 1;
+    }
+    unsigned workers = argUnsigned(args, "--workers", std::max(1u, std::thread::hardware_concurrency()));
+    vox2bella::ConvertOptions jobOptions;
+    if (!argConvertOptions(args, jobOptions)) return 1;
+
+    // Loaded once here, every worker starts from a copy-on-write image of it
+    dl::bella_sdk::Scene defsScene;
+    defsScene.loadDefs();
+
+    vox2bella::prefork::Pool pool(workers, [&](const std::string& input, const std::string& output, size_t& voxels) {
+        return convertInto(defsScene, input, output, jobOptions, &voxels);
+    });
+    std::string error;
+    if (!pool.start(error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+
+    struct Queued { Priority priority; std::chrono::steady_clock::time_point start; };
+    std::map<uint64_t, Queued> queued;
+    uint64_t nextId = 0;
+    auto submit = [&](Priority priority, const std::string& input, const std::string& output) {
+        vox2bella::prefork::Task task;
+        task.id = ++nextId;
+        task.input = input;
+        task.output = output;
+        queued[task.id] = { priority, std::chrono::steady_clock::now() };
+        pool.submit(task, priority == PriorityInteractive);
+        return task.id;
+    };
+
+    if (args.have("--batch"))
+    {
+        std::vector<std::filesystem::path> files;
+        if (!listVoxFiles(args.value("--batch").buf(), files)) return 1;
+        // Biggest first, like the threaded scheduler
+        std::vector<std::pair<uint64_t, std::filesystem::path>> sized;
+        for (const std::filesystem::path& file : files) sized.emplace_back(estimateCost(file.string()), file);
+        std::stable_sort(sized.begin(), sized.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (const auto& entry : sized)
+        {
+            std::filesystem::path out = entry.second;
+            out.replace_extension(".bsz");
+            submit(PriorityBatch, entry.second.string(), out.string());
+        }
+    }
+
+    // Job lines from stdin, read as they arrive without a reader thread
+    std::string pendingInput;
+    auto readJobs = [&]() {
+        char buffer[4096];
+        ssize_t n = read(0, buffer, sizeof(buffer));
+        if (n > 0) pendingInput.append(buffer, size_t(n));
+        size_t end;
+        while ((end = pendingInput.find('\n')) != std::string::npos || (n <= 0 && !pendingInput.empty()))
+        {
+            if (end == std::string::npos) end = pendingInput.size();
+            std::string line = pendingInput.substr(0, end);
+            pendingInput.erase(0, std::min(end + 1, pendingInput.size()));
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            Priority priority;
+            std::string input, output;
+            if (!parseJobLine(line, priority, input, output)) {
+                std::cerr << "Error: bad job line: " << line << std::endl;
+                continue;
+            }
+            uint64_t id = submit(priority, input, output);
+            std::cout << "queued " << id << " " << priorityName(priority) << " " << input << std::endl;
+        }
+        return n > 0;
+    };
+
+    pool.run(args.have("--daemon") ? 0 : -1, readJobs,
+        [&](const vox2bella::prefork::Task& task, bool ok, size_t voxels, const std::string& crash) {
+            Queued q = queued[task.id];
+            queued.erase(task.id);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - q.start).count();
+            if (!crash.empty()) std::cerr << "Error: " << task.input << ": " << crash << std::endl;
+            std::cout << (ok ? "done " : "failed ") << task.id << " " << priorityName(q.priority)
+                      << " " << task.input << " -> " << task.output << " (" << seconds << "s, " << voxels << " voxels)" << std::endl;
+        });
+    pool.stop();
+    return 0;
+#endif
 }
 
-// Observer class for monitoring scene events
-// This is a custom implementation of the SceneObserver interface from Bella SDK
-// The SceneObserver is called when various events occur in the scene
-struct Observer : public dl::bella_sdk::SceneObserver
-{   
-    bool inEventGroup = false; // Flag to track if we're in an event group
-        
-    // Override methods from SceneObserver to provide custom behavior
-    
-    // Called when a node is added to the scene
-    void onNodeAdded( dl::bella_sdk::Node node ) override
-    {   
-        dl::logInfo("%sNode added: %s", inEventGroup ? "  " : "", node.name().buf());
+int runService(dl::Args& args)
+{
+    using namespace vox2bella::jobs;
+    if (args.have("--prefork")) return runPrefork(args);
+
+    unsigned workers = argUnsigned(args, "--workers", std::max(1u, std::thread::hardware_concurrency()));
+    unsigned limits[PriorityCount] = {};
+    limits[PriorityInteractive] = argUnsigned(args, "--interactivelimit", 0);
+    limits[PriorityBatch]       = argUnsigned(args, "--batchlimit", 0);
+
+    using vox2bella::metrics::Registry;
+    Registry& metrics = Registry::global();
+    metrics.describe("vox2bella_queue_depth", Registry::Gauge, "Jobs waiting to start");
+    metrics.describe("vox2bella_jobs_in_flight", Registry::Gauge, "Jobs holding a worker slot");
+    metrics.describe("vox2bella_jobs_paused", Registry::Gauge, "Jobs paused at a model boundary for higher priority work");
+    metrics.describe("vox2bella_workers_helping", Registry::Gauge, "Worker slots lent to the models of a running job");
+    metrics.describe("vox2bella_leases_recovered_total", Registry::Counter, "Shared queue jobs taken back from workers that stopped renewing them");
+    metrics.describe("vox2bella_jobs_total", Registry::Counter, "Finished jobs by class and result");
+    metrics.describe("vox2bella_job_latency_seconds", Registry::Histogram, "Time from submission to completion");
+    metrics.describe("vox2bella_conversion_seconds", Registry::Histogram, "Time spent converting, excluding queueing");
+    metrics.describe("vox2bella_voxels_total", Registry::Counter, "Voxels converted");
+    metrics.describe("vox2bella_voxels_per_second", Registry::Gauge, "Conversion speed of the most recent job");
+
+    // Shared-directory queue, other nodes claim from the same directory
+    vox2bella::queue::SharedQueue sharedQueue;
+    const bool useQueue = args.have("--jobqueue");
+    if (useQueue) {
+        std::string error;
+        if (!sharedQueue.open(args.value("--jobqueue").buf(), argUnsigned(args, "--lease", 60), error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        std::cout << "Worker " << sharedQueue.owner() << " on queue " << args.value("--jobqueue").buf() << std::endl;
+    }
+    std::mutex claimsMutex;
+    std::map<uint64_t, vox2bella::queue::Claim> claims;   // job id -> lease, for jobs from the shared queue
+
+    // Emit mode, model selection and crop apply to every job
+    vox2bella::ConvertOptions jobOptions;
+    if (!argConvertOptions(args, jobOptions)) return 1;
+
+    // A batch can come from a tar file or pack and go into a pack (see vox2bella_pack.h)
+    // Only batch jobs then exist: job inputs are archive entry names, outputs pack entry names
+    vox2bella::pack::ArchiveReader archive;
+    vox2bella::pack::PackWriter pack;
+    const bool archiveIn = args.have("--batch") && vox2bella::pack::isArchive(args.value("--batch").buf());
+    const bool packOut = args.have("--packout");
+    if ((archiveIn || packOut) && (useQueue || args.have("--daemon"))) {
+        std::cerr << "Error: archive input and --packout only work with --batch alone" << std::endl;
+        return 1;
     }
-    
-    // Called when a node is removed from the scene
-    void onNodeRemoved( dl::bella_sdk::Node node ) override
     {
-        dl::logInfo("%sNode removed: %s", inEventGroup ? "  " : "", node.name().buf());
+        std::string error;
+        if ((archiveIn && !archive.open(args.value("--batch").buf(), error)) || (packOut && !pack.open(args.value("--packout").buf(), error))) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
     }
-    
-    // Called when an input value changes
-    void onInputChanged( dl::bella_sdk::Input input ) override
+    std::atomic<uint64_t> tempCount{ 0 };
+    const std::string tempPrefix = (std::filesystem::temp_directory_path() / ("vox2bella-" + vox2bella::queue::ownerId() + "-")).string();
+    // Reads the input through the archive's open stream (or from its file), converts,
+    // and with --packout sends the .bsz through a local temp file into the pack
+    auto convertPacked = [&](const Job& job, const vox2bella::ConvertOptions& options, size_t* voxels) {
+        std::vector<uint8_t> bytes;
+        std::string error;
+        bool ok;
+        if (archiveIn) {
+            const vox2bella::pack::Entry* entry = archive.find(job.input);
+            ok = entry && archive.read(*entry, bytes, error);
+        } else {
+            std::ifstream file(job.input, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            ok = file.is_open();
+        }
+        if (ok && !packOut) {
+            std::error_code ec;
+            std::filesystem::path out(job.output);
+            if (out.has_parent_path()) std::filesystem::create_directories(out.parent_path(), ec);
+            return convertBytes(bytes, job.input, job.output, options, voxels);
+        }
+        std::string temp = tempPrefix + std::to_string(tempCount++) + ".bsz";
+        ok = ok && convertBytes(bytes, job.input, temp, options, voxels);
+        if (ok) {
+            std::ifstream file(temp, std::ios::binary);
+            std::vector<uint8_t> bsz((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            ok = file.is_open() && pack.add(job.output, bsz, error);
+        }
+        std::error_code ec;
+        std::filesystem::remove(temp, ec);
+        if (!error.empty()) std::cerr << "Error: " << error << std::endl;
+        return ok;
+    };
+
+    // Big files split into one task per model that runs on the same workers
+    const uint64_t splitVoxels = argUnsigned(args, "--splitvoxels", 262144);
+    std::mutex outputMutex;
+    Scheduler* scheduler = nullptr;
+    Scheduler service(workers, limits,
+        [&](const Job& job) {
+            size_t voxels = 0;
+            auto start = std::chrono::steady_clock::now();
+            vox2bella::ConvertOptions options = jobOptions;
+            options.onModelDone = [&] { scheduler->checkpoint(job); };
+            // Jobs run side by side, each prints its progress in one piece when it is done
+            std::ostringstream progress;
+            options.progress = &progress;
+
+            // Jobs from the shared queue convert to a file of their own and replace the
+            // output with a rename, so a worker that lost its lease can't leave a torn file
+            vox2bella::queue::Claim claim;
+            bool fromQueue = false;
+            {
+                std::lock_guard<std::mutex> lock(claimsMutex);
+                auto found = claims.find(job.id);
+                if (found != claims.end()) {
+                    claim = found->second;
+                    claims.erase(found);
+                    fromQueue = true;
+                }
+            }
+            std::string output = job.output;
+            if (fromQueue) {
+                std::filesystem::path out(job.output);
+                output = (out.parent_path() / (out.stem().string() + "." + sharedQueue.owner() + ".part.bsz")).string();
+            }
+
+            // The converter splits the file once its chunk headers show splitVoxels voxels
+            options.parallelFor = [&](size_t count, const std::function<void(size_t)>& fn) {
+                scheduler->parallelFor(job, count, fn);
+            };
+            options.parallelMinVoxels = splitVoxels;
+            bool ok = archiveIn || packOut ? convertPacked(job, options, &voxels) : convertFile(job.input, output, options, &voxels);
+            {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cout << progress.str() << std::flush;
+            }
+            if (fromQueue)
+            {
+                std::error_code ec;
+                if (ok && sharedQueue.held(claim)) {
+                    std::filesystem::rename(output, job.output, ec);
+                    ok = !ec;
+                } else {
+                    std::filesystem::remove(output, ec);
+                    ok = false;
+                }
+                if (!sharedQueue.finish(claim, ok)) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cerr << "Warning: lost the lease on " << job.input << ", another worker converts it" << std::endl;
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::string cls = std::string("class=\"") + priorityName(job.priority) + "\"";
+            metrics.observe("vox2bella_conversion_seconds", cls, seconds);
+            metrics.add("vox2bella_voxels_total", "", double(voxels));
+            if (seconds > 0) metrics.set("vox2bella_voxels_per_second", "", voxels / seconds);
+            return ok;
+        },
+        [&](const Job& job, bool ok, double seconds) {
+            std::string cls = std::string("class=\"") + priorityName(job.priority) + "\"";
+            metrics.add("vox2bella_jobs_total", cls + (ok ? ",result=\"ok\"" : ",result=\"failed\""), 1);
+            metrics.observe("vox2bella_job_latency_seconds", cls, seconds);
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << (ok ? "done " : "failed ") << job.id << " " << priorityName(job.priority)
+                      << " " << job.input << " -> " << job.output << " (" << seconds << "s)" << std::endl;
+        });
+    scheduler = &service;
+
+    vox2bella::metrics::ScopedCollector queueGauges(metrics, [&](Registry& r) {
+        Snapshot snap = service.snapshot();
+        for (int p = 0; p < PriorityCount; ++p)
+        {
+            std::string cls = std::string("class=\"") + priorityName(Priority(p)) + "\"";
+            r.set("vox2bella_queue_depth", cls, snap.queued[p]);
+            r.set("vox2bella_jobs_in_flight", cls, snap.running[p]);
+            r.set("vox2bella_jobs_paused", cls, snap.paused[p]);
+            r.set("vox2bella_workers_helping", cls, snap.helping[p]);
+        }
+    });
+    vox2bella::metrics::Exporter exporter;
+    if (!startMetrics(args, exporter)) return 1;
+
+    if (archiveIn)
     {
-        dl::logInfo("%sInput changed: %s", inEventGroup ? "  " : "", input.path().buf());
+        // Costs from the entry sizes, indexing every entry would read them all twice
+        for (const vox2bella::pack::Entry& entry : archive.entries())
+        {
+            std::filesystem::path name(entry.name);
+            if (name.extension() != ".vox") continue;
+            if (!packOut && vox2bella::pack::unsafeName(entry.name)) {
+                std::cerr << "Warning: skipping " << entry.name << ", its output would land outside the current directory" << std::endl;
+                continue;
+            }
+            service.submit(PriorityBatch, entry.name, name.replace_extension(".bsz").generic_string(), entry.size / 4);
+        }
     }
-    
-    // Called when an input is connected to something
-    void onInputConnected( dl::bella_sdk::Input input ) override
+    else if (args.have("--batch"))
     {
-        dl::logInfo("%sInput connected: %s", inEventGroup ? "  " : "", input.path().buf());
+        std::vector<std::filesystem::path> files;
+        if (!listVoxFiles(args.value("--batch").buf(), files)) return 1;
+        for (const std::filesystem::path& file : files)
+        {
+            std::filesystem::path out = file;
+            out.replace_extension(".bsz");
+            // In a pack, outputs are named by file name only
+            if (packOut) out = out.filename();
+            service.submit(PriorityBatch, file.string(), out.string(), estimateCost(file.string()));
+        }
     }
-    
-    // Called at the start of a group of related events
-    void onBeginEventGroup() override
+
+    std::thread reader;
+    std::thread feeder;
+    if (useQueue)
     {
-        inEventGroup = true;
-        dl::logInfo("Event group begin.");
+        // Claims jobs from the shared directory while this node has idle workers and
+        // renews their leases. Without --daemon it stops once the queue is drained.
+        feeder = std::thread([&] {
+            const bool keepWaiting = args.have("--daemon");
+            const auto beatInterval = std::chrono::duration<double>(sharedQueue.leaseSeconds() / 3);
+            auto lastBeat = std::chrono::steady_clock::now() - std::chrono::hours(1);
+            for (;;)
+            {
+                if (std::chrono::steady_clock::now() - lastBeat >= beatInterval) {
+                    const std::vector<std::string> lost = sharedQueue.heartbeat();
+                    const std::vector<std::string> recovered = sharedQueue.recoverStale();
+                    {
+                        std::lock_guard<std::mutex> lock(outputMutex);
+                        for (const std::string& lease : lost) std::cerr << "Warning: lost the lease on " << lease << std::endl;
+                        for (const std::string& job : recovered) std::cout << "recovered " << job << std::endl;
+                    }
+                    metrics.add("vox2bella_leases_recovered_total", "", recovered.size());
+                    lastBeat = std::chrono::steady_clock::now();
+                }
+                Snapshot snap = service.snapshot();
+                unsigned busy = 0;
+                for (int p = 0; p < PriorityCount; ++p)
+                    busy += snap.queued[p] + snap.running[p] + snap.paused[p] + snap.helping[p];
+                vox2bella::queue::Claim claim;
+                while (busy < workers && sharedQueue.claim(claim))
+                {
+                    uint64_t id;
+                    {
+                        std::lock_guard<std::mutex> lock(claimsMutex);
+                        id = service.submit(PriorityBatch, claim.input, claim.output, claim.cost);
+                        claims[id] = claim;
+                    }
+                    ++busy;
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cout << "claimed " << id << " " << claim.input << std::endl;
+                }
+                if (busy == 0 && !keepWaiting && sharedQueue.drained()) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+            service.close();
+        });
     }
-    
-    // Called at the end of a group of related events
-    void onEndEventGroup() override
+    else if (args.have("--daemon"))
     {
-        inEventGroup = false;
-        dl::logInfo("Event group end.");
+        // Job lines come from stdin, typically a pipe or `tail -f` of a spool file
+        reader = std::thread([&] {
+            std::string line;
+            while (std::getline(std::cin, line))
+            {
+                if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+                Priority priority;
+                std::string input, output;
+                if (!parseJobLine(line, priority, input, output)) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cerr << "Error: bad job line: " << line << std::endl;
+                    continue;
+                }
+                uint64_t id = service.submit(priority, input, output, estimateCost(input));
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cout << "queued " << id << " " << priorityName(priority) << " " << input << std::endl;
+            }
+            service.close();
+        });
     }
-};
+    else
+    {
+        service.close();
+    }
+
+    service.run();
+    if (reader.joinable()) reader.join();
+    if (feeder.joinable()) feeder.join();
+    exporter.stop();
+    if (packOut)
+    {
+        std::string error;
+        if (!pack.close(error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << pack.count() << " outputs to " << args.value("--packout").buf() << std::endl;
+    }
+    return 0;
+}
 
 // Main function for the program
 // This is where execution begins
@@ -435,10 +1491,52 @@ int DL_main(dl::Args& args)
 
     // Define command-line arguments that the program accepts
     args.add("vi",  "voxin", "",   "Input .vox file");
+    args.add("si",  "shmin", "",   "Input POSIX shared-memory voxel segment (e.g. /myeditor), see vox2bella_shm.h");
     args.add("tp",  "thirdparty",   "",   "prints third party licenses");
     args.add("li",  "licenseinfo",   "",   "prints license info");
     args.add("r",   "render",        "",   "render the scene");
+    args.add("im",  "impostor",      "",   "bake an impostor atlas of <azimuths>x<elevations> views around the voxels (default: 8x3)");
+    args.add("ie",  "impostorelevation", "", "--impostor: lowest and highest view elevation in degrees (default: 0,60)");
+    args.add("ic",  "impostorchannels", "", "--impostor: also bake depth and/or normal atlases, e.g. depth,normal");
+    args.add("it",  "impostortile",  "",   "--impostor: tile size in pixels (default: 256)");
     args.add("o",   "orbit",         "36",   "orbit the camera around the scene (number of frames, default: 36)");
+    args.add("ok",  "orbitkey",      "1",    "--orbit: render every Nth frame and reproject the frames in between (default: 1, render all)");
+    args.add("od",  "orbitdisocclusion", "2", "--orbitkey: render a frame when more than this percent of its voxels were hidden in both keyframes");
+    args.add("em",  "emit",          "instanced", "geometry: instanced (a bevelled box per voxel), mesh (face-culled meshes) or world (one mesh per color, models placed by the scene graph)");
+    args.add("md",  "model",         "",   "only convert this model, by index or by object name from the scene graph");
+    args.add("cr",  "crop",          "",   "only convert voxels inside x0,y0,z0:x1,y1,z1 (model coordinates)");
+    args.add("ex",  "export",        "bsz", "output format: bsz (Bella scene) or usda (each model once plus a PointInstancer)");
+    args.add("px",  "proxy",         "4096", "with --render: start rendering coarse boxes (at most this many) right after parsing, swap in each model when converted");
+    args.add("ss",  "snapshot",      "",   "with --render: write progressive snapshots to this .png (default: <name>_snapshot.png)");
+    args.add("sv",  "snapshotinterval", "30", "seconds between snapshots");
+    args.add("su",  "snapshotupdates", "0", "also snapshot every N progressive image updates");
+    args.add("cm",  "compare",       "",   "render a .vox file or directory through each emission mode and compare to the reference");
+    args.add("cs",  "compareres",    "160", "--compare: image size in pixels");
+    args.add("pm",  "psnrmin",       "30", "--compare: fail below this PSNR in dB, --orbitkey: render every frame below it");
+    args.add("sm",  "ssimmin",       "95", "--compare: fail below this SSIM, in percent");
+    args.add("q",   "quality",       "",   "render preset: draft (seconds per frame), review or final (default: the scene's settings, draft for --orbit)");
+    args.add("na",  "noautorender",  "",   "keep the scene's bounce depth and noise target instead of picking them from the content");
+    args.add("dm",  "daemon",        "",   "run as a conversion service reading '<interactive|batch> <in.vox> [out.bsz]' lines from stdin");
+    args.add("ba",  "batch",         "",   "convert every .vox file in a directory, tar file or pack as batch jobs");
+    args.add("po",  "packout",       "",   "--batch: write all outputs into this one pack file, see vox2bella_pack.h");
+    args.add("pl",  "packlist",      "",   "list the entries of a pack or tar file");
+    args.add("pe",  "packextract",   "",   "extract a pack or tar file into the current directory");
+    args.add("wk",  "workers",       "0",  "service modes: concurrent conversions (default: number of cores)");
+    args.add("il",  "interactivelimit", "0", "service modes: max concurrent interactive jobs (default: no limit)");
+    args.add("bl",  "batchlimit",    "0",  "service modes: max concurrent batch jobs (default: no limit)");
+    args.add("pf",  "prefork",       "",   "service modes: convert every job in its own worker process forked after start-up");
+    args.add("jq",  "jobqueue",      "",   "service modes: claim jobs from this shared directory, see vox2bella_queue.h");
+    args.add("qa",  "queueadd",      "",   "add a directory's .vox files (or one file) to the --jobqueue directory and exit");
+    args.add("ls",  "lease",         "60", "seconds after which a silent worker's shared queue job is taken back");
+    args.add("sp",  "splitvoxels",   "262144", "service modes: files with at least this many voxels prepare their models in parallel");
+    args.add("mf",  "metricsfile",   "",   "write Prometheus metrics to this file periodically");
+    args.add("mi",  "metricsinterval", "10", "seconds between metrics file writes");
+    args.add("mp",  "metricsport",   "0",  "serve Prometheus metrics on 127.0.0.1:<port>");
+    args.add("rc",  "record",        "",   "also write the scene calls of the conversion to this log, see vox2bella_record.h");
+    args.add("rp",  "replay",        "",   "run the scene calls of a --record log against a fresh scene and time them");
+    args.add("rr",  "replayruns",    "1",  "--replay: number of runs, the fastest is reported");
+    args.add("sb",  "scalebench",    "",   "time 1 to --scalejobs concurrent conversions of this many synthetic files (default: 32)");
+    args.add("sj",  "scalejobs",     "",   "--scalebench: most conversions at once (default: number of cores)");
 
     // Handle special command-line requests
     
@@ -466,11 +1564,67 @@ int DL_main(dl::Args& args)
         return 0;
     }
 
+    // Malformed numbers stop here rather than deep inside a mode
+    if (!checkNumberArgs(args))
+    {
+        return 1;
+    }
+
+    // Render regression harness
+    if (args.have("--compare"))
+    {
+        return runCompare(args);
+    }
+
+    // Scene call benchmark, no .vox file involved
+    if (args.have("--replay"))
+    {
+        return runReplay(args);
+    }
+
+    // Pack and tar files
+    if (args.have("--packlist") || args.have("--packextract"))
+    {
+        return runPack(args);
+    }
+
+    // Concurrent conversion scaling
+    if (args.have("--scalebench"))
+    {
+        return runScaling(args);
+    }
+
+    // Jobs for the shared-directory queue
+    if (args.have("--queueadd"))
+    {
+        return runQueueAdd(args);
+    }
+
+    // Long-running service modes have their own job queue
+    if (args.have("--daemon") || args.have("--batch") || args.have("--jobqueue"))
+    {
+        return runService(args);
+    }
+
+    // Shared-memory input from a running editor, used instead of a .vox file
+    vox2bella::shm::SegmentReader shmSegment;
+    bool fromShm = false;
+
     // Get the input file path from command line arguments
     if (args.have("--voxin"))
     {
         filePath = args.value("--voxin").buf();
     } 
+    else if (args.have("--shmin"))
+    {
+        filePath = args.value("--shmin").buf();
+        std::string error;
+        if (!shmSegment.open(filePath, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        fromShm = true;
+    }
     else 
     {
         // If no input file was specified, print error and exit
@@ -478,24 +1632,52 @@ int DL_main(dl::Args& args)
         return 1; 
     }
 
-    // Validate the input file
-    
-    // Check that the file has a .vox extension
-    if (filePath.length() < 5 || filePath.substr(filePath.length() - 4) != ".vox") {
-        std::cerr << "Error: Input file must have a .vox extension." << filePath<<std::endl;
-        return 1;
+    std::filesystem::path voxPath;
+
+    if (fromShm)
+    {
+        // Name the outputs after the segment, without the leading slash
+        size_t start = filePath.find_first_not_of('/');
+        if (start == std::string::npos) {
+            std::cerr << "Error: shared-memory segment name " << filePath << " has no name after the slashes" << std::endl;
+            return 1;
+        }
+        voxPath = std::filesystem::path(filePath.substr(start) + ".vox");
     }
+    else
+    {
+        // Validate the input file
+        
+        // Check that the file has a .vox extension
+        if (filePath.length() < 5 || filePath.substr(filePath.length() - 4) != ".vox") {
+            std::cerr << "Error: Input file must have a .vox extension." << filePath<<std::endl;
+            return 1;
+        }
 
-    std::filesystem::path voxPath;
+        // Check if the file exists
+        if (!std::filesystem::exists(filePath)) {
+            std::cerr << "Error: Input file does not exist." << std::endl;
+            return 1;
+        } 
+        else 
+        {
+            voxPath = std::filesystem::path(filePath);
+        }
+    }
 
-    // Check if the file exists
-    if (!std::filesystem::exists(filePath)) {
-        std::cerr << "Error: Input file does not exist." << std::endl;
-        return 1;
-    } 
-    else 
+    // USD export writes each model once and instances it, no Bella scene is involved
+    if (args.have("--export") && std::string(args.value("--export").buf()) == "usda")
     {
-        voxPath = std::filesystem::path(filePath);
+        if (fromShm) {
+            std::cerr << "Error: USD export needs a .vox file input" << std::endl;
+            return 1;
+        }
+        // The layer always holds every model, whole, as instanced meshes
+        if (args.have("--model") || args.have("--crop") || args.have("--emit")) {
+            std::cerr << "Error: --model, --crop and --emit don't apply to USD export" << std::endl;
+            return 1;
+        }
+        return exportUsd(filePath, voxPath) ? 0 : 1;
     }
 
     // Create a new Bella scene
@@ -513,141 +1695,121 @@ int DL_main(dl::Args& args)
     auto belScene = engine.scene();
 
 
-    // Create a vector to store voxel color indices
-    std::vector<uint8_t> voxelPalette;
-    
-    // Variables to track voxel extents for camera positioning
-    uint8_t minX = 255, minY = 255, minZ = 255;
-    uint8_t maxX = 0, maxY = 0, maxZ = 0;
-    bool hasVoxels = false;
+    // Render times are recorded if a metrics file or port was requested
+    vox2bella::metrics::Registry::global().describe("vox2bella_render_seconds", vox2bella::metrics::Registry::Histogram, "Engine render time per image");
+    vox2bella::metrics::Exporter exporter;
+    if (!startMetrics(args, exporter)) return 1;
 
-    // Open the input file for binary reading
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file." << std::endl;
+    // Fill the engine's scene with the converted voxels
+    vox2bella::ConvertOptions options;
+    if (!argConvertOptions(args, options))
         return 1;
+    // Orbit animations default to the draft preset
+    if (!options.preset && args.have("--orbit"))
+        options.preset = vox2bella::findRenderPreset("draft");
+    // World assembly rasterises the placements on every core
+    if (options.emit == vox2bella::EmitWorld)
+        options.parallelFor = threadParallelFor;
+    // Impostor views are set up before converting, they also default to the draft preset
+    vox2bella::impostor::ViewGrid impostorGrid;
+    bool impostorDepth = false, impostorNormal = false;
+    if (args.have("--impostor"))
+    {
+        // The voxels the views are cut out with come from the converted models, which
+        // world assembly and shared-memory input don't hand out
+        if (fromShm || options.emit == vox2bella::EmitWorld) {
+            std::cerr << "Error: --impostor needs a .vox file input and doesn't work with -em:world" << std::endl;
+            return 1;
+        }
+        if ((!args.value("--impostor").isEmpty() && !vox2bella::impostor::parseGrid(args.value("--impostor").buf(), impostorGrid))
+            || (args.have("--impostorelevation") && !vox2bella::impostor::parseElevations(args.value("--impostorelevation").buf(), impostorGrid))) {
+            std::cerr << "Error: --impostor expects <azimuths>x<elevations> (1..64 each), --impostorelevation <lowest>,<highest> in degrees" << std::endl;
+            return 1;
+        }
+        if (args.have("--impostorchannels") &&
+            !vox2bella::impostor::parseChannels(args.value("--impostorchannels").buf(), impostorDepth, impostorNormal)) {
+            std::cerr << "Error: --impostorchannels expects depth, normal or depth,normal, got '" << args.value("--impostorchannels").buf() << "'" << std::endl;
+            return 1;
+        }
+        if (!options.preset)
+            options.preset = vox2bella::findRenderPreset("draft");
     }
-
-    // Read the VOX file header
-    VoxHeader header;
-    file.read(reinterpret_cast<char*>(&header), sizeof(VoxHeader));
-
-    // Validate that this is actually a VOX file by checking the magic number
-    if (std::string(header.magic, 4) != "VOX ") {
-        std::cerr << "Invalid file format." << std::endl;
-        return 1;
+    // Orbits with keyframes keep the voxels to reproject the frames in between, impostors
+    // to cut out, and bake depth and normals for, each view
+    const int orbitKey = std::max(1, int(argUnsigned(args, "--orbitkey", 1)));
+    const bool interpolatedOrbit = args.have("--orbit") && orbitKey > 1;
+    std::unique_ptr<vox2bella::orbit::VoxelWorld> voxelWorld;
+    if (interpolatedOrbit || args.have("--impostor")) {
+        voxelWorld.reset(new vox2bella::orbit::VoxelWorld());
+        options.onModelVoxels = [&](const uint8_t* records, uint32_t count) { voxelWorld->add(records, count); };
     }
-    
-    oom::bella::defaultScene2025(belScene); // create the basic scene elements in Bella
-    auto voxel          = belScene.createNode("box","box1","box1");
-    voxel["radius"]           = 0.33f;
-    voxel["sizeX"]            = 0.99f;
-    voxel["sizeY"]            = 0.99f;
-    voxel["sizeZ"]            = 0.99f;
-    
-    belScene.beautyPass()["outputExt"] = ".jpg";
-    belScene.beautyPass()["outputName"] = voxPath.stem().string().c_str();
-    auto imgOutputPath = belScene.createNode("outputImagePath", "voxOutputPath");
-    imgOutputPath["ext"] = ".jpg";
-    imgOutputPath["dir"] = ".";
-    belScene.beautyPass()["saveImage"] = dl::Int(0);
-    belScene.beautyPass()["overridePath"] = imgOutputPath;
-    // Process all chunks in the VOX file
-    // Loop until we reach the end of the file
-    while (file.peek() != EOF) {
-        readChunk(file, palette, voxelPalette, belScene, voxel, minX, minY, minZ, maxX, maxY, maxZ, hasVoxels);
-    } 
-
-    // If the file didn't have a palette, create materials using the default palette
-    if (!has_palette)
+    // Proxy-first rendering: the engine starts on coarse boxes right after parsing and
+    // picks up each model's geometry as the conversion (on worker threads) emits it
+    const auto conversionStart = std::chrono::steady_clock::now();
+    bool proxyFirst = false;
+    if (args.have("--proxy"))
     {
-        for(int i=0; i<256; i++)
-        {
-            // Extract RGBA components from the palette color
-            // Bit shifting and masking extracts individual byte components
-            uint8_t r = (palette[i] >> 0) & 0xFF;   // Red (lowest byte)
-            uint8_t g = (palette[i] >> 8) & 0xFF;   // Green (second byte)
-            uint8_t b = (palette[i] >> 16) & 0xFF;  // Blue (third byte)
-            uint8_t a = (palette[i] >> 24) & 0xFF;  // Alpha (highest byte)
-            
-            // Create a unique material name
-            dl::String nodeName = dl::String("voxMat") + dl::String(i);
-            // Create an Oren-Nayar material (diffuse material model)
-            auto voxMat = belScene.createNode("orenNayar", nodeName, nodeName);
-            {
-                dl::bella_sdk::Scene::EventScope es(belScene);
-                
-                // Set the material color (convert 0-255 values to 0.0-1.0 range)
-                voxMat["reflectance"] = dl::Rgba{ static_cast<double>(r)/255.0,
-                                              static_cast<double>(g)/255.0,
-                                              static_cast<double>(b)/255.0,
-                                              static_cast<double>(a)/255.0};
-            }
-        }
+        if (!args.have("--render") || fromShm || options.emit == vox2bella::EmitWorld)
+            std::cerr << "Warning: --proxy needs --render and a .vox input, and doesn't work with -em:world" << std::endl;
+        else
+            proxyFirst = true;
     }
-
-    // Assign materials to voxels based on their color indices
-    for (int i = 0; i < voxelPalette.size(); i++) 
+    if (proxyFirst)
     {
-        // Find the transform node for this voxel
-        auto xformNode = belScene.findNode(dl::String("voxXform") + dl::String(i));
-        // Find the material node for this voxel's color
-        auto matNode = belScene.findNode(dl::String("voxMat") + dl::String(voxelPalette[i]));
-        // Assign the material to the voxel
-        xformNode["material"] = matNode;
+        options.proxyCells = args.value("--proxy").isEmpty() ? 4096 : argUnsigned(args, "--proxy", 4096);
+        options.parallelFor = threadParallelFor;
+        options.onProxyReady = [&] {
+            engine.start();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - conversionStart).count();
+            std::cout << "Rendering the proxy " << seconds << " s after start" << std::endl;
+        };
     }
 
-    // Close the input file
-    file.close();
-
-    // Calculate center and radius for camera positioning
-    if (hasVoxels) {
-        // Calculate the center of the voxel extents
-        double centerX = (minX + maxX) / 2.0;
-        double centerY = (minY + maxY) / 2.0;
-        double centerZ = (minZ + maxZ) / 2.0;
-        dl::Vec3 target{centerX, centerY, centerZ};
-        
-        // Calculate the radius (half the diagonal of the bounding box)
-        double sizeX = maxX - minX + 1;  // +1 because voxels have size
-        double sizeY = maxY - minY + 1;
-        double sizeZ = maxZ - minZ + 1;
-        double radius = sqrt(sizeX*sizeX + sizeY*sizeY + sizeZ*sizeZ) / 2.0;
-        
-        // Use zoomExtents to position the camera
-        //dl::Path cameraPath = cameraXform.path();
-        dl::Mat4 cameraMatrix = dl::bella_sdk::zoomExtents(belScene.cameraPath(), target, radius);
-      
-        auto belCameraPath = belScene.cameraPath(); // Since camera can be instanced, we get the full path of th one currently define din scene settings
-
-        auto belCamera = belScene.camera();
-        auto belCameraXform = belCameraPath.parent(); // thus the parent of the camera path is the xform node 99% of the time   
-
-        // Apply the calculated camera transformation
-        {
-            dl::bella_sdk::Scene::EventScope es(belScene);
-            belCameraXform["steps"][0]["xform"] = cameraMatrix;
-        }
-        
-        std::cout << "Voxel extents: (" << static_cast<int>(minX) << "," << static_cast<int>(minY) << "," << static_cast<int>(minZ) 
-                  << ") to (" << static_cast<int>(maxX) << "," << static_cast<int>(maxY) << "," << static_cast<int>(maxZ) << ")" << std::endl;
-        std::cout << "Center: (" << centerX << "," << centerY << "," << centerZ << "), Radius: " << radius << std::endl;
-    }
+    // The scene calls are logged for --replay
+    vox2bella::record::SceneLog sceneLog;
+    if (args.have("--record"))
+        options.record = &sceneLog;
+    if (!buildScene(belScene, filePath, voxPath, fromShm ? &shmSegment : nullptr, options, nullptr))
+        return 1;
 
     // Create the output file path by replacing .vox with .bsz
     std::filesystem::path bszPath = voxPath.stem().string() + ".bsz";
-    // Write the Bella scene to the output file
 
-    auto offset1 = dl::Vec2 {-90, 0.0};
-    dl::bella_sdk::orbitCamera(engine.scene().cameraPath(),offset1);
+    if (options.record)
+    {
+        std::string logFile = args.value("--record").buf();
+        if (logFile.empty()) logFile = voxPath.stem().string() + ".v2blog";
+        sceneLog.write(bszPath.string());
+        std::string error;
+        if (!sceneLog.save(logFile, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        std::cout << "Recorded " << sceneLog.ops() << " scene calls (" << sceneLog.size() / 1024 << " KB) to " << logFile << std::endl;
+    }
 
 
     // Render the scene
     if (args.have("--render")) {
-        engine.start();
-        while(engine.rendering()) { 
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        } 
+        // The proxy render was only a preview, start over on the finished scene
+        if (proxyFirst) engine.stop();
+        if (args.have("--snapshot")) {
+            // Progressive snapshots so a long render can be judged (and stopped) early
+            std::string snapshotPath = args.value("--snapshot").buf();
+            if (snapshotPath.empty())
+                snapshotPath = voxPath.stem().string() + "_snapshot.png";
+            unsigned interval = argUnsigned(args, "--snapshotinterval", 30);
+            unsigned updates = argUnsigned(args, "--snapshotupdates", 0);
+            if (args.have("--snapshotupdates") && !args.have("--snapshotinterval"))
+                interval = 0; // only count updates when that's all that was asked for
+            vox2bella::snapshot::Snapshotter snapshots(snapshotPath, interval, updates);
+            engine.subscribe(&snapshots);
+            renderAndWait(engine, &snapshots);
+            engine.unsubscribe(&snapshots);
+            std::cout << snapshots.written() << " snapshots written to " << snapshotPath << std::endl;
+        } else {
+            renderAndWait(engine);
+        }
     } 
 
     // orbit camera around plot points
@@ -655,20 +1817,22 @@ int DL_main(dl::Args& args)
         int numFrames = 36; // default value
         std::string orbitValue = args.value("--orbit").buf();
         if (!orbitValue.empty()) {
-            try {
-                numFrames = std::stoi(orbitValue);
-            } catch (const std::invalid_argument& e) {
-                std::cerr << "Error: Invalid number for orbit frames: " << orbitValue << std::endl;
-                return 1;
-            }
+            unsigned long frames = 0;
+            parseUnsigned(orbitValue, std::numeric_limits<int>::max(), frames); // checked by checkNumberArgs()
+            numFrames = static_cast<int>(frames);
         }
 
-        auto belCamera = belScene.camera();
-        belCamera["resolution"] = dl::Vec2{320, 320};
         
         std::cout << "🎬 Starting orbit animation with " << numFrames << " frames..." << std::endl;
         
-        for (int i = 0; i < numFrames; i++) {
+        const char* frameExt = "jpg";
+        if (interpolatedOrbit) {
+            frameExt = "png";
+            double maxDisoccluded = argUnsigned(args, "--orbitdisocclusion", 2) / 100.0;
+            if (!renderInterpolatedOrbit(engine, numFrames, orbitKey, *voxelWorld, maxDisoccluded, argUnsigned(args, "--psnrmin", 30)))
+                return 1;
+        }
+        for (int i = 0; !interpolatedOrbit && i < numFrames; i++) {
             std::cout << "📹 Rendering frame " << (i + 1) << "/" << numFrames << std::endl;
             
             auto offset = dl::Vec2 {i*0.05, 0.0};
@@ -676,10 +1840,7 @@ int DL_main(dl::Args& args)
             auto belBeautyPass = belScene.beautyPass();
             belBeautyPass["outputName"] = dl::String::format("frame_%04d", i);
             
-            engine.start();
-            while(engine.rendering()) { 
-                std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-            }
+            renderAndWait(engine);
             
             std::cout << "✅ Frame " << (i + 1) << " completed" << std::endl;
         }
@@ -689,7 +1850,7 @@ int DL_main(dl::Args& args)
         // Create MP4 using ffmpeg (following example.cpp pattern)
         std::string voxFileName = std::filesystem::path(filePath).stem().string();
         std::string mp4File = voxFileName + "_orbit.mp4";
-        std::string ffmpegCmd = "ffmpeg -y -loglevel error -framerate 30 -i frame_%04d.jpg -c:v libx264 -pix_fmt yuv420p " + mp4File;
+        std::string ffmpegCmd = "ffmpeg -y -loglevel error -framerate 30 -i frame_%04d." + std::string(frameExt) + " -c:v libx264 -pix_fmt yuv420p " + mp4File;
         
         std::cout << "Executing FFmpeg command: " << ffmpegCmd << std::endl;
         int result = system(ffmpegCmd.c_str());
@@ -702,6 +1863,8 @@ int DL_main(dl::Args& args)
                 char frame_file[32];
                 snprintf(frame_file, sizeof(frame_file), "frame_%04d.jpg", i);
                 std::remove(frame_file);
+                snprintf(frame_file, sizeof(frame_file), "frame_%04d.png", i);
+                std::remove(frame_file);
             }
             std::cout << "🧹 Cleaned up individual frame files" << std::endl;
             
@@ -711,6 +1874,12 @@ int DL_main(dl::Args& args)
     } 
 
 
+    // Impostor atlas, one render per view
+    if (args.have("--impostor")) {
+        if (!renderImpostors(engine, *voxelWorld, impostorGrid, argUnsigned(args, "--impostortile", 256), impostorDepth, impostorNormal, voxPath.stem().string()))
+            return 1;
+    }
+
     belScene.write(dl::String(bszPath.string().c_str()));
 
     // Return success
@@ -0,0 +1,548 @@
+// vox2bella_bench.cpp - Differential check and benchmark of the .vox reader
+//
+// Parses a corpus of .vox files with vox2bella's ChunkParser and with the reference
+// reader from opengametools (ogt_vox.h), then
+// - compares what both decoded: model sizes and voxels, palette, materials and the
+//   instances of the scene graph (model, name and translation of each shape), and
+// - times both readers over the same in-memory buffers and prints the throughput.
+//
+// Any difference is printed and makes the program exit with 1, so parser changes
+// can be shown to be both faster and still correct before they are merged.
+//
+// With -w it times world assembly (vox2bella_world.h): many rotated, overlapping
+// placements rasterised into the lock-free BrickMap and into a mutex-guarded
+// std::unordered_map, with 1 to 64 threads, and checks that every run builds the same
+// world.
+//
+// With -g it also times the grid kernels (fill, face culling, enclosed-cell flood fill)
+// on a synthetic 256^3 model, once on the linear layout and once on the tiled one, and
+// checks both give the same faces and enclosed cells.
+//
+// Usage:
+//   vox2bella_bench [-n:<iterations>] [-g] [-w] <file.vox | directory> ...
+//   vox2bella_bench [-n:<iterations>] [-g] [-w]
+//
+// Build with "make bench" (needs the opengametools checkout next to this repo).
+// Nothing in here depends on the Bella SDK.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#define OGT_VOX_IMPLEMENTATION
+#include "ogt_vox.h"                  // reference reader, from opengametools/src
+
+#include "vox2bella_vox.h"            // buffer based .vox chunk reader
+#include "vox2bella_world.h"          // concurrent world grid
+
+namespace {
+
+struct VoxFile
+{
+    std::string path;
+    std::vector<uint8_t> data;
+};
+
+// Reads every .vox file named on the command line, directories are searched recursively
+bool loadCorpus(const std::vector<std::string>& inputs, std::vector<VoxFile>& corpus)
+{
+    std::vector<std::string> paths;
+    for (const std::string& input : inputs)
+    {
+        if (std::filesystem::is_directory(input)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(input))
+                if (entry.is_regular_file() && entry.path().extension() == ".vox")
+                    paths.push_back(entry.path().string());
+        } else {
+            paths.push_back(input);
+        }
+    }
+    for (const std::string& path : paths)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: cannot open " << path << std::endl;
+            return false;
+        }
+        VoxFile vf;
+        vf.path = path;
+        vf.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        corpus.push_back(std::move(vf));
+    }
+    return true;
+}
+
+// Keep every model and instance so model indices line up with the file's XYZI order
+const uint32_t ogtFlags = k_read_scene_flags_groups
+                        | k_read_scene_flags_keep_empty_models_instances
+                        | k_read_scene_flags_keep_duplicate_models;
+
+bool parseOurs(const VoxFile& vf, vox2bella::vox::ChunkParser& parser, std::string& error)
+{
+    if (!parser.begin(vf.data.data(), vf.data.size(), error)) return false;
+    while (!parser.done())
+        if (!parser.parse(SIZE_MAX, error)) return false;
+    return true;
+}
+
+// Collects differences for one file, printing at most a few of each kind
+class Diff
+{
+public:
+    explicit Diff(const std::string& path) : m_path(path) {}
+
+    void report(const std::string& what)
+    {
+        if (m_count++ < 10) std::cout << "  " << m_path << ": " << what << std::endl;
+    }
+    unsigned count() const { return m_count; }
+
+private:
+    std::string m_path;
+    unsigned m_count = 0;
+};
+
+void compareModels(const vox2bella::vox::ChunkParser& ours, const uint8_t* data, const ogt_vox_scene* ref, Diff& diff)
+{
+    if (ours.models.size() != ref->num_models) {
+        diff.report("model count " + std::to_string(ours.models.size()) + " vs " + std::to_string(ref->num_models));
+        return;
+    }
+    std::vector<uint8_t> grid;
+    for (size_t m = 0; m < ours.models.size(); ++m)
+    {
+        const vox2bella::vox::ModelRef& model = ours.models[m];
+        const ogt_vox_model* refModel = ref->models[m];
+        if (model.sizeX != refModel->size_x || model.sizeY != refModel->size_y || model.sizeZ != refModel->size_z) {
+            diff.report("model " + std::to_string(m) + " size differs");
+            continue;
+        }
+        // ogt_vox stores a dense grid, x fastest then y then z; later records win like in ogt_vox
+        grid.assign(size_t(model.sizeX) * model.sizeY * model.sizeZ, 0);
+        const uint8_t* records = data + model.xyziOffset;
+        for (uint32_t i = 0; i < model.numVoxels; ++i)
+        {
+            const uint8_t* v = records + i * 4;
+            if (v[0] < model.sizeX && v[1] < model.sizeY && v[2] < model.sizeZ)
+                grid[v[0] + size_t(v[1]) * model.sizeX + size_t(v[2]) * model.sizeX * model.sizeY] = v[3];
+        }
+        for (size_t c = 0; c < grid.size(); ++c)
+            if (grid[c] != refModel->voxel_data[c]) {
+                diff.report("model " + std::to_string(m) + " voxel data differs at cell " + std::to_string(c));
+                break;
+            }
+    }
+}
+
+void comparePalette(const vox2bella::vox::ChunkParser& ours, const ogt_vox_scene* ref, Diff& diff)
+{
+    // Entry 0 is never used by a voxel, ogt_vox clears its alpha
+    for (int i = 1; i < 256; ++i)
+    {
+        const ogt_vox_rgba& c = ref->palette.color[i];
+        uint32_t refColor = uint32_t(c.r) | uint32_t(c.g) << 8 | uint32_t(c.b) << 16 | uint32_t(c.a) << 24;
+        if (ours.palette[i] != refColor) {
+            diff.report("palette entry " + std::to_string(i) + " differs");
+            return;
+        }
+    }
+}
+
+void compareMaterials(const vox2bella::vox::ChunkParser& ours, const ogt_vox_scene* ref, Diff& diff)
+{
+    using namespace vox2bella::vox;
+    auto close = [](float a, float b) { return std::fabs(a - b) <= 1e-5f * std::max(1.0f, std::fabs(a)); };
+    for (const Material& m : ours.materials)
+    {
+        if (m.materialId < 0 || m.materialId > 255) continue;
+        const ogt_vox_matl& r = ref->materials.matl[m.materialId];
+        std::string id = "material " + std::to_string(m.materialId);
+        if (int(m.type) != int(r.type)) diff.report(id + " type differs");
+        if (m.has(Key_rough) && !close(m.rough, r.rough)) diff.report(id + " _rough differs");
+        if (m.has(Key_metal) && !close(m.metal, r.metal)) diff.report(id + " _metal differs");
+        if (m.has(Key_ior)   && !close(m.ior, r.ior))     diff.report(id + " _ior differs");
+        if (m.has(Key_flux)  && !close(m.flux, r.flux))   diff.report(id + " _flux differs");
+        if (m.has(Key_emit)  && !close(m.emit, r.emit))   diff.report(id + " _emit differs");
+        if (m.has(Key_trans) && !close(m.trans, r.trans)) diff.report(id + " _trans differs");
+    }
+}
+
+// Every transform whose child is a shape becomes one ogt_vox instance
+void compareInstances(const vox2bella::vox::ChunkParser& ours, const ogt_vox_scene* ref, Diff& diff)
+{
+    using Instance = std::tuple<uint32_t, std::string, int32_t, int32_t, int32_t>;
+    std::vector<Instance> mine, theirs;
+    for (const vox2bella::vox::TransformNode& t : ours.transforms)
+        for (const vox2bella::vox::ShapeNode& s : ours.shapes)
+            if (s.nodeId == t.childId && s.numModels > 0)
+                mine.emplace_back(uint32_t(ours.shapeModels[s.firstModel]), std::string(t.name),
+                                  t.translation[0], t.translation[1], t.translation[2]);
+    for (uint32_t i = 0; i < ref->num_instances; ++i)
+    {
+        const ogt_vox_instance& inst = ref->instances[i];
+        theirs.emplace_back(inst.model_index, inst.name ? inst.name : "",
+                            int32_t(inst.transform.m30), int32_t(inst.transform.m31), int32_t(inst.transform.m32));
+    }
+    // Traversal order differs between the readers, compare as sorted lists
+    std::sort(mine.begin(), mine.end());
+    std::sort(theirs.begin(), theirs.end());
+    if (mine != theirs)
+        diff.report("scene graph instances differ (" + std::to_string(mine.size()) + " vs " + std::to_string(theirs.size()) + ")");
+}
+
+// Parses the corpus 'iterations' times, returns seconds
+template <class ParseFn>
+double timeReader(const std::vector<VoxFile>& corpus, unsigned iterations, ParseFn parse)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned it = 0; it < iterations; ++it)
+        for (const VoxFile& vf : corpus)
+            parse(vf);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Synthetic 256^3 model for the grid kernels: a ground slab and a hollow building
+// with floors, so culling sees big flat surfaces and the flood fill finds rooms.
+// Records are in z, y, x order, the order the linear layout likes best.
+std::vector<uint8_t> gridBenchModel()
+{
+    std::vector<uint8_t> records;
+    for (int z = 0; z < 256; ++z)
+        for (int y = 0; y < 256; ++y)
+            for (int x = 0; x < 256; ++x)
+            {
+                bool ground = z < 4;
+                bool inside = x >= 40 && x <= 215 && y >= 40 && y <= 215 && z >= 4 && z <= 184;
+                bool wall = inside && (x < 42 || x > 213 || y < 42 || y > 213);
+                bool floor = inside && (z - 4) % 30 < 2;
+                if (ground || wall || floor) {
+                    records.push_back(uint8_t(x));
+                    records.push_back(uint8_t(y));
+                    records.push_back(uint8_t(z));
+                    records.push_back(uint8_t(1 + (x ^ y ^ z) % 8));
+                }
+            }
+    return records;
+}
+
+struct GridTimes
+{
+    double fill = 0, cull = 0, enclosed = 0;   // seconds over all iterations
+    uint64_t faces = 0, enclosedCells = 0;
+};
+
+template <class Grid>
+GridTimes timeGridKernels(const std::vector<uint8_t>& records, unsigned iterations)
+{
+    using clock = std::chrono::steady_clock;
+    const uint32_t numVoxels = uint32_t(records.size() / 4);
+    GridTimes times;
+    Grid grid;
+    for (unsigned it = 0; it < iterations; ++it)
+    {
+        auto start = clock::now();
+        vox2bella::vox::fillGrid(records.data(), numVoxels, 256, 256, 256, grid);
+        auto filled = clock::now();
+        uint64_t faces = 0;
+        for (uint32_t i = 0; i < numVoxels; ++i)
+            vox2bella::vox::exposedFaces(grid, records.data() + size_t(i) * 4, [&](int) { ++faces; });
+        auto culled = clock::now();
+        times.enclosedCells = vox2bella::vox::enclosedCells(grid);
+        auto flooded = clock::now();
+        times.faces = faces;
+        times.fill += std::chrono::duration<double>(filled - start).count();
+        times.cull += std::chrono::duration<double>(culled - filled).count();
+        times.enclosed += std::chrono::duration<double>(flooded - culled).count();
+    }
+    return times;
+}
+
+// Prints one table row per layout, returns false if the layouts disagree
+bool benchGridOrder(const char* order, const std::vector<uint8_t>& records, unsigned iterations)
+{
+    GridTimes linear = timeGridKernels<vox2bella::vox::LinearGrid>(records, iterations);
+    GridTimes tiled = timeGridKernels<vox2bella::vox::TiledGrid>(records, iterations);
+    for (const auto& row : { std::make_pair("linear", linear), std::make_pair("tiled", tiled) })
+        std::printf("%-10s %-8s %9.2f %9.2f %9.2f\n", order, row.first, row.second.fill * 1000 / iterations,
+                    row.second.cull * 1000 / iterations, row.second.enclosed * 1000 / iterations);
+    std::printf("%-10s %-8s %8.2fx %8.2fx %8.2fx\n", order, "speedup", linear.fill / tiled.fill,
+                linear.cull / tiled.cull, linear.enclosed / tiled.enclosed);
+
+    if (linear.faces != tiled.faces || linear.enclosedCells != tiled.enclosedCells) {
+        std::cout << "Grid layouts disagree: " << linear.faces << " vs " << tiled.faces << " faces, "
+                  << linear.enclosedCells << " vs " << tiled.enclosedCells << " enclosed cells" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Times the kernels with the records in grid order and shuffled, since files don't
+// promise any record order. Returns false if the layouts disagree.
+bool benchGrids(unsigned iterations)
+{
+    std::vector<uint8_t> records = gridBenchModel();
+    const size_t numVoxels = records.size() / 4;
+    std::printf("Grid kernels, 256^3, %zu voxels, %u iterations (ms per iteration)\n", numVoxels, iterations);
+    std::printf("%-10s %-8s %9s %9s %9s\n", "records", "layout", "fill", "cull", "enclosed");
+    bool ok = benchGridOrder("in order", records, iterations);
+
+    std::vector<uint32_t> packed(numVoxels);
+    std::memcpy(packed.data(), records.data(), records.size());
+    std::shuffle(packed.begin(), packed.end(), std::mt19937(1));
+    std::memcpy(records.data(), packed.data(), records.size());
+    return benchGridOrder("shuffled", records, iterations) && ok;
+}
+
+// Synthetic scene for the world assembly: 'count' placements of one 64^3 model, about a
+// third full, with random rotations and translations that overlap a lot
+struct WorldScene
+{
+    std::vector<uint8_t> records;
+    vox2bella::world::ModelVoxels model;
+    std::vector<vox2bella::vox::Placement> placements;
+};
+
+WorldScene worldBenchScene(unsigned count)
+{
+    WorldScene scene;
+    std::mt19937 random(7);
+    for (int z = 0; z < 64; ++z)
+        for (int y = 0; y < 64; ++y)
+            for (int x = 0; x < 64; ++x)
+                if (random() % 3 == 0) {
+                    scene.records.push_back(uint8_t(x));
+                    scene.records.push_back(uint8_t(y));
+                    scene.records.push_back(uint8_t(z));
+                    scene.records.push_back(uint8_t(1 + random() % 255));
+                }
+    scene.model.records = scene.records.data();
+    scene.model.numVoxels = uint32_t(scene.records.size() / 4);
+    scene.model.size[0] = scene.model.size[1] = scene.model.size[2] = 64;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        vox2bella::vox::Placement p;
+        // Packed rotation: row 0 and row 1 columns, then three sign bits
+        int c0 = int(random() % 3), c1 = (c0 + 1 + int(random() % 2)) % 3;
+        vox2bella::vox::decodeRotation(uint8_t(c0 | c1 << 2 | (random() % 8) << 4), p.rotation);
+        for (int a = 0; a < 3; ++a) p.translation[a] = int32_t(random() % 256) - 128;
+        scene.placements.push_back(p);
+    }
+    return scene;
+}
+
+// Runs fn(0) .. fn(count - 1) on 'threads' threads
+void runThreads(unsigned threads, size_t count, const std::function<void(size_t)>& fn)
+{
+    std::atomic<size_t> next{ 0 };
+    auto work = [&] { for (size_t i; (i = next.fetch_add(1)) < count;) fn(i); };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(work);
+    work();
+    for (std::thread& t : pool) t.join();
+}
+
+// FNV-1a over (brick, cells) in position order, to compare the worlds of two runs
+uint64_t worldChecksum(const std::vector<std::pair<std::array<int32_t, 3>, const uint32_t*>>& bricks)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](uint32_t v) { hash = (hash ^ v) * 1099511628211ull; };
+    for (const auto& b : bricks)
+    {
+        for (int32_t c : b.first) mix(uint32_t(c));
+        for (int i = 0; i < vox2bella::world::BrickCells; ++i) mix(b.second[i]);
+    }
+    return hash;
+}
+
+// The baseline: the same rasterisation into a std::unordered_map behind one mutex
+uint64_t assembleLocked(const WorldScene& scene, unsigned threads)
+{
+    using namespace vox2bella::world;
+    using Cells = std::array<uint32_t, BrickCells>;
+    std::unordered_map<uint64_t, std::unique_ptr<Cells>> map;
+    std::mutex mutex;
+    auto key = [](int32_t bx, int32_t by, int32_t bz) {
+        return uint64_t(uint32_t(bx) & 0x1fffff) | uint64_t(uint32_t(by) & 0x1fffff) << 21 | uint64_t(uint32_t(bz) & 0x1fffff) << 42;
+    };
+    runThreads(threads, scene.placements.size(), [&](size_t i) {
+        const vox2bella::vox::Placement& p = scene.placements[i];
+        const uint32_t order = uint32_t(i + 1);
+        const int32_t pivot = 32;
+        for (uint32_t v = 0; v < scene.model.numVoxels; ++v)
+        {
+            const uint8_t* r = scene.model.records + size_t(v) * 4;
+            int32_t w[3];
+            for (int a = 0; a < 3; ++a)
+                w[a] = p.translation[a] + p.rotation[a][0] * (r[0] - pivot) + p.rotation[a][1] * (r[1] - pivot) + p.rotation[a][2] * (r[2] - pivot);
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unique_ptr<Cells>& cells = map[key(brickOf(w[0]), brickOf(w[1]), brickOf(w[2]))];
+            if (!cells) { cells.reset(new Cells()); cells->fill(0); }
+            uint32_t& cell = (*cells)[size_t(cellOf(w[0], w[1], w[2]))];
+            if ((cell >> 8) <= order) cell = order << 8 | r[3];
+        }
+    });
+    std::vector<std::pair<std::array<int32_t, 3>, const uint32_t*>> bricks;
+    for (const auto& entry : map)
+    {
+        auto unbias = [](uint64_t v) { return int32_t(uint32_t(v << 11) ) >> 11; };
+        std::array<int32_t, 3> at = { unbias(entry.first & 0x1fffff), unbias(entry.first >> 21 & 0x1fffff), unbias(entry.first >> 42 & 0x1fffff) };
+        bricks.emplace_back(at, entry.second->data());
+    }
+    std::sort(bricks.begin(), bricks.end(), [](const auto& a, const auto& b) {
+        return std::make_tuple(a.first[2], a.first[1], a.first[0]) < std::make_tuple(b.first[2], b.first[1], b.first[0]);
+    });
+    return worldChecksum(bricks);
+}
+
+uint64_t assembleBricks(const WorldScene& scene, unsigned threads)
+{
+    using namespace vox2bella::world;
+    size_t maxBricks = 0;
+    for (const vox2bella::vox::Placement& p : scene.placements) maxBricks += brickBound(p, scene.model);
+    BrickMap map(maxBricks);
+    runThreads(threads, scene.placements.size(), [&](size_t i) {
+        rasterise(map, scene.placements[i], uint32_t(i + 1), scene.model);
+    });
+    std::vector<std::pair<std::array<int32_t, 3>, const uint32_t*>> bricks;
+    std::vector<std::array<uint32_t, BrickCells>> copies;
+    std::vector<BrickRef> refs = map.sortedBricks();
+    copies.resize(refs.size());
+    for (size_t b = 0; b < refs.size(); ++b)
+    {
+        for (int c = 0; c < BrickCells; ++c) copies[b][size_t(c)] = refs[b].brick->cells[c].load();
+        bricks.emplace_back(std::array<int32_t, 3>{ refs[b].bx, refs[b].by, refs[b].bz }, copies[b].data());
+    }
+    return worldChecksum(bricks);
+}
+
+// Prints the world assembly scaling table, returns false if any run built a different world
+bool benchWorld(unsigned iterations)
+{
+    WorldScene scene = worldBenchScene(96);
+    const double voxels = double(scene.model.numVoxels) * scene.placements.size();
+    std::printf("World assembly, %zu placements of %u voxels, %u iterations, %u hardware threads (Mvoxels/s)\n",
+                scene.placements.size(), scene.model.numVoxels, iterations, std::thread::hardware_concurrency());
+    std::printf("%-8s %12s %12s %8s\n", "threads", "brick map", "locked map", "ratio");
+
+    uint64_t reference = 0;
+    bool ok = true;
+    for (unsigned threads = 1; threads <= 64; threads *= 2)
+    {
+        double seconds[2] = { 0, 0 };
+        for (unsigned it = 0; it < iterations; ++it)
+        {
+            uint64_t sums[2];
+            for (int m = 0; m < 2; ++m)
+            {
+                auto start = std::chrono::steady_clock::now();
+                sums[m] = m == 0 ? assembleBricks(scene, threads) : assembleLocked(scene, threads);
+                seconds[m] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            if (!reference) reference = sums[1];
+            if (sums[0] != reference || sums[1] != reference) ok = false;
+        }
+        std::printf("%-8u %12.1f %12.1f %7.2fx\n", threads, voxels * iterations / seconds[0] / 1e6,
+                    voxels * iterations / seconds[1] / 1e6, seconds[1] / seconds[0]);
+    }
+    if (!ok) std::cout << "World assembly: runs built different worlds" << std::endl;
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    unsigned iterations = 10;
+    bool grids = false, worlds = false;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("-n:", 0) == 0) iterations = std::max(1, std::atoi(arg.c_str() + 3));
+        else if (arg == "-g") grids = true;
+        else if (arg == "-w") worlds = true;
+        else inputs.push_back(arg);
+    }
+    if (inputs.empty() && !grids && !worlds) {
+        std::cout << "Usage: vox2bella_bench [-n:<iterations>] [-g] [-w] <file.vox | directory> ..." << std::endl;
+        return 1;
+    }
+    bool gridsOk = !grids || benchGrids(iterations);
+    gridsOk = (!worlds || benchWorld(iterations)) && gridsOk;
+    if (inputs.empty()) return gridsOk ? 0 : 1;
+
+    std::vector<VoxFile> corpus;
+    if (!loadCorpus(inputs, corpus)) return 1;
+    size_t totalBytes = 0;
+    for (const VoxFile& vf : corpus) totalBytes += vf.data.size();
+    std::cout << "Corpus: " << corpus.size() << " files, " << totalBytes << " bytes" << std::endl;
+
+    // Differential check
+    unsigned badFiles = 0;
+    for (const VoxFile& vf : corpus)
+    {
+        Diff diff(vf.path);
+        vox2bella::vox::ChunkParser ours;
+        std::string error;
+        bool oursOk = parseOurs(vf, ours, error);
+        const ogt_vox_scene* ref = ogt_vox_read_scene_with_flags(vf.data.data(), uint32_t(vf.data.size()), ogtFlags);
+        if (!oursOk || !ref) {
+            // Both readers must agree on rejecting a damaged file
+            if (oursOk != (ref != nullptr))
+                diff.report(std::string("only ") + (oursOk ? "vox2bella" : "ogt_vox") + " accepted the file" + (oursOk ? "" : " (" + error + ")"));
+        } else {
+            compareModels(ours, vf.data.data(), ref, diff);
+            comparePalette(ours, ref, diff);
+            compareMaterials(ours, ref, diff);
+            compareInstances(ours, ref, diff);
+        }
+        if (ref) ogt_vox_destroy_scene(ref);
+        if (diff.count()) ++badFiles;
+    }
+    std::cout << "Differential check: " << (corpus.size() - badFiles) << " of " << corpus.size() << " files match" << std::endl;
+
+    // Throughput. Our side includes a pass over every voxel record, which is the work
+    // the converter's decode stage adds on top of the chunk walk; ogt_vox builds its
+    // dense grids as part of reading.
+    volatile uint64_t sink = 0;
+    double oursSeconds = timeReader(corpus, iterations, [&](const VoxFile& vf) {
+        vox2bella::vox::ChunkParser parser;
+        std::string error;
+        if (!parseOurs(vf, parser, error)) return;
+        uint64_t sum = 0;
+        for (const auto& model : parser.models)
+        {
+            const uint8_t* records = vf.data.data() + model.xyziOffset;
+            for (uint32_t i = 0; i < model.numVoxels; ++i) sum += records[i * 4 + 3];
+        }
+        sink = sink + sum;
+    });
+    double refSeconds = timeReader(corpus, iterations, [&](const VoxFile& vf) {
+        const ogt_vox_scene* scene = ogt_vox_read_scene_with_flags(vf.data.data(), uint32_t(vf.data.size()), ogtFlags);
+        if (scene) { sink = sink + scene->num_models; ogt_vox_destroy_scene(scene); }
+    });
+
+    double megabytes = double(totalBytes) * iterations / (1024.0 * 1024.0);
+    std::printf("vox2bella: %8.3f s  %10.1f MB/s\n", oursSeconds, megabytes / oursSeconds);
+    std::printf("ogt_vox:   %8.3f s  %10.1f MB/s\n", refSeconds, megabytes / refSeconds);
+    std::printf("speedup:   %8.2fx\n", refSeconds / oursSeconds);
+
+    return badFiles || !gridsOk ? 1 : 0;
+}
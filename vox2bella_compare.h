@@ -0,0 +1,70 @@
+// vox2bella_compare.h - Image comparison for the render regression harness
+//
+// Faster emission and preview modes can change the look in ways a geometric check
+// won't catch (bevels, ambient occlusion, level of detail). The --compare mode
+// renders each file through every mode and compares the image to the reference
+// mode's image with two measures:
+//   PSNR  peak signal-to-noise ratio over RGB in dB, higher is closer (identical = inf)
+//   SSIM  structural similarity of luma over 8x8 windows, 1 = identical; tracks
+//         perceived differences (edges, shading) better than PSNR does
+// Pixels are 8-bit RGBA, top row first, alpha is ignored.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace vox2bella { namespace compare {
+
+inline double psnr(const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height)
+{
+    const size_t pixels = size_t(width) * height;
+    if (pixels == 0) return 0.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < pixels; ++i)
+        for (int c = 0; c < 3; ++c)
+        {
+            double d = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+            sum += d * d;
+        }
+    double mse = sum / double(pixels * 3);
+    if (mse == 0.0) return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// Rec. 709 luma of one pixel, 0..255
+inline double luma(const uint8_t* p)
+{
+    return 0.2126 * p[0] + 0.7152 * p[1] + 0.0722 * p[2];
+}
+
+// Mean SSIM over non-overlapping 8x8 windows (a partial last row/column is skipped)
+inline double ssim(const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height)
+{
+    const double c1 = (0.01 * 255) * (0.01 * 255), c2 = (0.03 * 255) * (0.03 * 255);
+    const uint32_t window = 8;
+    double total = 0.0;
+    size_t windows = 0;
+    for (uint32_t wy = 0; wy + window <= height; wy += window)
+        for (uint32_t wx = 0; wx + window <= width; wx += window)
+        {
+            double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+            for (uint32_t y = wy; y < wy + window; ++y)
+                for (uint32_t x = wx; x < wx + window; ++x)
+                {
+                    size_t i = (size_t(y) * width + x) * 4;
+                    double la = luma(a + i), lb = luma(b + i);
+                    sa += la; sb += lb;
+                    saa += la * la; sbb += lb * lb; sab += la * lb;
+                }
+            const double n = window * window;
+            double ma = sa / n, mb = sb / n;
+            double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+            total += ((2 * ma * mb + c1) * (2 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+            ++windows;
+        }
+    return windows ? total / double(windows) : 0.0;
+}
+
+}} // namespace vox2bella::compare
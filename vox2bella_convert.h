@@ -0,0 +1,1296 @@
+// vox2bella_convert.h - Stepwise .vox to Bella conversion for embedding in other programs
+//
+// A blocking conversion of a big model would stall an editor's UI thread, so the
+// Converter does its work in small resumable pieces:
+//
+//     vox2bella::Converter conv;
+//     conv.begin(scene, bytes, size, "mymodel");     // scene must have its definitions loaded
+//     while (!conv.step(2000)) {                     // at most ~2 ms per call
+//         drawProgressBar(conv.progress());
+//         ... rest of the frame ...
+//     }
+//     conv.finish();                                  // frames the camera, reports errors
+//
+// Work is split into stages that each pick up where the previous call stopped:
+//   parse   walk the chunk headers (a few dozen chunks at a time), then create the
+//           palette's materials (32 per slice)
+//   decode  validate each model's voxels, apply the crop box and grow the scene extents
+//   analyse flood-fill each model's grid for enclosed rooms (with autoRender), 64K
+//           cells per slice
+//   mesh    build face-culled quads per color (mesh and world emission only, see
+//           vox2bella_mesh.h): clear the model's grid 16 z-layers at a time, fill it,
+//           then mesh a thousand voxels per slice
+//   emit    create the Bella nodes, a handful of voxels or one mesh per slice
+// The budget is checked between slices, so a step overruns by at most one slice.
+//
+// The command line tool uses the same object with no time budget. Services can also
+// hand it a parallelFor: the models of a file are then cut into pieces of 64K voxels
+// and decoded, analysed and meshed side by side on the service's workers before the
+// (single threaded) emit stage, so a single huge model is spread out too.
+//
+// Options can restrict the work to part of a file: a model selection (by index or
+// by the name of a transform in the scene graph) and a crop box. Models that are not
+// selected are never read, their XYZI payloads are skipped by offset, and cropping
+// happens inside the decode stage, so converting a fragment of a huge scene costs
+// time in proportion to the fragment.
+//
+// For rendering huge files interactively, a proxy can go in first: right after
+// parsing, each model gets one box per occupied block of k*k*k voxels and the camera
+// is framed, so the engine can start on that. The full geometry follows through the
+// usual stages, and each model's proxy leaves the scene once its own geometry is in.
+//
+// World emission places the models by the scene graph instead of at their own origin.
+// Its mesh stage rasterises every placement into one BrickMap (vox2bella_world.h),
+// in parallel when a parallelFor is given, and meshes that as a whole. It runs as one
+// slice.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "vox2bella_materials.h"
+#include "vox2bella_mesh.h"
+#include "vox2bella_record.h"
+#include "vox2bella_vox.h"
+#include "vox2bella_world.h"
+
+namespace vox2bella {
+
+// How voxels become Bella geometry
+enum EmitMode
+{
+    EmitInstanced,  // one bevelled box instance per voxel (the original look)
+    EmitMesh,       // one face-culled mesh per model and color, far fewer nodes
+    EmitWorld,      // models placed by the scene graph, one face-culled mesh per color
+};
+
+// Axis-aligned bounds of all emitted voxels, used to frame the camera
+// Model coordinates, or world coordinates with EmitWorld
+struct Extents
+{
+    bool any = false;
+    int32_t min[3] = { 0, 0, 0 };
+    int32_t max[3] = { 0, 0, 0 };
+
+    void add(int32_t x, int32_t y, int32_t z)
+    {
+        if (!any) {
+            // First voxel - initialize min/max
+            min[0] = max[0] = x; min[1] = max[1] = y; min[2] = max[2] = z;
+            any = true;
+            return;
+        }
+        if (x < min[0]) min[0] = x;
+        if (x > max[0]) max[0] = x;
+        if (y < min[1]) min[1] = y;
+        if (y > max[1]) max[1] = y;
+        if (z < min[2]) min[2] = z;
+        if (z > max[2]) max[2] = z;
+    }
+
+    void merge(const Extents& other)
+    {
+        if (!other.any) return;
+        add(other.min[0], other.min[1], other.min[2]);
+        add(other.max[0], other.max[1], other.max[2]);
+    }
+};
+
+// Function to create the basic scene (camera, lights, ground) and the render output settings
+inline void setupScene(dl::bella_sdk::Scene belScene, const std::string& outputName)
+{
+    oom::bella::defaultScene2025(belScene); // create the basic scene elements in Bella
+    belScene.beautyPass()["outputExt"] = ".jpg";
+    belScene.beautyPass()["outputName"] = outputName.c_str();
+    auto imgOutputPath = belScene.createNode("outputImagePath", "voxOutputPath");
+    imgOutputPath["ext"] = ".jpg";
+    imgOutputPath["dir"] = ".";
+    belScene.beautyPass()["saveImage"] = dl::Int(0);
+    belScene.beautyPass()["overridePath"] = imgOutputPath;
+}
+
+// Render quality presets, chosen with --quality
+// Draft aims at a few seconds per frame on the CPU: small image, early stop on noise,
+// few bounces, and the denoiser hides what noise is left. Final keeps the scene's
+// own resolution and renders until the noise target is low, without denoising.
+struct RenderPreset
+{
+    const char* name;
+    int resolution;     // square image size in pixels, 0 = keep the scene's resolution
+    int targetNoise;    // Bella stops refining once the estimated noise drops below this
+    int maxBounces;     // path depth
+    bool denoise;
+};
+
+inline const RenderPreset renderPresets[] = {
+    { "draft",  320, 40,  2, true  },
+    { "review", 960, 12,  6, true  },
+    { "final",  0,    3, 16, false },
+};
+
+// Returns the preset called 'name', or nullptr
+inline const RenderPreset* findRenderPreset(const std::string& name)
+{
+    for (const RenderPreset& preset : renderPresets)
+        if (name == preset.name) return &preset;
+    return nullptr;
+}
+
+// What the converter found in the voxels it kept, used to pick render settings
+struct ContentSummary
+{
+    bool glass = false;         // a used color has a glass or media material
+    bool emitters = false;      // a used color has an emissive material
+    bool metal = false;         // a used color has a metal material
+    uint64_t emptyCells = 0;    // inside the model boxes
+    uint64_t enclosedCells = 0; // empty cells not reachable from outside (rooms, cavities)
+    int extent = 0;             // longest side of the voxel extents
+};
+
+// Render settings derived from a ContentSummary
+struct RenderHints
+{
+    int maxBounces = 3;
+    int targetNoise = 10;
+};
+
+// Open diffuse props converge with a few bounces. Light has to bounce its way into
+// enclosed rooms, metal needs a few specular bounces and glass needs enough depth to
+// pass through several surfaces. Small emitters are noisy, so they get a lower noise target.
+inline RenderHints renderHints(const ContentSummary& content)
+{
+    RenderHints hints;
+    hints.maxBounces = content.extent < 16 ? 2 : 3;
+    hints.targetNoise = 12;
+    bool enclosed = content.emptyCells && content.enclosedCells * 100 >= content.emptyCells; // at least 1% of the air is indoors
+    if (enclosed)        { hints.maxBounces = std::max(hints.maxBounces, 8);  hints.targetNoise = 8; }
+    if (content.metal)   hints.maxBounces = std::max(hints.maxBounces, 6);
+    if (content.glass)   hints.maxBounces = std::max(hints.maxBounces, 12);
+    if (content.emitters) hints.targetNoise = std::min(hints.targetNoise, 6);
+    return hints;
+}
+
+// Function to write content-based settings into the beauty pass
+inline void applyRenderHints(dl::bella_sdk::Scene belScene, const RenderHints& hints, record::SceneLog* log = nullptr)
+{
+    dl::bella_sdk::Scene::EventScope es(belScene);
+    record::RecordingScene scene(belScene, log);
+    auto beautyPass = scene.root(record::RootBeautyPass);
+    scene.setInt(beautyPass, "targetNoise", hints.targetNoise);
+    scene.setInt(beautyPass, "maxBounces", hints.maxBounces);
+}
+
+// Function to apply a preset to the scene's camera and beauty pass
+// With content hints, the bounce depth is the lower of the two: a draft of a glass
+// scene stays a draft, and a final render of a plain prop doesn't waste bounces
+inline void applyRenderPreset(dl::bella_sdk::Scene belScene, const RenderPreset& preset, const RenderHints* hints = nullptr,
+                              record::SceneLog* log = nullptr)
+{
+    dl::bella_sdk::Scene::EventScope es(belScene);
+    record::RecordingScene scene(belScene, log);
+    const int maxBounces = hints ? std::min(preset.maxBounces, hints->maxBounces) : preset.maxBounces;
+    if (preset.resolution > 0)
+        scene.setVec2(scene.root(record::RootCamera), "resolution", dl::Vec2{ double(preset.resolution), double(preset.resolution) });
+    auto beautyPass = scene.root(record::RootBeautyPass);
+    scene.setInt(beautyPass, "targetNoise", preset.targetNoise);
+    scene.setInt(beautyPass, "maxBounces", maxBounces);
+    scene.setBool(beautyPass, "denoise", preset.denoise);
+}
+
+// Function to create the shared box that every voxel instance points at
+inline dl::bella_sdk::Node createVoxelBox(dl::bella_sdk::Scene belScene, record::SceneLog* log = nullptr)
+{
+    record::RecordingScene scene(belScene, log);
+    auto voxel = scene.create("box", "box1");
+    scene.setReal(voxel, "radius", 0.33f);
+    for (const char* size : { "sizeX", "sizeY", "sizeZ" }) scene.setReal(voxel, size, 0.99f);
+    return voxel.node;
+}
+
+// Function to create the materials of palette entries [begin, end) from their specs (see vox2bella_materials.h)
+// Entries with the same spec share one node, named voxMat<first index>. Earlier entries
+// must have been created already, so the palette can be done a few entries per call.
+// Returns the number of nodes created
+inline size_t createPaletteMaterials(dl::bella_sdk::Scene belScene, const materials::MaterialSpec (&specs)[256], dl::bella_sdk::Node (&nodes)[256],
+                                     record::SceneLog* log = nullptr, int begin = 0, int end = 256)
+{
+    using namespace materials;
+    record::RecordingScene scene(belScene, log);
+    size_t created = 0;
+    for(int i=begin; i<end; i++)
+    {
+        const MaterialSpec& spec = specs[i];
+        int first = 0;
+        while (first < i && (MaterialSpec::less(specs[first], spec) || MaterialSpec::less(spec, specs[first]))) ++first;
+        if (first < i) { nodes[i] = nodes[first]; continue; }
+
+        // Extract RGBA components from the palette color
+        // Bit shifting and masking extracts individual byte components
+        uint8_t r = (spec.color >> 0) & 0xFF;   // Red (lowest byte)
+        uint8_t g = (spec.color >> 8) & 0xFF;   // Green (second byte)
+        uint8_t b = (spec.color >> 16) & 0xFF;  // Blue (third byte)
+        uint8_t a = (spec.color >> 24) & 0xFF;  // Alpha (highest byte)
+        // Convert 0-255 values to 0.0-1.0 range
+        dl::Rgba color{ r/255.0, g/255.0, b/255.0, a/255.0 };
+
+        // Create a unique material name
+        dl::String nodeName = dl::String("voxMat") + dl::String(i);
+        auto voxMat = scene.create(nodeType(spec.cls), nodeName);
+        {
+            dl::bella_sdk::Scene::EventScope es(belScene);
+            // Bella roughness is in percent
+            switch (spec.cls)
+            {
+                case ClassDiffuse:
+                    scene.setRgba(voxMat, "reflectance", color);
+                    break;
+                case ClassConductor:
+                    scene.setRgba(voxMat, "reflectance", color);
+                    scene.setReal(voxMat, "roughness", spec.roughness * 100.0);
+                    break;
+                case ClassDielectric:
+                    scene.setRgba(voxMat, "transmittance", color);
+                    scene.setReal(voxMat, "ior", spec.ior);
+                    scene.setReal(voxMat, "roughness", spec.roughness * 100.0);
+                    if (spec.depth > 0.0f) scene.setReal(voxMat, "depth", spec.depth);
+                    break;
+                case ClassEmitter:
+                    scene.setRgba(voxMat, "color", color);
+                    scene.setReal(voxMat, "energy", spec.energy);
+                    break;
+                default:
+                    scene.setRgba(voxMat, "base", color);
+                    scene.setReal(voxMat, "metallic", spec.metallic * 100.0);
+                    scene.setReal(voxMat, "transmission", spec.transmission * 100.0);
+                    scene.setReal(voxMat, "roughness", spec.roughness * 100.0);
+                    scene.setReal(voxMat, "ior", spec.ior);
+                    break;
+            }
+        }
+        nodes[i] = voxMat.node;
+        ++created;
+    }
+    return created;
+}
+
+// Function to place a single voxel in the Bella scene as an instance of the shared box
+// 'index' makes the node name unique, voxXform<index>
+inline void emitVoxelInstance(dl::bella_sdk::Scene belScene, dl::bella_sdk::Node voxel, dl::bella_sdk::Node material,
+                              uint32_t index, uint8_t x, uint8_t y, uint8_t z, record::SceneLog* log = nullptr)
+{
+    record::RecordingScene scene(belScene, log);
+    // Create a unique name for this voxel's transform node
+    dl::String voxXformName = dl::String("voxXform") + dl::String(static_cast<int>(index));
+    // Create a transform node in the Bella scene, parented to the world root
+    auto xform = scene.create("xform", voxXformName);
+    scene.parent(xform, scene.root(record::RootWorld));
+    // Parent the voxel geometry to this transform
+    scene.parent(scene.existing(voxel), xform);
+    // Set the transform matrix to position the voxel at (x,y,z)
+    // This is a 4x4 transformation matrix - standard in 3D graphics
+    scene.setMat4(xform, "steps/0/xform", dl::Mat4 { 1, 0, 0, 0,
+                                                     0, 1, 0, 0,
+                                                     0, 0, 1, 0,
+                                                     static_cast<double>(x*1),
+                                                     static_cast<double>(y*1),
+                                                     static_cast<double>(z*1), 1});
+    scene.setNode(xform, "material", scene.existing(material));
+}
+
+// Function to point the camera at the voxels and print where they are to 'out'
+inline void frameCamera(dl::bella_sdk::Scene belScene, const Extents& extents, record::SceneLog* log = nullptr, std::ostream& out = std::cout)
+{
+    if (extents.any) {
+        // Calculate the center of the voxel extents
+        double centerX = (extents.min[0] + extents.max[0]) / 2.0;
+        double centerY = (extents.min[1] + extents.max[1]) / 2.0;
+        double centerZ = (extents.min[2] + extents.max[2]) / 2.0;
+        dl::Vec3 target{centerX, centerY, centerZ};
+
+        // Calculate the radius (half the diagonal of the bounding box)
+        double sizeX = extents.max[0] - extents.min[0] + 1;  // +1 because voxels have size
+        double sizeY = extents.max[1] - extents.min[1] + 1;
+        double sizeZ = extents.max[2] - extents.min[2] + 1;
+        double radius = sqrt(sizeX*sizeX + sizeY*sizeY + sizeZ*sizeZ) / 2.0;
+
+        // Use zoomExtents to position the camera
+        dl::Mat4 cameraMatrix = dl::bella_sdk::zoomExtents(belScene.cameraPath(), target, radius);
+
+        auto belCameraPath = belScene.cameraPath(); // Since camera can be instanced, we get the full path of th one currently define din scene settings
+        auto belCameraXform = belCameraPath.parent(); // thus the parent of the camera path is the xform node 99% of the time
+
+        // Apply the calculated camera transformation
+        {
+            dl::bella_sdk::Scene::EventScope es(belScene);
+            belCameraXform["steps"][0]["xform"] = cameraMatrix;
+        }
+
+        out << "Voxel extents: (" << static_cast<int>(extents.min[0]) << "," << static_cast<int>(extents.min[1]) << "," << static_cast<int>(extents.min[2])
+                  << ") to (" << static_cast<int>(extents.max[0]) << "," << static_cast<int>(extents.max[1]) << "," << static_cast<int>(extents.max[2]) << ")" << std::endl;
+        out << "Center: (" << centerX << "," << centerY << "," << centerZ << "), Radius: " << radius << std::endl;
+    }
+
+    auto offset1 = dl::Vec2 {-90, 0.0};
+    dl::bella_sdk::orbitCamera(belScene.cameraPath(),offset1);
+    // The SDK helpers set the camera themselves, so the matrix it ended up with is
+    // set once more through the recording scene
+    record::RecordingScene scene(belScene, log);
+    scene.setMat4(scene.root(record::RootCameraXform), "steps/0/xform", belScene.cameraPath().parent()["steps"][0]["xform"].asMat4());
+}
+
+// Inclusive box in model voxel coordinates, voxels outside it are dropped while decoding
+struct Crop
+{
+    bool enabled = false;
+    uint8_t min[3] = { 0, 0, 0 };
+    uint8_t max[3] = { 255, 255, 255 };
+};
+
+// Parses "x0,y0,z0:x1,y1,z1", coordinates 0..255, corners may be given in any order
+inline bool parseCrop(const std::string& text, Crop& crop)
+{
+    int v[6];
+    int used = 0;
+    if (std::sscanf(text.c_str(), "%d,%d,%d:%d,%d,%d%n", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &used) != 6 || size_t(used) != text.size())
+        return false;
+    for (int i = 0; i < 6; ++i)
+        if (v[i] < 0 || v[i] > 255) return false;
+    for (int a = 0; a < 3; ++a)
+    {
+        crop.min[a] = uint8_t(std::min(v[a], v[a + 3]));
+        crop.max[a] = uint8_t(std::max(v[a], v[a + 3]));
+    }
+    crop.enabled = true;
+    return true;
+}
+
+// Copies the XYZI records that lie inside the crop box to 'out' (room for 'count'
+// records) and returns how many were kept. The loop body has no branches so the
+// compiler can vectorise it: every record is stored and the write position only
+// advances for the ones inside. Records outside the model are counted in 'outOfBounds'.
+inline uint32_t cropRecords(const uint8_t* in, uint32_t count, const Crop& crop,
+                            uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ, uint8_t* out, uint32_t& outOfBounds)
+{
+    const uint8_t lo0 = crop.min[0], lo1 = crop.min[1], lo2 = crop.min[2];
+    const uint8_t span0 = uint8_t(crop.max[0] - lo0), span1 = uint8_t(crop.max[1] - lo1), span2 = uint8_t(crop.max[2] - lo2);
+    uint32_t kept = 0, bad = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint8_t* v = in + size_t(i) * 4;
+        bad += uint32_t(v[0] >= sizeX) | uint32_t(v[1] >= sizeY) | uint32_t(v[2] >= sizeZ);
+        // Unsigned wrap-around turns each two-sided range test into a single compare
+        uint32_t inside = uint32_t(uint8_t(v[0] - lo0) <= span0) & uint32_t(uint8_t(v[1] - lo1) <= span1) & uint32_t(uint8_t(v[2] - lo2) <= span2);
+        std::memcpy(out + size_t(kept) * 4, v, 4);
+        kept += inside;
+    }
+    outOfBounds += bad;
+    return kept;
+}
+
+// What the Converter should produce
+struct ConvertOptions
+{
+    EmitMode emit = EmitInstanced;
+    // Only convert this model index (-1 = all), or the models under transforms with this name
+    int model = -1;
+    std::string modelName;
+    // Only convert voxels inside this box
+    Crop crop;
+    // Pick bounce depth and noise target from the content (materials, enclosed rooms, size)
+    bool autoRender = true;
+    // Render preset written into the scene, may be nullptr
+    const RenderPreset* preset = nullptr;
+    // Called after each model has been emitted, a safe point for services to pause
+    std::function<void()> onModelDone;
+    // Receives the XYZI records of each converted model (after the crop) when finish() succeeds
+    // Not called with EmitWorld, whose voxels are not in model coordinates
+    std::function<void(const uint8_t* records, uint32_t count)> onModelVoxels;
+    // With proxyCells > 0, a coarse proxy of at most about that many boxes is emitted
+    // right after parsing, then onProxyReady is called (to start the engine, say).
+    // Each model's proxy is removed once its geometry is emitted. Not with EmitWorld.
+    unsigned proxyCells = 0;
+    std::function<void()> onProxyReady;
+    // Receives the progress messages, std::cout if null. Services that run several
+    // conversions at once give each its own buffer and print it under their output lock.
+    std::ostream* progress = nullptr;
+    // Appends the scene calls of the conversion, may be nullptr (see vox2bella_record.h)
+    record::SceneLog* record = nullptr;
+    // Runs fn(0) .. fn(count - 1), possibly on several threads, and returns once all
+    // calls have finished. When set, the selected models are prepared in parallel if
+    // they hold at least parallelMinVoxels voxels (counted from their chunk headers).
+    std::function<void(size_t count, const std::function<void(size_t)>& fn)> parallelFor;
+    uint64_t parallelMinVoxels = 0;
+};
+
+class Converter
+{
+public:
+    enum Stage { StageIdle, StageParse, StageDecode, StageAnalyse, StageMesh, StageEmit, StageDone, StageFailed };
+
+    using Options = ConvertOptions;
+
+    // Starts a conversion of a .vox file that is already in memory
+    // The buffer is borrowed and must stay alive until finish() returns
+    bool begin(dl::bella_sdk::Scene belScene, const uint8_t* data, size_t size, const std::string& outputName, const Options& options = Options())
+    {
+        m_scene = belScene;
+        m_options = options;
+        m_data = data;
+        m_stage = StageParse;
+        m_error.clear();
+        m_model = m_voxel = m_group = 0;
+        m_palette = 0;
+        m_gridPhase = GridStart;
+        m_flooding = false;
+        m_materialNodes = 0;
+        m_totalVoxels = m_keptVoxels = m_emitted = m_meshed = m_decoded = 0;
+        m_extents = Extents();
+        m_meshes.clear();
+        m_work.clear();
+        m_cropped.clear();
+        m_content = ContentSummary();
+        std::memset(m_usedColors, 0, sizeof(m_usedColors));
+        m_proxies.clear();
+        m_proxiesLeft = 0;
+        m_proxyFramed = false;
+
+        if (!m_parser.begin(data, size, m_error)) return fail();
+        setupScene(m_scene, outputName);
+        if (m_options.emit == EmitInstanced) m_box = createVoxelBox(m_scene, m_options.record);
+        return true;
+    }
+
+    // Same, reading the whole file first (file I/O itself is not time-sliced)
+    bool begin(dl::bella_sdk::Scene belScene, const std::string& path, const std::string& outputName, const Options& options = Options())
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            m_stage = StageFailed;
+            m_error = "Error opening file.";
+            return false;
+        }
+        m_owned.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return begin(belScene, m_owned.data(), m_owned.size(), outputName, options);
+    }
+
+    // Does at most about budgetMicros of work, returns true once the conversion is
+    // complete or has failed (check failed()/error())
+    bool step(uint64_t budgetMicros)
+    {
+        using clock = std::chrono::steady_clock;
+        const clock::time_point deadline = budgetMicros == UINT64_MAX ? clock::time_point::max()
+                                         : clock::now() + std::chrono::microseconds(budgetMicros);
+        while (m_stage != StageDone && m_stage != StageFailed)
+        {
+            switch (m_stage)
+            {
+                case StageParse:  stepParse();  break;
+                case StageDecode: stepDecode(); break;
+                case StageAnalyse: stepAnalyse(); break;
+                case StageMesh:   stepMesh();   break;
+                case StageEmit:   stepEmit();   break;
+                default: break;
+            }
+            if (clock::now() >= deadline) break;
+        }
+        return m_stage == StageDone || m_stage == StageFailed;
+    }
+
+    // Completes any remaining work without a budget and frames the camera
+    bool finish()
+    {
+        step(UINT64_MAX);
+        if (m_stage == StageFailed) {
+            std::cerr << "Error: " << m_error << std::endl;
+            return false;
+        }
+        // A proxy framed the camera on the same voxels already
+        if (!m_proxyFramed) frameCamera(m_scene, m_extents, m_options.record, out());
+        reportMaterials();
+        if (m_options.onModelVoxels && m_options.emit != EmitWorld)
+            for (const ModelWork& w : m_work) m_options.onModelVoxels(w.records, w.numVoxels);
+
+        // Render settings: a preset if one was asked for, narrowed by the content
+        RenderHints hints = renderHints(m_content);
+        if (m_options.preset)
+            applyRenderPreset(m_scene, *m_options.preset, m_options.autoRender ? &hints : nullptr, m_options.record);
+        else if (m_options.autoRender)
+            applyRenderHints(m_scene, hints, m_options.record);
+        if (m_options.autoRender && !m_options.preset)
+            out() << "Render settings from content: " << hints.maxBounces << " bounces, noise target " << hints.targetNoise
+                      << (m_content.glass ? ", glass" : "") << (m_content.metal ? ", metal" : "") << (m_content.emitters ? ", emitters" : "")
+                      << (m_content.enclosedCells ? ", enclosed interior" : "") << std::endl;
+        return true;
+    }
+
+    // 0..1, weighted by how long each stage typically takes
+    double progress() const
+    {
+        if (m_stage == StageDone) return 1.0;
+        const double wParse = 0.05, wDecode = 0.10, wAnalyse = m_options.autoRender ? 0.05 : 0.0;
+        const double wMesh = m_options.emit != EmitInstanced ? 0.25 : 0.0, wEmit = 0.60;
+        const double total = wParse + wDecode + wAnalyse + wMesh + wEmit;
+        double parse = m_parser.size() ? double(m_parser.offset()) / double(m_parser.size()) : 0.0;
+        double decode = m_totalVoxels ? double(m_decoded) / double(m_totalVoxels) : 0.0;
+        double analyse = m_work.size() && m_stage == StageAnalyse ? double(m_model) / double(m_work.size()) : 0.0;
+        double mesh = m_keptVoxels ? double(m_meshed) / double(m_keptVoxels) : 0.0;
+        double emit = m_keptVoxels ? double(m_emitted) / double(m_keptVoxels) : 0.0;
+        if (m_stage > StageParse)   parse = 1.0;
+        if (m_stage > StageDecode)  decode = 1.0;
+        if (m_stage > StageAnalyse) analyse = 1.0;
+        if (m_stage > StageMesh)    mesh = 1.0;
+        return (wParse * parse + wDecode * decode + wAnalyse * analyse + wMesh * mesh + wEmit * emit) / total;
+    }
+
+    Stage stage() const { return m_stage; }
+    bool failed() const { return m_stage == StageFailed; }
+    const std::string& error() const { return m_error; }
+    // Voxels that passed the model selection and crop (final once decoding is done)
+    size_t voxelCount() const { return m_keptVoxels; }
+    const Extents& extents() const { return m_extents; }
+    // Filled in by the analyse stage (only with options.autoRender)
+    const ContentSummary& content() const { return m_content; }
+
+private:
+    // A selected model and the voxels the later stages work on: the XYZI payload in
+    // the file buffer, or the cropped copy once decoding has filtered it
+    struct ModelWork
+    {
+        uint32_t model = 0;
+        const uint8_t* records = nullptr;
+        uint32_t numVoxels = 0;
+    };
+
+    bool fail()
+    {
+        m_stage = StageFailed;
+        return false;
+    }
+
+    std::ostream& out() const { return m_options.progress ? *m_options.progress : std::cout; }
+
+    void stepParse()
+    {
+        if (!m_parser.done())
+        {
+            if (!m_parser.parse(64, m_error)) { fail(); return; }
+            if (!m_parser.done()) return;
+            if (!selectModels()) { fail(); return; }
+            materials::mapPalette(m_parser.palette, m_parser.materials, m_specs);
+            return;
+        }
+        if (m_palette < 256)
+        {
+            int end = std::min(256, m_palette + 32);
+            m_materialNodes += createPaletteMaterials(m_scene, m_specs, m_materials, m_options.record, m_palette, end);
+            m_palette = end;
+            if (m_palette < 256) return;
+        }
+        if (m_options.proxyCells && m_options.emit != EmitWorld) buildProxy();
+        if (m_options.parallelFor && m_totalVoxels >= m_options.parallelMinVoxels &&
+            (m_work.size() > 1 || m_totalVoxels > pieceVoxels)) { prepareModels(); return; }
+        m_stage = StageDecode;
+    }
+
+    // Occupied blocks of one model for the proxy, first color seen per block (0 = empty)
+    struct ProxyGrid
+    {
+        uint32_t dims[3] = { 0, 0, 0 };
+        std::vector<uint8_t> colors;
+    };
+
+    // Emits the proxy boxes, frames the camera on the selected voxels, then calls onProxyReady
+    void buildProxy()
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const Crop& crop = m_options.crop;
+        // Voxels mostly form surfaces, which cover about N / k^2 blocks. A sparse model
+        // still needs its whole block grid, which is kept to 2M blocks.
+        uint64_t volume = 0;
+        for (const ModelWork& w : m_work) {
+            const vox::ModelRef& model = m_parser.models[w.model];
+            volume = std::max<uint64_t>(volume, uint64_t(model.sizeX) * model.sizeY * model.sizeZ);
+        }
+        uint32_t k = 1;
+        while (k < 256 && (double(m_totalVoxels) / (double(k) * k) > 4.0 * m_options.proxyCells || volume / (uint64_t(k) * k * k) > (1u << 21))) k *= 2;
+
+        std::vector<ProxyGrid> grids(m_work.size());
+        Extents extents;
+        size_t cells = 0;
+        for (size_t i = 0; i < m_work.size(); ++i)
+        {
+            const vox::ModelRef& model = m_parser.models[m_work[i].model];
+            ProxyGrid& g = grids[i];
+            g.dims[0] = (model.sizeX + k - 1) / k;
+            g.dims[1] = (model.sizeY + k - 1) / k;
+            g.dims[2] = (model.sizeZ + k - 1) / k;
+            g.colors.assign(size_t(g.dims[0]) * g.dims[1] * g.dims[2], 0);
+            for (uint32_t v = 0; v < model.numVoxels; ++v)
+            {
+                const uint8_t* r = m_work[i].records + size_t(v) * 4;
+                // Out of bounds voxels fail the decode stage later, the proxy just skips them
+                if (r[0] >= model.sizeX || r[1] >= model.sizeY || r[2] >= model.sizeZ) continue;
+                if (crop.enabled && (r[0] < crop.min[0] || r[0] > crop.max[0] || r[1] < crop.min[1] || r[1] > crop.max[1] ||
+                                     r[2] < crop.min[2] || r[2] > crop.max[2]))
+                    continue;
+                extents.add(r[0], r[1], r[2]);
+                uint8_t& c = g.colors[(size_t(r[2] / k) * g.dims[1] + r[1] / k) * g.dims[0] + r[0] / k];
+                if (!c) { c = r[3] ? r[3] : 1; ++cells; }
+            }
+        }
+        // Coarser blocks until the budget is met, from the grids rather than the voxels
+        while (cells > m_options.proxyCells && k < 256)
+        {
+            k *= 2;
+            cells = 0;
+            for (ProxyGrid& g : grids)
+            {
+                ProxyGrid half;
+                for (int a = 0; a < 3; ++a) half.dims[a] = (g.dims[a] + 1) / 2;
+                half.colors.assign(size_t(half.dims[0]) * half.dims[1] * half.dims[2], 0);
+                for (uint32_t z = 0; z < g.dims[2]; ++z)
+                    for (uint32_t y = 0; y < g.dims[1]; ++y)
+                        for (uint32_t x = 0; x < g.dims[0]; ++x)
+                        {
+                            uint8_t from = g.colors[(size_t(z) * g.dims[1] + y) * g.dims[0] + x];
+                            uint8_t& c = half.colors[(size_t(z / 2) * half.dims[1] + y / 2) * half.dims[0] + x / 2];
+                            if (from && !c) { c = from; ++cells; }
+                        }
+                g = std::move(half);
+            }
+        }
+
+        {
+            dl::bella_sdk::Scene::EventScope es(m_scene);
+            record::RecordingScene scene(m_scene, m_options.record);
+            auto box = scene.create("box", "voxProxyBox");
+            for (const char* size : { "sizeX", "sizeY", "sizeZ" }) scene.setReal(box, size, double(k));
+            uint32_t n = 0;
+            for (size_t i = 0; i < grids.size(); ++i)
+            {
+                const ProxyGrid& g = grids[i];
+                dl::String groupName = dl::String("voxProxy") + dl::String(static_cast<int>(i));
+                auto group = scene.create("xform", groupName);
+                scene.parent(group, scene.root(record::RootWorld));
+                m_proxies.emplace_back();
+                m_proxies.back().push_back(group);
+                for (uint32_t z = 0; z < g.dims[2]; ++z)
+                    for (uint32_t y = 0; y < g.dims[1]; ++y)
+                        for (uint32_t x = 0; x < g.dims[0]; ++x)
+                        {
+                            uint8_t c = g.colors[(size_t(z) * g.dims[1] + y) * g.dims[0] + x];
+                            if (!c) continue;
+                            // A block covers voxels x*k .. x*k+k-1, which are centred on their coordinates
+                            dl::String name = groupName + dl::String("_") + dl::String(static_cast<int>(n++));
+                            auto xform = scene.create("xform", name);
+                            scene.parent(xform, group);
+                            scene.parent(box, xform);
+                            m_proxies.back().push_back(xform);
+                            const double h = (k - 1) / 2.0;
+                            scene.setMat4(xform, "steps/0/xform", dl::Mat4 { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,
+                                                                             x * double(k) + h, y * double(k) + h, z * double(k) + h, 1 });
+                            scene.setNode(xform, "material", scene.existing(m_materials[c]));
+                        }
+            }
+            m_proxyBox = box;
+            m_proxiesLeft = grids.size();
+        }
+        frameCamera(m_scene, extents, m_options.record, out());
+        m_proxyFramed = true;
+        if (m_options.preset) applyRenderPreset(m_scene, *m_options.preset, nullptr, m_options.record);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        out() << "Proxy: " << cells << " boxes of " << k << "x" << k << "x" << k << " voxels in " << ms << " ms" << std::endl;
+        if (m_options.onProxyReady) m_options.onProxyReady();
+    }
+
+    // Deletes a model's proxy nodes once its geometry is in, and the shared box with
+    // the last one
+    void retireProxy(size_t index)
+    {
+        if (index >= m_proxies.size() || m_proxies[index].empty()) return;
+        dl::bella_sdk::Scene::EventScope es(m_scene);
+        record::RecordingScene scene(m_scene, m_options.record);
+        for (const record::RecordedNode& node : m_proxies[index]) scene.remove(node);
+        std::vector<record::RecordedNode>().swap(m_proxies[index]);
+        if (--m_proxiesLeft == 0) scene.remove(m_proxyBox);
+    }
+
+    // Builds the list of models to convert from the model options
+    bool selectModels()
+    {
+        std::vector<uint32_t> selected;
+        const size_t numModels = m_parser.models.size();
+        if (!m_options.modelName.empty())
+        {
+            if (!m_parser.modelsNamed(m_options.modelName, selected)) {
+                m_error = "no object named '" + m_options.modelName + "' in the scene graph";
+                return false;
+            }
+        }
+        else if (m_options.model >= 0)
+        {
+            if (size_t(m_options.model) >= numModels) {
+                m_error = "model " + std::to_string(m_options.model) + " does not exist, the file has " + std::to_string(numModels) + " models";
+                return false;
+            }
+            selected.push_back(uint32_t(m_options.model));
+        }
+        else
+        {
+            for (size_t i = 0; i < numModels; ++i) selected.push_back(uint32_t(i));
+        }
+
+        for (uint32_t index : selected)
+        {
+            const vox::ModelRef& model = m_parser.models[index];
+            ModelWork w;
+            w.model = index;
+            w.records = m_data + model.xyziOffset;
+            w.numVoxels = model.numVoxels;
+            m_work.push_back(w);
+            m_totalVoxels += model.numVoxels;
+        }
+        if (m_options.crop.enabled) m_cropped.resize(m_work.size());
+        return true;
+    }
+
+    // Checks coordinates against the model size, applies the crop and grows the extents
+    void stepDecode()
+    {
+        if (m_model >= m_work.size()) { nextStage(StageAnalyse); return; }
+        ModelWork& w = m_work[m_model];
+        const vox::ModelRef& model = m_parser.models[w.model];
+        if (m_voxel == 0) {
+            printModel(model);
+            if (m_options.crop.enabled) {
+                m_cropped[m_model].resize(size_t(model.numVoxels) * 4);
+                m_croppedCount = 0;
+            }
+        }
+
+        uint32_t end = std::min<uint32_t>(model.numVoxels, m_voxel + 4096);
+        if (!decodeRange(m_model, m_voxel, end, m_croppedCount, m_extents, m_usedColors)) { outsideModel(w.model); return; }
+        m_decoded += end - m_voxel;
+        if (!advance(end, model.numVoxels)) return;
+
+        // Model finished, later stages only see the voxels that were kept
+        keepDecoded(m_model - 1, m_croppedCount);
+        if (m_options.crop.enabled) out() << "Kept " << w.numVoxels << " voxels inside the crop box" << std::endl;
+        m_keptVoxels += w.numVoxels;
+    }
+
+    void printModel(const vox::ModelRef& model) const
+    {
+        out() << "Size: " << model.sizeX << "x" << model.sizeY << "x" << model.sizeZ << std::endl;
+        out() << "Number of Voxels: " << model.numVoxels << std::endl;
+    }
+
+    // Decodes records [begin, end) of m_work[index], cropped ones go to m_cropped[index]
+    // Only that model's entries from croppedCount on are written, so different models,
+    // or ranges of one model started at croppedCount = begin, can decode in parallel
+    bool decodeRange(size_t index, uint32_t begin, uint32_t end, uint32_t& croppedCount, Extents& extents, uint8_t (&used)[256])
+    {
+        const vox::ModelRef& model = m_parser.models[m_work[index].model];
+        const uint8_t* records = m_data + model.xyziOffset;
+        if (m_options.crop.enabled)
+        {
+            uint32_t outOfBounds = 0;
+            uint8_t* out = m_cropped[index].data() + size_t(croppedCount) * 4;
+            uint32_t kept = cropRecords(records + size_t(begin) * 4, end - begin, m_options.crop,
+                                        model.sizeX, model.sizeY, model.sizeZ, out, outOfBounds);
+            if (outOfBounds) return false;
+            for (uint32_t i = 0; i < kept; ++i) {
+                extents.add(out[i * 4], out[i * 4 + 1], out[i * 4 + 2]);
+                used[out[i * 4 + 3]] = 1;
+            }
+            croppedCount += kept;
+            return true;
+        }
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const uint8_t* v = records + size_t(i) * 4;
+            if (v[0] >= model.sizeX || v[1] >= model.sizeY || v[2] >= model.sizeZ) return false;
+            extents.add(v[0], v[1], v[2]);
+            used[v[3]] = 1;
+        }
+        return true;
+    }
+
+    // Points a fully decoded model at its cropped copy
+    void keepDecoded(size_t index, uint32_t croppedCount)
+    {
+        if (!m_options.crop.enabled) return;
+        m_cropped[index].resize(size_t(croppedCount) * 4);
+        m_work[index].records = m_cropped[index].data();
+        m_work[index].numVoxels = croppedCount;
+    }
+
+    // Looks for enclosed interiors one model at a time, then sums up the materials
+    // Each model's grid is built and flooded over several slices
+    void stepAnalyse()
+    {
+        if (!m_options.autoRender) { nextStage(StageMesh); return; }
+        if (m_model < m_work.size())
+        {
+            if (!buildGrid(m_work[m_model])) return;
+            if (!m_flooding) {
+                m_enclosed.begin(m_grid);
+                m_flooding = true;
+            }
+            if (!m_enclosed.step(65536)) return;
+            m_content.emptyCells += m_grid.volume() - m_enclosed.occupied();
+            m_content.enclosedCells += m_enclosed.enclosed();
+            m_flooding = false;
+            releaseGrid();
+            ++m_model;
+            return;
+        }
+        summariseContent();
+        nextStage(StageMesh);
+    }
+
+    // Fills 'grid' with the model's occupancy and counts its empty and enclosed cells
+    // in one go, for prepareModels()
+    void analyseModel(const ModelWork& w, vox::VoxelGrid& grid, ContentSummary& content) const
+    {
+        const vox::ModelRef& model = m_parser.models[w.model];
+        vox::fillGrid(w.records, w.numVoxels, model.sizeX, model.sizeY, model.sizeZ, grid);
+        vox::EnclosedCounter<vox::VoxelGrid> counter;
+        counter.begin(grid);
+        while (!counter.step()) {}
+        // Duplicate records share a cell, so the empty cells come from the grid
+        content.emptyCells += grid.volume() - counter.occupied();
+        content.enclosedCells += counter.enclosed();
+    }
+
+    // Materials and size of everything decoded, once all models are analysed
+    void summariseContent()
+    {
+        // What the used colors were mapped to, a glass without transparency is diffuse
+        for (int c = 0; c < 256; ++c)
+        {
+            if (!m_usedColors[c]) continue;
+            const materials::MaterialSpec& spec = m_specs[c];
+            m_content.glass    |= spec.cls == materials::ClassDielectric || spec.transmission > 0.0f;
+            m_content.emitters |= spec.cls == materials::ClassEmitter;
+            m_content.metal    |= spec.cls == materials::ClassConductor || spec.metallic > 0.0f;
+        }
+        if (m_extents.any)
+            for (int a = 0; a < 3; ++a)
+                m_content.extent = std::max(m_content.extent, int(m_extents.max[a]) - int(m_extents.min[a]) + 1);
+    }
+
+    // Cost classes of the materials the kept voxels use
+    void reportMaterials() const
+    {
+        size_t used = 0, perClass[materials::NumClasses] = {};
+        for (int c = 0; c < 256; ++c)
+            if (m_usedColors[c]) { ++used; ++perClass[m_specs[c].cls]; }
+        out() << "Materials: " << m_materialNodes << " nodes for 256 palette entries, " << used << " colors used (";
+        for (int k = 0; k < materials::NumClasses; ++k)
+            out() << (k ? ", " : "") << perClass[k] << " " << materials::className(materials::MaterialClass(k));
+        out() << ")" << std::endl;
+    }
+
+    void outsideModel(uint32_t model)
+    {
+        m_error = "voxel outside its model bounds in model " + std::to_string(model);
+        fail();
+    }
+
+    // Builds m_grid for a model over several slices: a 256^3 grid is 16M cells, so they
+    // are cleared 16 z-layers at a time, then 4096 records are set per slice.
+    // Returns true once the grid is complete, releaseGrid() starts over.
+    bool buildGrid(const ModelWork& w)
+    {
+        const vox::ModelRef& model = m_parser.models[w.model];
+        switch (m_gridPhase)
+        {
+            case GridStart:
+                m_grid.reshape(model.sizeX, model.sizeY, model.sizeZ);
+                m_gridPhase = GridClear;
+                return false;
+            case GridClear:
+                // 4 layers of tiles are 16 z-layers
+                if (m_grid.allocate(4)) m_gridPhase = GridFill;
+                return false;
+            case GridFill:
+            {
+                uint32_t end = std::min<uint32_t>(w.numVoxels, m_voxel + 4096);
+                vox::setRecords(w.records, m_voxel, end, m_grid);
+                m_voxel = end;
+                if (m_voxel < w.numVoxels) return false;
+                m_voxel = 0;
+                m_gridPhase = GridReady;
+                return false;
+            }
+            default:
+                return true;
+        }
+    }
+
+    void releaseGrid()
+    {
+        m_grid.clear();
+        m_gridPhase = GridStart;
+    }
+
+    // Builds face-culled quads: a face is kept only if the neighbouring cell is empty
+    void stepMesh()
+    {
+        if (m_options.emit == EmitWorld) { buildWorld(); return; }
+        if (m_options.emit != EmitMesh || m_model >= m_work.size()) { nextStage(StageEmit); return; }
+        const ModelWork& w = m_work[m_model];
+
+        if (m_gridPhase == GridStart) m_meshes.emplace_back();
+        if (!buildGrid(w)) return;
+        uint32_t end = std::min<uint32_t>(w.numVoxels, m_voxel + 1024);
+        mesh::addExposedFaces(m_grid, w.records, m_voxel, end, m_meshes.back());
+        m_meshed += end - m_voxel;
+        if (advance(end, w.numVoxels)) releaseGrid(); // model finished
+    }
+
+    // EmitWorld: rasterises every visible placement of the selected models into one
+    // world grid, then meshes it. Both halves use parallelFor when there is one: one
+    // task per placement, then one per run of bricks, merged in brick order so the
+    // output doesn't depend on the threads.
+    void buildWorld()
+    {
+        std::vector<vox::Placement> placements;
+        vox::scenePlacements(m_parser, placements);
+        std::vector<world::ModelVoxels> models(m_parser.models.size());
+        std::vector<bool> selected(m_parser.models.size(), false);
+        for (const ModelWork& w : m_work)
+        {
+            const vox::ModelRef& model = m_parser.models[w.model];
+            world::ModelVoxels& m = models[w.model];
+            m.records = w.records;
+            m.numVoxels = w.numVoxels;
+            m.size[0] = model.sizeX; m.size[1] = model.sizeY; m.size[2] = model.sizeZ;
+            selected[w.model] = true;
+        }
+
+        // The order of a placement is its position in the scene graph walk, later ones win
+        std::vector<uint32_t> jobs;
+        size_t maxBricks = 0;
+        for (size_t i = 0; i < placements.size(); ++i)
+        {
+            const vox::Placement& p = placements[i];
+            if (p.hidden || !selected[p.model]) continue;
+            jobs.push_back(uint32_t(i));
+            maxBricks += world::brickBound(p, models[p.model]);
+        }
+        world::BrickMap map(maxBricks);
+        std::vector<uint8_t> ok(jobs.size(), 1);
+        auto rasterise = [&](size_t j) {
+            const vox::Placement& p = placements[jobs[j]];
+            ok[j] = world::rasterise(map, p, jobs[j] + 1, models[p.model]);
+        };
+        runParallel(jobs.size(), rasterise);
+        if (std::find(ok.begin(), ok.end(), 0) != ok.end()) {
+            m_error = "world grid overflow";
+            fail();
+            return;
+        }
+
+        const std::vector<world::BrickRef> bricks = map.sortedBricks();
+        const size_t bricksPerTask = 64;
+        struct Part
+        {
+            mesh::ColorGroups groups;
+            Extents extents;
+        };
+        std::vector<Part> parts((bricks.size() + bricksPerTask - 1) / bricksPerTask);
+        runParallel(parts.size(), [&](size_t t) {
+            Part& part = parts[t];
+            const size_t end = std::min(bricks.size(), (t + 1) * bricksPerTask);
+            for (size_t b = t * bricksPerTask; b < end; ++b)
+                world::exposedFaces(map, bricks[b], [&](int32_t x, int32_t y, int32_t z, uint8_t c, int d) {
+                    part.extents.add(x, y, z);
+                    part.groups.addFace(x, y, z, d, c);
+                });
+        });
+
+        // One group per color for the whole scene, in order of first appearance
+        m_meshes.assign(1, mesh::ColorGroups());
+        m_extents = Extents();
+        for (Part& part : parts)
+        {
+            m_extents.merge(part.extents);
+            m_meshes[0].merge(part.groups);
+        }
+        out() << "World: " << jobs.size() << " placements, " << map.bricks() << " bricks" << std::endl;
+        if (m_options.autoRender) {
+            m_content.extent = 0;
+            summariseContent();
+        }
+        m_meshed = m_keptVoxels;
+        nextStage(StageEmit);
+    }
+
+    // fn(0) .. fn(count - 1) through the options' parallelFor, or in order without one
+    void runParallel(size_t count, const std::function<void(size_t)>& fn)
+    {
+        if (m_options.parallelFor) m_options.parallelFor(count, fn);
+        else for (size_t i = 0; i < count; ++i) fn(i);
+    }
+
+    // Decode, analyse and mesh through the parallelFor, then merge the results in model
+    // order so the output matches a sequential conversion. Models are cut into pieces of
+    // pieceVoxels records:
+    // - all pieces of all models decode side by side
+    // - models of one piece are then analysed and meshed one task each
+    // - each bigger model in turn has its grid filled once, then one task floods it for
+    //   enclosed cells while the others mesh its pieces
+    void prepareModels()
+    {
+        struct Piece
+        {
+            size_t model = 0;
+            uint32_t begin = 0, end = 0;
+            bool ok = true;
+            uint32_t kept = 0;
+            Extents extents;
+            uint8_t used[256] = {};
+        };
+        std::vector<Piece> pieces;
+        for (size_t i = 0; i < m_work.size(); ++i)
+        {
+            const uint32_t n = m_work[i].numVoxels;
+            if (m_options.crop.enabled) m_cropped[i].resize(size_t(n) * 4);
+            for (uint32_t b = 0; b == 0 || b < n; b += pieceVoxels)
+            {
+                Piece piece;
+                piece.model = i;
+                piece.begin = b;
+                piece.end = std::min<uint32_t>(n, b + pieceVoxels);
+                pieces.push_back(piece);
+            }
+        }
+
+        // Cropped records of a piece go to its own part of the model's buffer
+        m_options.parallelFor(pieces.size(), [&](size_t k) {
+            Piece& p = pieces[k];
+            uint32_t croppedCount = p.begin;
+            p.ok = decodeRange(p.model, p.begin, p.end, croppedCount, p.extents, p.used);
+            p.kept = croppedCount - p.begin;
+        });
+
+        // Close the gaps between the pieces' cropped records, model by model
+        size_t k = 0;
+        for (size_t i = 0; i < m_work.size(); ++i)
+        {
+            const ModelWork& w = m_work[i];
+            printModel(m_parser.models[w.model]);
+            uint32_t kept = 0;
+            for (; k < pieces.size() && pieces[k].model == i; ++k)
+            {
+                const Piece& p = pieces[k];
+                if (!p.ok) { outsideModel(w.model); return; }
+                if (m_options.crop.enabled)
+                    std::memmove(m_cropped[i].data() + size_t(kept) * 4, m_cropped[i].data() + size_t(p.begin) * 4, size_t(p.kept) * 4);
+                kept += p.kept;
+                m_extents.merge(p.extents);
+                for (int c = 0; c < 256; ++c) m_usedColors[c] |= p.used[c];
+            }
+            keepDecoded(i, kept);
+            if (m_options.crop.enabled) out() << "Kept " << w.numVoxels << " voxels inside the crop box" << std::endl;
+            m_decoded += m_parser.models[w.model].numVoxels;
+            m_keptVoxels += w.numVoxels;
+        }
+
+        const bool analyse = m_options.autoRender, meshes = m_options.emit == EmitMesh;
+        if (meshes) m_meshes.resize(m_work.size());
+        std::vector<ContentSummary> content(m_work.size());
+        std::vector<size_t> small, big;
+        for (size_t i = 0; i < m_work.size(); ++i) (m_work[i].numVoxels > pieceVoxels ? big : small).push_back(i);
+
+        if (analyse || meshes)
+        {
+            m_options.parallelFor(small.size(), [&](size_t j) {
+                const size_t i = small[j];
+                const ModelWork& w = m_work[i];
+                const vox::ModelRef& model = m_parser.models[w.model];
+                vox::VoxelGrid grid;
+                if (analyse) analyseModel(w, grid, content[i]);
+                else vox::fillGrid(w.records, w.numVoxels, model.sizeX, model.sizeY, model.sizeZ, grid);
+                if (meshes) mesh::addExposedFaces(grid, w.records, 0, w.numVoxels, m_meshes[i]);
+            });
+
+            for (size_t i : big)
+            {
+                const ModelWork& w = m_work[i];
+                const vox::ModelRef& model = m_parser.models[w.model];
+                vox::VoxelGrid grid;
+                vox::fillGrid(w.records, w.numVoxels, model.sizeX, model.sizeY, model.sizeZ, grid);
+                const size_t parts = meshes ? (w.numVoxels + pieceVoxels - 1) / pieceVoxels : 0;
+                std::vector<mesh::ColorGroups> groups(parts);
+                m_options.parallelFor(parts + 1, [&](size_t t) {
+                    if (t == 0) {
+                        if (!analyse) return;
+                        vox::EnclosedCounter<vox::VoxelGrid> counter;
+                        counter.begin(grid);
+                        while (!counter.step()) {}
+                        content[i].emptyCells = grid.volume() - counter.occupied();
+                        content[i].enclosedCells = counter.enclosed();
+                        return;
+                    }
+                    const uint32_t begin = uint32_t(t - 1) * pieceVoxels;
+                    mesh::addExposedFaces(grid, w.records, begin, std::min<uint32_t>(w.numVoxels, begin + pieceVoxels), groups[t - 1]);
+                });
+                for (mesh::ColorGroups& part : groups) m_meshes[i].merge(part);
+            }
+        }
+
+        for (const ContentSummary& c : content)
+        {
+            m_content.emptyCells += c.emptyCells;
+            m_content.enclosedCells += c.enclosedCells;
+        }
+        if (meshes) m_meshed = m_keptVoxels;
+        if (analyse) summariseContent();
+        nextStage(m_options.emit == EmitWorld ? StageMesh : StageEmit);
+    }
+
+    void stepEmit()
+    {
+        if (m_model >= m_work.size()) { m_stage = StageDone; return; }
+        const ModelWork& w = m_work[m_model];
+
+        if (m_options.emit == EmitInstanced)
+        {
+            const uint8_t* records = w.records;
+            uint32_t end = std::min<uint32_t>(w.numVoxels, m_voxel + 32);
+            for (uint32_t i = m_voxel; i < end; ++i)
+            {
+                const uint8_t* v = records + i * 4;
+                emitVoxelInstance(m_scene, m_box, m_materials[v[3]], uint32_t(m_emitted++), v[0], v[1], v[2], m_options.record);
+            }
+            if (advance(end, w.numVoxels)) {
+                retireProxy(m_model - 1);
+                if (m_options.onModelDone) m_options.onModelDone();
+            }
+            return;
+        }
+
+        if (m_options.emit == EmitWorld)
+        {
+            // One mesh per color group per slice, for the whole scene
+            mesh::ColorGroups& groups = m_meshes[0];
+            if (m_group < groups.size())
+            {
+                emitMesh(dl::String("voxWorld_") + dl::String(static_cast<int>(groups[m_group].colorIndex)), groups[m_group]);
+                std::vector<float>().swap(groups[m_group].points);
+                ++m_group;
+                if (m_options.onModelDone) m_options.onModelDone();
+                return;
+            }
+            m_emitted = m_keptVoxels;
+            m_stage = StageDone;
+            return;
+        }
+
+        // One mesh per color group per slice
+        mesh::ColorGroups& groups = m_meshes[m_model];
+        if (m_group < groups.size())
+        {
+            emitMesh(dl::String("voxMesh") + dl::String(static_cast<int>(m_work[m_model].model)) + dl::String("_") + dl::String(static_cast<int>(groups[m_group].colorIndex)),
+                     groups[m_group]);
+            std::vector<float>().swap(groups[m_group].points); // release as we go
+            ++m_group;
+        }
+        if (m_group >= groups.size())
+        {
+            m_emitted += w.numVoxels;
+            m_group = 0;
+            retireProxy(m_model++);
+            if (m_options.onModelDone) m_options.onModelDone();
+        }
+    }
+
+    void emitMesh(const dl::String& name, const mesh::Group& group)
+    {
+        record::RecordingScene scene(m_scene, m_options.record);
+        auto xform = scene.create("xform", name + dl::String("Xform"));
+        scene.parent(xform, scene.root(record::RootWorld));
+        scene.setNode(xform, "material", scene.existing(m_materials[group.colorIndex]));
+
+        // Every quad has its own 4 corners
+        size_t numQuads = group.points.size() / 12;
+        std::vector<uint32_t> indices(numQuads * 4);
+        for (size_t i = 0; i < indices.size(); ++i) indices[i] = uint32_t(i);
+        auto mesh = scene.create("mesh", name);
+        scene.setPolygons(mesh, "polygons", indices.data(), numQuads);
+        scene.setPoints(mesh, "steps/0/points", group.points.data(), numQuads * 4);
+        scene.parent(mesh, xform);
+    }
+
+    // Moves to the next slice of the current model, or the next model when done
+    // Returns true when a model was just finished
+    bool advance(uint32_t end, uint32_t numVoxels)
+    {
+        m_voxel = end;
+        if (m_voxel < numVoxels) return false;
+        m_voxel = 0;
+        ++m_model;
+        return true;
+    }
+
+    void nextStage(Stage stage)
+    {
+        m_stage = stage;
+        m_model = m_voxel = m_group = 0;
+    }
+
+    dl::bella_sdk::Scene m_scene;
+    dl::bella_sdk::Node m_box;
+    dl::bella_sdk::Node m_materials[256];
+    Options m_options;
+    vox::ChunkParser m_parser;
+    std::vector<uint8_t> m_owned;   // file contents when begin() was given a path
+    const uint8_t* m_data = nullptr;
+    Stage m_stage = StageIdle;
+    std::string m_error;
+
+    std::vector<ModelWork> m_work;
+    std::vector<std::vector<uint8_t>> m_cropped;    // per m_work entry, only with a crop box
+    uint32_t m_croppedCount = 0;                    // records kept so far in the model being decoded
+
+    // Records per parallelFor task in prepareModels()
+    static constexpr uint32_t pieceVoxels = 65536;
+
+    // Where each stage is up to, m_model indexes m_work
+    size_t m_model = 0;
+    uint32_t m_voxel = 0;
+    size_t m_group = 0;
+    int m_palette = 0;                              // palette entries with materials so far
+    enum GridPhase { GridStart, GridClear, GridFill, GridReady } m_gridPhase = GridStart;  // see buildGrid()
+
+    size_t m_totalVoxels = 0, m_keptVoxels = 0, m_decoded = 0, m_meshed = 0, m_emitted = 0;
+    Extents m_extents;
+    ContentSummary m_content;
+    uint8_t m_usedColors[256];                      // color indices of the kept voxels
+    materials::MaterialSpec m_specs[256];           // per palette entry
+    // Per m_work entry with Options::proxyCells: the model's group, then its block xforms
+    std::vector<std::vector<record::RecordedNode>> m_proxies;
+    record::RecordedNode m_proxyBox;                // shared by all blocks
+    size_t m_proxiesLeft = 0;                       // models whose proxy is still in the scene
+    bool m_proxyFramed = false;                     // the camera was framed on the proxy
+    size_t m_materialNodes = 0;                     // distinct material nodes in m_materials
+    vox::VoxelGrid m_grid;                          // occupancy of the model being analysed or meshed
+    vox::EnclosedCounter<vox::VoxelGrid> m_enclosed; // flood fill of m_grid in the analyse stage
+    bool m_flooding = false;                        // m_enclosed has begun on m_grid
+    std::vector<mesh::ColorGroups> m_meshes;        // per model
+};
+
+} // namespace vox2bella
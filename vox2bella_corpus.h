@@ -0,0 +1,201 @@
+// vox2bella_corpus.h - Synthetic .vox files for benchmarks
+//
+// A reproducible corpus that exercises the converter like a real library does
+// without shipping one: mostly small props, a few large terrains (the first one 256
+// voxels across), closed rooms for the enclosed-interior analysis, multi-model files
+// and MATL metal, glass and emitters. The same count and seed give the same bytes on
+// every platform, random numbers come straight from std::mt19937 (its output is
+// specified, the standard distributions' isn't).
+//
+// Files have a SIZE/XYZI pair per model, an RGBA palette and MATL chunks, no scene
+// graph. Nothing in here depends on the Bella SDK.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace vox2bella { namespace corpus {
+
+struct SyntheticFile
+{
+    std::string name;
+    std::vector<uint8_t> data;
+    uint64_t voxels = 0;
+};
+
+// One model of a file, XYZI records
+struct Model
+{
+    uint32_t size[3] = { 0, 0, 0 };
+    std::vector<uint8_t> records;
+
+    void add(uint32_t x, uint32_t y, uint32_t z, uint8_t color)
+    {
+        records.insert(records.end(), { uint8_t(x), uint8_t(y), uint8_t(z), color });
+    }
+};
+
+inline void putU32(std::vector<uint8_t>& out, uint32_t v) { for (int i = 0; i < 4; ++i) out.push_back(uint8_t(v >> (8 * i))); }
+
+inline void putChunk(std::vector<uint8_t>& out, const char* id, const std::vector<uint8_t>& content)
+{
+    out.insert(out.end(), id, id + 4);
+    putU32(out, uint32_t(content.size()));
+    putU32(out, 0);
+    out.insert(out.end(), content.begin(), content.end());
+}
+
+// MATL chunk for palette index 'id' with DICT pairs
+inline std::vector<uint8_t> matl(uint32_t id, const std::vector<std::pair<std::string, std::string>>& dict)
+{
+    std::vector<uint8_t> content;
+    putU32(content, id);
+    putU32(content, uint32_t(dict.size()));
+    for (const auto& kv : dict)
+        for (const std::string* s : { &kv.first, &kv.second }) {
+            putU32(content, uint32_t(s->size()));
+            content.insert(content.end(), s->begin(), s->end());
+        }
+    return content;
+}
+
+// Serialises models, palette and MATL chunks as a version 150 .vox file
+inline std::vector<uint8_t> writeVox(const std::vector<Model>& models, const uint32_t (&palette)[256],
+                                     const std::vector<std::vector<uint8_t>>& materials)
+{
+    std::vector<uint8_t> children;
+    for (const Model& m : models)
+    {
+        std::vector<uint8_t> size, xyzi;
+        for (uint32_t s : m.size) putU32(size, s);
+        putU32(xyzi, uint32_t(m.records.size() / 4));
+        xyzi.insert(xyzi.end(), m.records.begin(), m.records.end());
+        putChunk(children, "SIZE", size);
+        putChunk(children, "XYZI", xyzi);
+    }
+    std::vector<uint8_t> rgba;
+    for (uint32_t c : palette) putU32(rgba, c);
+    putChunk(children, "RGBA", rgba);
+    for (const std::vector<uint8_t>& content : materials) putChunk(children, "MATL", content);
+
+    std::vector<uint8_t> out = { 'V', 'O', 'X', ' ' };
+    putU32(out, 150);
+    out.insert(out.end(), { 'M', 'A', 'I', 'N' });
+    putU32(out, 0);
+    putU32(out, uint32_t(children.size()));
+    out.insert(out.end(), children.begin(), children.end());
+    return out;
+}
+
+// 'count' files, every fourth kind in turn: prop, room, terrain, multi-model
+inline std::vector<SyntheticFile> generate(unsigned count, uint32_t seed = 1)
+{
+    std::mt19937 rng(seed);
+    auto below = [&](uint32_t n) { return uint32_t(rng() % n); };
+    std::vector<SyntheticFile> files;
+    for (unsigned f = 0; f < count; ++f)
+    {
+        uint32_t palette[256];
+        for (uint32_t& c : palette) c = rng() | 0xff000000u;
+        std::vector<Model> models;
+        const uint8_t base = uint8_t(1 + below(200));
+        switch (f % 4)
+        {
+            case 0:
+            {
+                // Prop: a few overlapping boxes, 8..32 voxels across
+                Model m;
+                const uint32_t s = 8 + below(25);
+                m.size[0] = m.size[1] = m.size[2] = s;
+                std::vector<uint8_t> cells(size_t(s) * s * s, 0);
+                for (int b = 0; b < 6; ++b)
+                {
+                    uint32_t lo[3], hi[3];
+                    for (int a = 0; a < 3; ++a) { lo[a] = below(s); hi[a] = std::min(s, lo[a] + 1 + below(s / 2 + 1)); }
+                    for (uint32_t z = lo[2]; z < hi[2]; ++z)
+                        for (uint32_t y = lo[1]; y < hi[1]; ++y)
+                            for (uint32_t x = lo[0]; x < hi[0]; ++x) cells[(size_t(z) * s + y) * s + x] = uint8_t(base + b);
+                }
+                for (uint32_t i = 0; i < cells.size(); ++i)
+                    if (cells[i]) m.add(i % s, i / s % s, i / (s * s), cells[i]);
+                models.push_back(m);
+                break;
+            }
+            case 1:
+            {
+                // Room: hollow box with a lamp inside, so the interior counts as enclosed
+                Model m;
+                const uint32_t s = 12 + below(29);
+                m.size[0] = m.size[1] = m.size[2] = s;
+                for (uint32_t z = 0; z < s; ++z)
+                    for (uint32_t y = 0; y < s; ++y)
+                        for (uint32_t x = 0; x < s; ++x)
+                            if (x == 0 || y == 0 || z == 0 || x == s - 1 || y == s - 1 || z == s - 1) m.add(x, y, z, base);
+                m.add(s / 2, s / 2, s - 2, uint8_t(base + 1));
+                models.push_back(m);
+                break;
+            }
+            case 2:
+            {
+                // Terrain: filled columns from a smoothed random height field, 48..127 across.
+                // The first one spans the whole 256x256 a model can have, at a quarter of
+                // the usual relative height so it stays around a million voxels.
+                Model m;
+                const uint32_t s = f == 2 ? 256 : 48 + below(80), h = f == 2 ? s / 8 : s / 2;
+                m.size[0] = m.size[1] = s;
+                m.size[2] = h;
+                std::vector<uint32_t> height(size_t(s) * s);
+                const uint32_t px = 1 + below(8), py = 1 + below(8);
+                for (uint32_t y = 0; y < s; ++y)
+                    for (uint32_t x = 0; x < s; ++x)
+                        height[size_t(y) * s + x] = 1 + (h - 1) * ((x * px + y * py) % s + below(s / 4 + 1)) / (s + s / 4);
+                for (uint32_t y = 0; y < s; ++y)
+                    for (uint32_t x = 0; x < s; ++x)
+                        for (uint32_t z = 0; z < height[size_t(y) * s + x]; ++z) m.add(x, y, z, uint8_t(base + z * 4 / h));
+                models.push_back(m);
+                break;
+            }
+            default:
+            {
+                // Several small models sharing one palette
+                const uint32_t n = 2 + below(4);
+                for (uint32_t k = 0; k < n; ++k)
+                {
+                    Model m;
+                    const uint32_t s = 4 + below(13);
+                    m.size[0] = m.size[1] = m.size[2] = s;
+                    for (uint32_t z = 0; z < s; ++z)
+                        for (uint32_t y = 0; y < s; ++y)
+                            for (uint32_t x = 0; x < s; ++x)
+                                if (below(3) == 0) m.add(x, y, z, uint8_t(base + k));
+                    if (m.records.empty()) m.add(0, 0, 0, base);
+                    models.push_back(m);
+                }
+                break;
+            }
+        }
+
+        // Every other file sets materials on the colors it uses
+        std::vector<std::vector<uint8_t>> materials;
+        if (f % 2 == 1)
+        {
+            materials.push_back(matl(base, { { "_type", "_metal" }, { "_metal", "1" }, { "_rough", "0.2" } }));
+            materials.push_back(matl(uint32_t(base) + 1, { { "_type", "_emit" }, { "_emit", "0.8" }, { "_flux", "1" } }));
+            materials.push_back(matl(uint32_t(base) + 2, { { "_type", "_glass" }, { "_trans", "0.5" }, { "_ior", "0.5" } }));
+        }
+
+        SyntheticFile file;
+        file.name = "synthetic_" + std::to_string(f) + ".vox";
+        for (const Model& m : models) file.voxels += m.records.size() / 4;
+        file.data = writeVox(models, palette, materials);
+        files.push_back(std::move(file));
+    }
+    return files;
+}
+
+}} // namespace vox2bella::corpus
@@ -0,0 +1,259 @@
+// vox2bella_impostor.h - Billboard impostor atlases from a grid of views around a model
+//
+// An impostor replaces a distant prop with a quad showing the view of it closest to
+// the viewer's direction. All views of one asset are rendered in one engine session
+// and packed into one atlas:
+//
+// - Views lie on a sphere around the centre of the voxels, on a grid of azimuths
+//   (columns, 0 = looking from +X towards the centre, counter-clockwise seen from +Z)
+//   and elevations (rows, lowest first). Every view sits at the same distance, far
+//   enough for the whole bounding sphere to fit the image, so a voxel has the same
+//   size in every tile.
+// - The color tiles come from the engine. Their alpha is the voxel coverage from a
+//   ray cast through the voxel grid (see vox2bella_orbit.h), so the ground and sky
+//   of the scene drop out.
+// - Depth and normal tiles need no render passes, the same ray cast gives them.
+//   Depth is the distance along the view direction, 1..255 over the bounding sphere
+//   from its near to its far side (0 = no voxel). Normals are the world-space face
+//   normal of the voxel hit, stored as n * 0.5 + 0.5.
+// - layoutJson() describes the atlas: tile size, grid, per-view angles, tile position
+//   and camera matrix, and the depth range.
+//
+// Camera matrices are row-major with the translation in the last row, like the
+// matrices vox2bella writes. Nothing in here depends on the Bella SDK.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "vox2bella_orbit.h"
+
+namespace vox2bella { namespace impostor {
+
+const double pi = 3.14159265358979323846;
+
+// Azimuth x elevation grid of views
+struct ViewGrid
+{
+    int azimuths = 8;
+    int elevations = 3;
+    double minElevation = 0.0;      // degrees
+    double maxElevation = 60.0;
+
+    double azimuth(int column) const { return 360.0 * column / azimuths; }
+    double elevation(int row) const
+    {
+        return elevations > 1 ? minElevation + (maxElevation - minElevation) * row / (elevations - 1) : minElevation;
+    }
+};
+
+// Parses "<azimuths>x<elevations>", each 1..64
+inline bool parseGrid(const std::string& text, ViewGrid& grid)
+{
+    int a = 0, e = 0, used = 0;
+    if (std::sscanf(text.c_str(), "%dx%d%n", &a, &e, &used) != 2 || size_t(used) != text.size())
+        return false;
+    if (a < 1 || a > 64 || e < 1 || e > 64) return false;
+    grid.azimuths = a;
+    grid.elevations = e;
+    return true;
+}
+
+// Parses "<lowest>,<highest>" elevation in degrees, -90..90
+inline bool parseElevations(const std::string& text, ViewGrid& grid)
+{
+    double lo = 0, hi = 0;
+    int used = 0;
+    if (std::sscanf(text.c_str(), "%lf,%lf%n", &lo, &hi, &used) != 2 || size_t(used) != text.size())
+        return false;
+    if (lo < -90 || hi > 90 || lo > hi) return false;
+    grid.minElevation = lo;
+    grid.maxElevation = hi;
+    return true;
+}
+
+// Parses a comma-separated list of extra atlases, "depth" and/or "normal", an empty
+// list bakes neither
+inline bool parseChannels(const std::string& text, bool& depth, bool& normal)
+{
+    depth = normal = false;
+    for (size_t from = 0; from < text.size();)
+    {
+        size_t to = text.find(',', from);
+        if (to == std::string::npos) to = text.size();
+        const std::string name = text.substr(from, to - from);
+        if (name == "depth") depth = true;
+        else if (name == "normal") normal = true;
+        else return false;
+        from = to + 1;
+        if (to + 1 == text.size()) return false; // trailing comma
+    }
+    return true;
+}
+
+// Camera matrix looking at 'target' from 'distance' away, at the given angles in degrees.
+// Rows are image right, image down, view direction and eye, Z is up.
+inline void viewMatrix(const double (&target)[3], double distance, double azimuth, double elevation, double (&m)[16])
+{
+    const double az = azimuth * pi / 180.0, el = elevation * pi / 180.0;
+    const double toEye[3] = { std::cos(el) * std::cos(az), std::cos(el) * std::sin(az), std::sin(el) };
+    const double f[3] = { -toEye[0], -toEye[1], -toEye[2] };
+    // Straight up or down, the image's up turns to the azimuth instead of Z
+    double up[3] = { 0, 0, 1 };
+    if (std::fabs(toEye[2]) > 0.9999) { up[0] = -std::cos(az) * toEye[2]; up[1] = -std::sin(az) * toEye[2]; up[2] = 0; }
+    double r[3] = { f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0] };
+    const double len = std::sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+    for (double& v : r) v /= len;
+    const double d[3] = { f[1] * r[2] - f[2] * r[1], f[2] * r[0] - f[0] * r[2], f[0] * r[1] - f[1] * r[0] };
+    for (int a = 0; a < 3; ++a)
+    {
+        m[a] = r[a];
+        m[4 + a] = d[a];
+        m[8 + a] = f[a];
+        m[12 + a] = target[a] + toEye[a] * distance;
+    }
+    m[3] = m[7] = m[11] = 0.0;
+    m[15] = 1.0;
+}
+
+// Distance at which a sphere of 'radius' fills the narrower side of the image
+inline double fitDistance(double radius, double fovDegrees, uint32_t width, uint32_t height)
+{
+    double tanHalf = std::tan(fovDegrees * 0.5 * pi / 180.0);
+    if (width && height < width) tanHalf *= double(height) / double(width);
+    return radius / std::sin(std::atan(tanHalf));
+}
+
+// Coverage, depth and normal of one view from a ray cast through the voxels. 'rgba' is
+// the rendered tile, its alpha is replaced by the coverage. 'depth' and 'normal' are
+// filled if not null. 'nearDepth' and 'farDepth' bound the depth along the view direction.
+inline void traceTile(const orbit::VoxelWorld& world, const orbit::Camera& cam, double nearDepth, double farDepth,
+                      std::vector<uint8_t>& rgba, std::vector<uint8_t>* depth, std::vector<uint8_t>* normal)
+{
+    const size_t pixels = size_t(cam.width) * cam.height;
+    rgba.resize(pixels * 4, 0);
+    if (depth) depth->assign(pixels * 4, 0);
+    if (normal) normal->assign(pixels * 4, 0);
+    for (uint32_t py = 0; py < cam.height; ++py)
+        for (uint32_t px = 0; px < cam.width; ++px)
+        {
+            const size_t i = size_t(py) * cam.width + px;
+            double dir[3], hit[3];
+            uint32_t id;
+            cam.ray(px, py, dir);
+            if (!world.cast(cam.eye, dir, id, hit)) {
+                rgba[i * 4 + 3] = 0;
+                continue;
+            }
+            rgba[i * 4 + 3] = 255;
+            if (depth)
+            {
+                double z = 0.0;
+                for (int a = 0; a < 3; ++a) z += (hit[a] - cam.eye[a]) * cam.forward[a];
+                double t = (z - nearDepth) / (farDepth - nearDepth);
+                uint8_t v = uint8_t(1 + std::lround(std::min(1.0, std::max(0.0, t)) * 254.0));
+                uint8_t* out = &(*depth)[i * 4];
+                out[0] = out[1] = out[2] = v;
+                out[3] = 255;
+            }
+            if (normal)
+            {
+                // The ray enters the voxel through the face the hit point lies on, the
+                // axis on which it is furthest from the voxel's centre
+                const uint32_t cell = id - 1;
+                const double centre[3] = { double(cell & 255), double((cell >> 8) & 255), double(cell >> 16) };
+                int axis = 0;
+                for (int a = 1; a < 3; ++a)
+                    if (std::fabs(hit[a] - centre[a]) > std::fabs(hit[axis] - centre[axis])) axis = a;
+                uint8_t* out = &(*normal)[i * 4];
+                out[0] = out[1] = out[2] = 128;
+                out[axis] = hit[axis] > centre[axis] ? 255 : 0;
+                out[3] = 255;
+            }
+        }
+}
+
+// One atlas image, tiles are placed by grid column and row
+class Atlas
+{
+public:
+    Atlas(uint32_t tileWidth, uint32_t tileHeight, int columns, int rows)
+        : m_tileWidth(tileWidth), m_tileHeight(tileHeight), m_width(tileWidth * columns), m_height(tileHeight * rows),
+          m_rgba(size_t(m_width) * m_height * 4, 0) {}
+
+    void place(int column, int row, const std::vector<uint8_t>& tile)
+    {
+        for (uint32_t y = 0; y < m_tileHeight; ++y)
+        {
+            const uint8_t* from = &tile[size_t(y) * m_tileWidth * 4];
+            uint8_t* to = &m_rgba[((size_t(row) * m_tileHeight + y) * m_width + size_t(column) * m_tileWidth) * 4];
+            std::copy(from, from + size_t(m_tileWidth) * 4, to);
+        }
+    }
+
+    const uint8_t* data() const { return m_rgba.data(); }
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+
+private:
+    uint32_t m_tileWidth, m_tileHeight, m_width, m_height;
+    std::vector<uint8_t> m_rgba;
+};
+
+// Everything layoutJson() writes besides the per-view matrices
+struct Layout
+{
+    std::string color, depth, normal;   // atlas file names, depth and normal may be empty
+    uint32_t tileWidth = 0, tileHeight = 0;
+    ViewGrid grid;
+    double target[3] = { 0, 0, 0 };
+    double radius = 0.0, distance = 0.0, fov = 0.0;
+};
+
+// JSON description of the atlas, 'matrices' holds 16 values per view, row by row
+inline std::string layoutJson(const Layout& layout, const std::vector<double>& matrices)
+{
+    auto number = [](double v) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.9g", std::fabs(v) < 1e-12 ? 0.0 : v);
+        return std::string(text);
+    };
+    auto quoted = [](const std::string& s) {
+        std::string out = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    };
+    const ViewGrid& g = layout.grid;
+    std::string json = "{\n";
+    json += "  \"color\": " + quoted(layout.color) + ",\n";
+    if (!layout.depth.empty()) json += "  \"depth\": " + quoted(layout.depth) + ",\n";
+    if (!layout.normal.empty()) json += "  \"normal\": " + quoted(layout.normal) + ",\n";
+    json += "  \"tileWidth\": " + std::to_string(layout.tileWidth) + ", \"tileHeight\": " + std::to_string(layout.tileHeight) + ",\n";
+    json += "  \"columns\": " + std::to_string(g.azimuths) + ", \"rows\": " + std::to_string(g.elevations) + ",\n";
+    json += "  \"target\": [" + number(layout.target[0]) + ", " + number(layout.target[1]) + ", " + number(layout.target[2]) + "],\n";
+    json += "  \"radius\": " + number(layout.radius) + ", \"distance\": " + number(layout.distance) + ", \"fov\": " + number(layout.fov) + ",\n";
+    json += "  \"depthRange\": [" + number(layout.distance - layout.radius) + ", " + number(layout.distance + layout.radius) + "],\n";
+    json += "  \"views\": [\n";
+    for (int row = 0; row < g.elevations; ++row)
+        for (int column = 0; column < g.azimuths; ++column)
+        {
+            const size_t view = size_t(row) * g.azimuths + column;
+            json += "    { \"azimuth\": " + number(g.azimuth(column)) + ", \"elevation\": " + number(g.elevation(row));
+            json += ", \"x\": " + std::to_string(column * layout.tileWidth) + ", \"y\": " + std::to_string(row * layout.tileHeight);
+            json += ", \"matrix\": [";
+            for (int k = 0; k < 16; ++k) json += (k ? ", " : "") + number(view * 16 + k < matrices.size() ? matrices[view * 16 + k] : 0.0);
+            json += view + 1 < size_t(g.azimuths) * g.elevations ? "] },\n" : "] }\n";
+        }
+    json += "  ]\n}\n";
+    return json;
+}
+
+}} // namespace vox2bella::impostor
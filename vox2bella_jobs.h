@@ -0,0 +1,404 @@
+// vox2bella_jobs.h - Job queue with priority classes for the long-running service modes
+//
+// In daemon mode artists submit interactive conversions while large batch jobs are
+// running. The scheduler keeps one queue per priority class and hands out a fixed
+// number of worker slots:
+//
+// - Higher classes are always dispatched first.
+// - Every class has its own concurrency limit, so batch work can be capped below
+//   the total and leave room for interactive requests.
+// - A running job calls checkpoint() between models. If a higher class is waiting
+//   and no slot is free, the job gives its slot away and sleeps until the higher
+//   class has drained. Paused jobs resume before any new job of their class starts.
+// - Batch jobs carry an estimated cost and the biggest start first, so a few giant
+//   files don't end up running alone at the tail of an otherwise finished batch.
+// - A running job can split its work with parallelFor(). Its own thread works through
+//   the pieces, and free slots join in as helpers before any new job of the class
+//   starts, so one giant file spreads over the workers the small ones leave idle.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vox2bella { namespace jobs {
+
+// Lower value = more important
+enum Priority
+{
+    PriorityInteractive = 0,
+    PriorityBatch       = 1,
+    PriorityCount
+};
+
+inline const char* priorityName(Priority p)
+{
+    return p == PriorityInteractive ? "interactive" : "batch";
+}
+
+// Accepts "interactive"/"i" and "batch"/"b"
+inline bool parsePriority(const std::string& s, Priority& out)
+{
+    if (s == "interactive" || s == "i") { out = PriorityInteractive; return true; }
+    if (s == "batch" || s == "b")       { out = PriorityBatch;       return true; }
+    return false;
+}
+
+struct Job
+{
+    uint64_t id = 0;
+    Priority priority = PriorityBatch;
+    std::string input;    // .vox file
+    std::string output;   // .bsz file
+    uint64_t cost = 0;    // estimated work in voxels, orders the batch queue
+    std::chrono::steady_clock::time_point queued;
+};
+
+// Point-in-time view of the queues, for metrics
+struct Snapshot
+{
+    unsigned queued[PriorityCount] = {};
+    unsigned running[PriorityCount] = {};
+    unsigned paused[PriorityCount] = {};
+    unsigned helping[PriorityCount] = {};   // slots lent to parallelFor pieces of running jobs
+};
+
+class Scheduler
+{
+public:
+    // Runs one job on a worker thread, returns true on success
+    using RunFn = std::function<bool(const Job&)>;
+    // Reports a finished job, called on the worker thread
+    using DoneFn = std::function<void(const Job&, bool ok, double seconds)>;
+
+    // slots: total concurrent jobs, limits: per class maximum (0 = no extra limit)
+    Scheduler(unsigned slots, const unsigned (&limits)[PriorityCount], RunFn run, DoneFn done)
+        : m_freeSlots(slots ? slots : 1), m_run(std::move(run)), m_done(std::move(done))
+    {
+        for (int p = 0; p < PriorityCount; ++p)
+            m_limit[p] = limits[p] ? limits[p] : m_freeSlots;
+    }
+
+    // Waits for and joins any thread still running, run() normally has already
+    ~Scheduler()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&] { return m_live == 0; });
+        joinThreads();
+    }
+
+    // Thread-safe, may be called while run() is dispatching
+    uint64_t submit(Priority priority, const std::string& input, const std::string& output, uint64_t cost = 0)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Job job;
+        job.id = ++m_nextId;
+        job.priority = priority;
+        job.input = input;
+        job.output = output;
+        job.cost = cost;
+        job.queued = std::chrono::steady_clock::now();
+        std::deque<Job>& queue = m_queue[priority];
+        if (priority == PriorityBatch) {
+            // Largest first, equal costs keep their submission order
+            auto at = std::upper_bound(queue.begin(), queue.end(), job,
+                                       [](const Job& a, const Job& b) { return a.cost > b.cost; });
+            queue.insert(at, job);
+        } else {
+            queue.push_back(job);
+        }
+        m_cv.notify_all();
+        return job.id;
+    }
+
+    // No more submissions, run() returns once everything queued has finished
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_cv.notify_all();
+    }
+
+    Snapshot snapshot()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Snapshot snap;
+        for (int p = 0; p < PriorityCount; ++p)
+        {
+            snap.queued[p] = static_cast<unsigned>(m_queue[p].size());
+            snap.running[p] = m_running[p] - m_helping[p];
+            snap.paused[p] = m_paused[p];
+            snap.helping[p] = m_helping[p];
+        }
+        return snap;
+    }
+
+    // Dispatch loop, blocks until close() was called and all jobs are done
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            reapThreads();
+            int p = PriorityCount;
+            Group* group = nullptr;
+            m_cv.wait(lock, [&] {
+                group = nextHelpedGroup();
+                if (group) return true;
+                p = nextDispatchable();
+                return p < PriorityCount || (m_closed && idle());
+            });
+
+            if (group)
+            {
+                // The piece is claimed here, which keeps the group alive until the helper is done with it
+                size_t first = claim(*group);
+                --m_freeSlots;
+                ++m_running[group->priority];
+                ++m_helping[group->priority];
+                ++m_live;
+                start(std::thread(&Scheduler::helper, this, group, first));
+                continue;
+            }
+            if (p == PriorityCount) break; // closed and drained
+
+            Job job = m_queue[p].front();
+            m_queue[p].pop_front();
+            --m_freeSlots;
+            ++m_running[p];
+            ++m_live;
+            start(std::thread(&Scheduler::worker, this, job));
+        }
+        // Every thread has left its last locked section, they only have to return
+        joinThreads();
+    }
+
+    // Called by a running job at a model boundary
+    // Gives the slot to a waiting higher class job and blocks until it may continue
+    void checkpoint(const Job& job)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!higherClassStarved(job.priority)) return;
+
+        --m_running[job.priority];
+        ++m_freeSlots;
+        ++m_paused[job.priority];
+        m_cv.notify_all();
+
+        m_cv.wait(lock, [&] {
+            return !higherClassWaiting(job.priority) && m_freeSlots > 0 && m_running[job.priority] < m_limit[job.priority];
+        });
+
+        --m_paused[job.priority];
+        --m_freeSlots;
+        ++m_running[job.priority];
+        m_cv.notify_all();
+    }
+
+    // Called by a running job: runs fn(0) .. fn(count - 1) and returns when all have
+    // finished. The calling thread takes part, helpers only use slots that are free.
+    // An exception from any piece is rethrown here once the others are done.
+    void parallelFor(const Job& job, size_t count, const std::function<void(size_t)>& fn)
+    {
+        if (count == 0) return;
+        Group group;
+        group.priority = job.priority;
+        group.fn = &fn;
+        group.count = count;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        size_t first = claim(group);
+        if (group.next < group.count) {
+            m_groups.push_back(&group);
+            m_cv.notify_all();
+        }
+        lock.unlock();
+        work(group, first);
+
+        lock.lock();
+        m_cv.wait(lock, [&] { return group.finished == group.count; });
+        if (group.error) std::rethrow_exception(group.error);
+    }
+
+private:
+    // The pieces of one parallelFor call, owned by the calling job's stack
+    struct Group
+    {
+        Priority priority = PriorityBatch;
+        const std::function<void(size_t)>* fn = nullptr;
+        size_t count = 0;
+        size_t next = 0;       // next piece to hand out
+        size_t finished = 0;
+        std::exception_ptr error;
+    };
+
+    // Hands out the next piece, or count if none are left. Call with the mutex held.
+    size_t claim(Group& group)
+    {
+        if (group.next >= group.count) return group.count;
+        size_t i = group.next++;
+        if (group.next == group.count)
+            m_groups.erase(std::remove(m_groups.begin(), m_groups.end(), &group), m_groups.end());
+        return i;
+    }
+
+    // Runs piece 'i' and keeps claiming more until none are left
+    // The next piece is claimed before 'i' counts as finished: once the last piece has
+    // finished the owner may return, so the group must not be touched after that
+    void work(Group& group, size_t i)
+    {
+        const size_t count = group.count;
+        std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+        while (i < count)
+        {
+            std::exception_ptr error;
+            try { (*group.fn)(i); } catch (...) { error = std::current_exception(); }
+            lock.lock();
+            if (error && !group.error) group.error = error;
+            size_t next = claim(group);
+            if (++group.finished == count) m_cv.notify_all();
+            lock.unlock();
+            i = next;
+        }
+    }
+
+    void helper(Group* group, size_t first)
+    {
+        const Priority priority = group->priority;
+        work(*group, first);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_helping[priority];
+        --m_running[priority];
+        ++m_freeSlots;
+        --m_live;
+        exiting();
+        m_cv.notify_all();
+    }
+
+    // A group with pieces left whose class may use a free slot, or nullptr
+    Group* nextHelpedGroup() const
+    {
+        if (m_freeSlots == 0) return nullptr;
+        for (Group* group : m_groups)
+        {
+            int p = group->priority;
+            if (m_running[p] >= m_limit[p] || m_paused[p] > 0 || higherClassWaiting(p)) continue;
+            return group;
+        }
+        return nullptr;
+    }
+
+    // Highest class that has a job and room to run it, or PriorityCount
+    int nextDispatchable() const
+    {
+        if (m_freeSlots == 0) return PriorityCount;
+        for (int p = 0; p < PriorityCount; ++p)
+        {
+            if (m_queue[p].empty() || m_running[p] >= m_limit[p]) continue;
+            if (m_paused[p] > 0) continue; // paused jobs of this class resume first
+            return p;
+        }
+        return PriorityCount;
+    }
+
+    // A more important job is queued and could run if it had a slot
+    bool higherClassWaiting(int priority) const
+    {
+        for (int p = 0; p < priority; ++p)
+            if (!m_queue[p].empty() && m_running[p] < m_limit[p]) return true;
+        return false;
+    }
+
+    bool higherClassStarved(int priority) const
+    {
+        return m_freeSlots == 0 && higherClassWaiting(priority);
+    }
+
+    bool idle() const
+    {
+        if (m_live) return false;
+        for (int p = 0; p < PriorityCount; ++p)
+            if (!m_queue[p].empty()) return false;
+        return true;
+    }
+
+    // Keeps a started thread until it has exited. Call with the mutex held, so the
+    // thread can't report its exit before it is known.
+    void start(std::thread thread)
+    {
+        std::thread::id id = thread.get_id();
+        m_threads.emplace(id, std::move(thread));
+    }
+
+    // Called by a thread in its last locked section
+    void exiting()
+    {
+        m_exited.push_back(std::this_thread::get_id());
+    }
+
+    // Joins the threads that have exited. Call with the mutex held: they don't lock it again.
+    void reapThreads()
+    {
+        for (std::thread::id id : m_exited)
+        {
+            auto found = m_threads.find(id);
+            if (found == m_threads.end()) continue;
+            found->second.join();
+            m_threads.erase(found);
+        }
+        m_exited.clear();
+    }
+
+    void joinThreads()
+    {
+        reapThreads();
+        for (auto& entry : m_threads)
+            if (entry.second.joinable()) entry.second.join();
+        m_threads.clear();
+    }
+
+    void worker(Job job)
+    {
+        bool ok = false;
+        try { ok = m_run(job); } catch (...) { ok = false; }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.queued).count();
+        if (m_done) m_done(job, ok, seconds);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_running[job.priority];
+        ++m_freeSlots;
+        --m_live;
+        exiting();
+        m_cv.notify_all();
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Job> m_queue[PriorityCount];
+    unsigned m_running[PriorityCount] = {};
+    unsigned m_paused[PriorityCount] = {};
+    unsigned m_helping[PriorityCount] = {};
+    std::deque<Group*> m_groups;          // parallelFor calls with pieces left to hand out
+    std::map<std::thread::id, std::thread> m_threads;   // started and not joined yet
+    std::vector<std::thread::id> m_exited;              // done with the scheduler, ready to join
+    unsigned m_limit[PriorityCount] = {};
+    unsigned m_freeSlots = 1;
+    unsigned m_live = 0;
+    uint64_t m_nextId = 0;
+    bool m_closed = false;
+    RunFn m_run;
+    DoneFn m_done;
+};
+
+}} // namespace vox2bella::jobs
@@ -0,0 +1,141 @@
+// vox2bella_materials.h - MagicaVoxel MATL settings mapped to the cheapest Bella material
+//
+// Bella's layered material can reproduce every MATL type, but it evaluates all of
+// its lobes for every hit, which is wasted time on the plain diffuse voxels that make
+// up most scenes. Each palette entry therefore gets the simplest material that still
+// looks the way MagicaVoxel shows it:
+//
+//   _diffuse            orenNayar   (diffuse)
+//   _metal, fully metal conductor   (conductor)
+//   _glass, see-through dielectric  (dielectric)
+//   _media              dielectric with an IOR of 1, the density sets the absorption depth
+//   _emit               emitter     (emitter)
+//   _blend              the single one of the above its weights reduce to, else uber
+//
+// A metal or glass whose weight is zero falls back to diffuse, and only a true mix of
+// metal, glass and diffuse becomes a layered uber material. Entries that map to the
+// same parameters share one node, MaterialSpec::less orders them for that.
+// Nothing in here depends on the Bella SDK.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include "vox2bella_vox.h"
+
+namespace vox2bella { namespace materials {
+
+// Bella material node types, cheapest first
+enum MaterialClass : uint8_t
+{
+    ClassDiffuse, ClassConductor, ClassDielectric, ClassEmitter, ClassLayered, NumClasses
+};
+
+inline const char* className(MaterialClass c)
+{
+    static const char* names[NumClasses] = { "diffuse", "conductor", "dielectric", "emitter", "layered" };
+    return names[c];
+}
+
+// Bella node type that implements a class
+inline const char* nodeType(MaterialClass c)
+{
+    static const char* types[NumClasses] = { "orenNayar", "conductor", "dielectric", "emitter", "uber" };
+    return types[c];
+}
+
+// Parameters of one Bella material, only those the class uses are set
+struct MaterialSpec
+{
+    MaterialClass cls = ClassDiffuse;
+    uint32_t color = 0;         // palette RGBA, the reflectance, transmittance or emission color
+    float roughness = 0.0f;     // 0..1
+    float ior = 1.5f;
+    float depth = 0.0f;         // dielectric: distance (in voxels) over which 'color' is reached, 0 = surface tint
+    float energy = 0.0f;        // emitter
+    float metallic = 0.0f;      // layered weights
+    float transmission = 0.0f;
+
+    // Quantised so that settings that differ by less than the UI can show share a node
+    static bool less(const MaterialSpec& a, const MaterialSpec& b) { return a.key() < b.key(); }
+
+private:
+    std::tuple<int, uint32_t, long, long, long, long, long, long> key() const
+    {
+        auto q = [](float v) { return std::lround(double(v) * 1000.0); };
+        return std::make_tuple(int(cls), color, q(roughness), q(ior), q(depth), q(energy), q(metallic), q(transmission));
+    }
+};
+
+// Picks the material for one palette color, 'matl' is null if the file has no MATL for it
+inline MaterialSpec mapMaterial(const vox::Material* matl, uint32_t color)
+{
+    MaterialSpec spec;
+    spec.color = color;
+    if (!matl) return spec;
+
+    const float on = 0.01f, full = 0.99f;
+    spec.roughness = std::min(1.0f, std::max(0.0f, matl->rough));
+    spec.ior = 1.0f + std::max(0.0f, matl->ior);        // MATL stores IOR - 1
+    // Older files carry the metal or glass amount and the emission strength in _weight
+    const float metal = matl->has(vox::Key_metal) ? matl->metal : matl->weight;
+    const float trans = matl->has(vox::Key_trans) ? matl->trans : matl->weight;
+    const float emit = matl->has(vox::Key_emit) ? matl->emit : matl->weight;
+
+    switch (matl->type)
+    {
+        case vox::MaterialDiffuse:
+            break;
+        case vox::MaterialMetal:
+            if (metal >= full) spec.cls = ClassConductor;
+            else if (metal > on) { spec.cls = ClassLayered; spec.metallic = metal; }
+            break;
+        case vox::MaterialGlass:
+            if (trans >= full) spec.cls = ClassDielectric;
+            else if (trans > on) { spec.cls = ClassLayered; spec.transmission = trans; }
+            break;
+        case vox::MaterialMedia:
+            // No refraction, the density sets how quickly the color is reached
+            spec.cls = ClassDielectric;
+            spec.ior = 1.0f;
+            spec.roughness = 0.0f;
+            spec.depth = matl->density > 0.0f ? std::min(256.0f, 1.0f / matl->density) : 1.0f;
+            break;
+        case vox::MaterialEmit:
+            // _flux is MagicaVoxel's power exponent
+            if (emit > 0.0f) {
+                spec.cls = ClassEmitter;
+                spec.energy = float(double(emit) * std::pow(10.0, double(matl->flux)));
+            }
+            break;
+        case vox::MaterialBlend:
+        {
+            const float m = matl->has(vox::Key_metal) ? matl->metal : 0.0f;
+            const float t = matl->has(vox::Key_trans) ? matl->trans : 0.0f;
+            if (m <= on && t <= on) break;
+            if (m >= full && t <= on) spec.cls = ClassConductor;
+            else if (t >= full && m <= on) spec.cls = ClassDielectric;
+            else { spec.cls = ClassLayered; spec.metallic = m; spec.transmission = t; }
+            break;
+        }
+    }
+    if (spec.cls != ClassDielectric && spec.cls != ClassLayered) spec.ior = 1.5f;
+    if (spec.cls == ClassDiffuse || spec.cls == ClassEmitter) spec.roughness = 0.0f;
+    return spec;
+}
+
+// Specs for the whole palette. MATL ids are palette indices; a later MATL for the
+// same index replaces an earlier one.
+inline void mapPalette(const uint32_t (&palette)[256], const std::vector<vox::Material>& matls, MaterialSpec (&specs)[256])
+{
+    const vox::Material* byIndex[256] = {};
+    for (const vox::Material& m : matls)
+        if (m.materialId >= 0 && m.materialId <= 255) byIndex[m.materialId] = &m;
+    for (int i = 0; i < 256; ++i) specs[i] = mapMaterial(byIndex[i], palette[i]);
+}
+
+}} // namespace vox2bella::materials
@@ -0,0 +1,89 @@
+// vox2bella_mesh.h - Face-culled quads per color for -em:mesh and -em:world
+//
+// A box per voxel (-em:instanced) is simple but heavy: most faces of a solid model
+// touch another voxel and can never be seen. The mesh writers keep a face only if the
+// cell on its other side is empty, and gather the quads per color index so that each
+// color becomes one mesh with one material.
+//
+// Corners are stored as floats, x,y,z per corner and 4 corners per quad, wound like
+// vox::faceCorners. Voxels are unit cells centred on their integer coordinates, like
+// the box instances. Nothing in here depends on the Bella SDK.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "vox2bella_vox.h"
+
+namespace vox2bella { namespace mesh {
+
+// Quads of the voxels of one color
+struct Group
+{
+    uint8_t colorIndex = 0;
+    std::vector<float> points;      // x,y,z per corner, 4 corners per quad
+};
+
+// Groups in order of the first face of each color
+class ColorGroups
+{
+public:
+    ColorGroups() { std::fill(m_groupOf, m_groupOf + 256, -1); }
+
+    // Adds face d (see vox::faceDirs) of the voxel at (x,y,z)
+    void addFace(int32_t x, int32_t y, int32_t z, int d, uint8_t c)
+    {
+        std::vector<float>& pts = group(c).points;
+        for (int k = 0; k < 4; ++k) {
+            pts.push_back(float(x) - 0.5f + vox::faceCorners[d][k][0]);
+            pts.push_back(float(y) - 0.5f + vox::faceCorners[d][k][1]);
+            pts.push_back(float(z) - 0.5f + vox::faceCorners[d][k][2]);
+        }
+    }
+
+    // Moves the quads of 'other' to the end of the matching groups, releasing them there
+    void merge(ColorGroups& other)
+    {
+        for (Group& g : other.m_groups)
+        {
+            std::vector<float>& pts = group(g.colorIndex).points;
+            pts.insert(pts.end(), g.points.begin(), g.points.end());
+            std::vector<float>().swap(g.points);
+        }
+    }
+
+    size_t size() const { return m_groups.size(); }
+    Group& operator[](size_t i) { return m_groups[i]; }
+    const Group& operator[](size_t i) const { return m_groups[i]; }
+
+private:
+    Group& group(uint8_t c)
+    {
+        if (m_groupOf[c] < 0) {
+            m_groupOf[c] = int(m_groups.size());
+            m_groups.emplace_back();
+            m_groups.back().colorIndex = c;
+        }
+        return m_groups[size_t(m_groupOf[c])];
+    }
+
+    std::vector<Group> m_groups;
+    int m_groupOf[256];             // color index -> entry in m_groups, -1 before its first face
+};
+
+// Adds the exposed faces of XYZI records [begin, end) to 'out'
+// 'grid' holds the model's occupancy (see vox::fillGrid), so a model can be meshed
+// over several calls
+template <class Grid>
+inline void addExposedFaces(const Grid& grid, const uint8_t* records, uint32_t begin, uint32_t end, ColorGroups& out)
+{
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const uint8_t* v = records + size_t(i) * 4;
+        vox::exposedFaces(grid, v, [&](int d) { out.addFace(v[0], v[1], v[2], d, v[3]); });
+    }
+}
+
+}} // namespace vox2bella::mesh
@@ -0,0 +1,343 @@
+// vox2bella_metrics.h - Prometheus-format metrics for the long-running modes
+//
+// Counters, gauges and histograms live in one registry. The text is produced in the
+// Prometheus exposition format (version 0.0.4) and can be
+// - written to a file every few seconds (atomically, via a temporary file and rename),
+//   which suits node_exporter's textfile collector, and/or
+// - served over plain HTTP on 127.0.0.1:<port> for direct scraping.
+//
+// Metrics are updated per job, not per voxel, so a single mutex is plenty.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>    // For htons, htonl
+#include <netinet/in.h>   // For sockaddr_in
+#include <poll.h>         // For poll with a timeout so the server can stop
+#include <sys/resource.h> // For getrusage (memory high-water mark)
+#include <sys/socket.h>   // For socket, bind, listen, accept
+#include <unistd.h>       // For close
+#endif
+
+namespace vox2bella { namespace metrics {
+
+// Bucket upper bounds in seconds, from a tiny prop to a whole city
+inline const std::vector<double>& defaultBuckets()
+{
+    static const std::vector<double> buckets = { 0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300, 900 };
+    return buckets;
+}
+
+class Registry
+{
+public:
+    enum Type { Counter, Gauge, Histogram };
+
+    // The process-wide registry, shared by every mode
+    static Registry& global()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    // Registers the HELP and TYPE lines for a metric family
+    void describe(const std::string& name, Type type, const std::string& help)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Family& f = m_families[name];
+        f.type = type;
+        f.help = help;
+    }
+
+    // labels are pre-formatted, e.g. class="batch" (may be empty)
+    void add(const std::string& name, const std::string& labels, double value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_families[name].series[labels].value += value;
+    }
+
+    void set(const std::string& name, const std::string& labels, double value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_families[name].series[labels].value = value;
+    }
+
+    void observe(const std::string& name, const std::string& labels, double value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Series& s = m_families[name].series[labels];
+        const std::vector<double>& bounds = defaultBuckets();
+        if (s.buckets.empty()) s.buckets.assign(bounds.size(), 0);
+        for (size_t i = 0; i < bounds.size(); ++i)
+            if (value <= bounds[i]) ++s.buckets[i];
+        s.value += value; // sum
+        ++s.count;
+    }
+
+    // Called before every render, used to refresh gauges such as queue depth
+    // Returns a handle for removeCollector(), see also ScopedCollector
+    uint64_t onCollect(std::function<void(Registry&)> fn)
+    {
+        std::lock_guard<std::mutex> lock(m_collectMutex);
+        m_collectors.emplace(++m_nextCollector, std::move(fn));
+        return m_nextCollector;
+    }
+
+    // Once this returns the collector is not running and won't be called again
+    void removeCollector(uint64_t handle)
+    {
+        std::lock_guard<std::mutex> lock(m_collectMutex);
+        m_collectors.erase(handle);
+    }
+
+    std::string render()
+    {
+        {
+            // Held while the collectors run, so removeCollector() waits for them
+            std::lock_guard<std::mutex> lock(m_collectMutex);
+            for (auto& entry : m_collectors) entry.second(*this);
+        }
+        collectProcess();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::ostringstream out;
+        for (const auto& [name, f] : m_families)
+        {
+            if (!f.help.empty()) out << "# HELP " << name << " " << f.help << "\n";
+            out << "# TYPE " << name << " " << (f.type == Counter ? "counter" : f.type == Gauge ? "gauge" : "histogram") << "\n";
+            for (const auto& [labels, s] : f.series)
+            {
+                if (f.type != Histogram)
+                {
+                    out << name << braces(labels) << " " << s.value << "\n";
+                    continue;
+                }
+                const std::vector<double>& bounds = defaultBuckets();
+                std::string sep = labels.empty() ? "" : labels + ",";
+                for (size_t i = 0; i < s.buckets.size(); ++i)
+                    out << name << "_bucket{" << sep << "le=\"" << bounds[i] << "\"} " << s.buckets[i] << "\n";
+                out << name << "_bucket{" << sep << "le=\"+Inf\"} " << s.count << "\n";
+                out << name << "_sum" << braces(labels) << " " << s.value << "\n";
+                out << name << "_count" << braces(labels) << " " << s.count << "\n";
+            }
+        }
+        return out.str();
+    }
+
+private:
+    struct Series
+    {
+        double value = 0;             // counter/gauge value, or histogram sum
+        uint64_t count = 0;           // histogram only
+        std::vector<uint64_t> buckets; // histogram only, cumulative count per upper bound
+    };
+    struct Family
+    {
+        Type type = Gauge;
+        std::string help;
+        std::map<std::string, Series> series;
+    };
+
+    static std::string braces(const std::string& labels)
+    {
+        return labels.empty() ? "" : "{" + labels + "}";
+    }
+
+    // Peak resident memory of this process
+    void collectProcess()
+    {
+#if !defined(_WIN32)
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+#if defined(__APPLE__)
+            double peak = double(usage.ru_maxrss);          // bytes on macOS
+#else
+            double peak = double(usage.ru_maxrss) * 1024.0; // kilobytes on Linux
+#endif
+            describe("vox2bella_memory_peak_bytes", Gauge, "Peak resident set size of the process");
+            set("vox2bella_memory_peak_bytes", "", peak);
+        }
+#endif
+    }
+
+    std::mutex m_mutex;
+    std::map<std::string, Family> m_families;
+    std::mutex m_collectMutex;
+    std::map<uint64_t, std::function<void(Registry&)>> m_collectors;
+    uint64_t m_nextCollector = 0;
+};
+
+// A collector registered for as long as this object lives. Declare it after the
+// objects the collector reads, so it is removed before they are destroyed.
+class ScopedCollector
+{
+public:
+    ScopedCollector(Registry& registry, std::function<void(Registry&)> fn)
+        : m_registry(registry), m_handle(registry.onCollect(std::move(fn))) {}
+    ~ScopedCollector() { m_registry.removeCollector(m_handle); }
+    ScopedCollector(const ScopedCollector&) = delete;
+    ScopedCollector& operator=(const ScopedCollector&) = delete;
+
+private:
+    Registry& m_registry;
+    uint64_t m_handle;
+};
+
+// Publishes the registry to a file and/or a local HTTP socket from a background thread
+class Exporter
+{
+public:
+    ~Exporter() { stop(); }
+
+    // filePath may be empty, port 0 disables the socket
+    bool start(const std::string& filePath, double intervalSeconds, int port, std::string& error)
+    {
+        m_filePath = filePath;
+        m_interval = intervalSeconds > 0 ? intervalSeconds : 10.0;
+        if (port > 0 && !listenOn(port, error)) return false;
+        m_running = true;
+        m_thread = std::thread(&Exporter::loop, this);
+        return true;
+    }
+
+    // Stops the thread and writes the file one last time so the final totals are kept
+    void stop()
+    {
+        if (!m_running) return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+        writeFile();
+#if !defined(_WIN32)
+        if (m_listenFd >= 0) ::close(m_listenFd);
+        m_listenFd = -1;
+#endif
+    }
+
+    // Writes the file now, replacing the previous one atomically
+    bool writeFile()
+    {
+        if (m_filePath.empty()) return true;
+        std::string tmp = m_filePath + ".tmp";
+        FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) return false;
+        std::string text = Registry::global().render();
+        bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+        ok = (std::fclose(f) == 0) && ok;
+        // std::filesystem::rename replaces the target on Windows too, std::rename doesn't
+        std::error_code ec;
+        if (ok) std::filesystem::rename(tmp, m_filePath, ec);
+        return ok && !ec;
+    }
+
+private:
+    bool listenOn(int port, std::string& error)
+    {
+#if defined(_WIN32)
+        error = "the metrics socket is only supported on POSIX systems, use a metrics file instead";
+        return false;
+#else
+        m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_listenFd < 0) { error = "cannot create metrics socket"; return false; }
+        int yes = 1;
+        setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // local only, never exposed on the network
+        if (bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listenFd, 8) != 0)
+        {
+            error = "cannot listen on 127.0.0.1:" + std::to_string(port);
+            ::close(m_listenFd);
+            m_listenFd = -1;
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    void loop()
+    {
+        auto nextWrite = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running)
+        {
+            if (std::chrono::steady_clock::now() >= nextWrite)
+            {
+                lock.unlock();
+                writeFile();
+                lock.lock();
+                nextWrite = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_interval));
+            }
+            if (m_listenFd >= 0)
+            {
+                // Serve scrapes in between file writes, waking up often enough to notice stop()
+                lock.unlock();
+                serveOne(200);
+                lock.lock();
+            }
+            else
+            {
+                m_cv.wait_until(lock, nextWrite, [&] { return !m_running; });
+            }
+        }
+    }
+
+    // Answers at most one HTTP request, whatever its path
+    void serveOne(int timeoutMs)
+    {
+#if !defined(_WIN32)
+        pollfd pfd = { m_listenFd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeoutMs) <= 0) return;
+        int client = accept(m_listenFd, nullptr, nullptr);
+        if (client < 0) return;
+        char request[1024];
+        pollfd cfd = { client, POLLIN, 0 };
+        if (poll(&cfd, 1, 1000) > 0) (void)!recv(client, request, sizeof(request), 0);
+        std::string body = Registry::global().render();
+        std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                             + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+#if defined(MSG_NOSIGNAL)
+            ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+#else
+            ssize_t n = send(client, response.data() + sent, response.size() - sent, 0);
+#endif
+            if (n <= 0) break;
+            sent += static_cast<size_t>(n);
+        }
+        ::close(client);
+#else
+        (void)timeoutMs;
+#endif
+    }
+
+    std::string m_filePath;
+    double m_interval = 10.0;
+    int m_listenFd = -1;
+    bool m_running = false;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+};
+
+}} // namespace vox2bella::metrics
@@ -0,0 +1,263 @@
+// vox2bella_orbit.h - In-between orbit frames reprojected from rendered keyframes
+//
+// Neighbouring turntable frames differ by a small camera rotation. With a keyframe
+// interval k, only every k-th frame is rendered; the frames in between are built
+// from the two keyframes around them:
+//
+// - The scene's voxels are known exactly, so depth and object ID buffers don't need
+//   extra render passes: a ray cast through the voxel grid gives, for every pixel,
+//   the voxel it sees (its ID) and the point on that voxel's surface.
+// - For a pixel of the in-between frame, that point is projected into both keyframes.
+//   A keyframe can supply the color if its own pixel there, or one next to it, sees
+//   the same voxel; otherwise the point was hidden (or off screen) in that keyframe. The colors of
+//   the keyframes that saw it are blended by the frame's position between them.
+// - Pixels that see a voxel neither keyframe saw are disoccluded. If too many are,
+//   the frame is rendered for real instead.
+// - Pixels that see no voxel (ground, sky) take the keyframes' pixels at the same
+//   position, blended the same way.
+//
+// Cameras are pinhole cameras built from the camera's world matrix, row-major with
+// the translation in the last row like the matrices vox2bella writes. Rows 0 to 2
+// are the image right, image down and viewing directions. Voxels are unit cells
+// centred on their integer coordinates, like the emitted boxes.
+// Nothing in here depends on the Bella SDK.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace vox2bella { namespace orbit {
+
+// Pinhole camera for one frame
+struct Camera
+{
+    double eye[3] = { 0, 0, 0 };
+    double right[3] = { 1, 0, 0 };
+    double down[3] = { 0, 1, 0 };
+    double forward[3] = { 0, 0, 1 };
+    double tanHalfX = 1.0, tanHalfY = 1.0;
+    uint32_t width = 0, height = 0;
+
+    // 'm' is the camera's 4x4 world matrix, fovDegrees spans the image width
+    static Camera fromMatrix(const double* m, double fovDegrees, uint32_t width, uint32_t height)
+    {
+        Camera c;
+        auto unit = [](const double* v, double (&out)[3]) {
+            double len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            for (int a = 0; a < 3; ++a) out[a] = len > 0 ? v[a] / len : 0.0;
+        };
+        unit(m + 0, c.right);
+        unit(m + 4, c.down);
+        unit(m + 8, c.forward);
+        for (int a = 0; a < 3; ++a) c.eye[a] = m[12 + a];
+        c.width = width;
+        c.height = height;
+        c.tanHalfX = std::tan(fovDegrees * 0.5 * 3.14159265358979323846 / 180.0);
+        c.tanHalfY = width ? c.tanHalfX * double(height) / double(width) : c.tanHalfX;
+        return c;
+    }
+
+    // Direction through the centre of pixel (px, py), not normalised
+    void ray(uint32_t px, uint32_t py, double (&dir)[3]) const
+    {
+        double x = ((px + 0.5) / width * 2.0 - 1.0) * tanHalfX;
+        double y = ((py + 0.5) / height * 2.0 - 1.0) * tanHalfY;
+        for (int a = 0; a < 3; ++a) dir[a] = right[a] * x + down[a] * y + forward[a];
+    }
+
+    // Pixel that sees world point p, false if it is behind the camera or off the image
+    bool project(const double (&p)[3], uint32_t& px, uint32_t& py) const
+    {
+        double v[3] = { p[0] - eye[0], p[1] - eye[1], p[2] - eye[2] };
+        double z = v[0] * forward[0] + v[1] * forward[1] + v[2] * forward[2];
+        if (z <= 1e-9) return false;
+        double x = (v[0] * right[0] + v[1] * right[1] + v[2] * right[2]) / z / tanHalfX;
+        double y = (v[0] * down[0] + v[1] * down[1] + v[2] * down[2]) / z / tanHalfY;
+        double fx = std::floor((x + 1.0) * 0.5 * width), fy = std::floor((y + 1.0) * 0.5 * height);
+        if (fx < 0 || fy < 0 || fx >= width || fy >= height) return false;
+        px = uint32_t(fx);
+        py = uint32_t(fy);
+        return true;
+    }
+};
+
+// Occupied cells of the scene in world voxel coordinates (0..255 on each axis)
+class VoxelWorld
+{
+public:
+    VoxelWorld() : m_bits(size_t(256) * 256 * 256 / 64, 0) {}
+
+    // Adds XYZI records, the color index is not needed
+    void add(const uint8_t* records, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint8_t* v = records + size_t(i) * 4;
+            size_t cell = cellIndex(v[0], v[1], v[2]);
+            m_bits[cell >> 6] |= uint64_t(1) << (cell & 63);
+            for (int a = 0; a < 3; ++a) {
+                m_min[a] = std::min<int>(m_min[a], v[a]);
+                m_max[a] = std::max<int>(m_max[a], v[a]);
+            }
+        }
+    }
+
+    bool empty() const { return m_min[0] > m_max[0]; }
+
+    // Lowest and highest occupied cell on each axis, only meaningful if not empty()
+    void bounds(int (&lo)[3], int (&hi)[3]) const
+    {
+        for (int a = 0; a < 3; ++a) { lo[a] = m_min[a]; hi[a] = m_max[a]; }
+    }
+
+    // First occupied cell along o + t*d, t >= 0. Sets its ID (cell index + 1) and the
+    // point where the ray enters it. Cells are stepped through one at a time (3D DDA).
+    bool cast(const double (&o)[3], const double (&d)[3], uint32_t& id, double (&hit)[3]) const
+    {
+        if (empty()) return false;
+        double t0 = 0.0, t1 = std::numeric_limits<double>::infinity();
+        for (int a = 0; a < 3; ++a)
+        {
+            double lo = m_min[a] - 0.5, hi = m_max[a] + 0.5;
+            if (std::fabs(d[a]) < 1e-12) {
+                if (o[a] < lo || o[a] > hi) return false;
+                continue;
+            }
+            double ta = (lo - o[a]) / d[a], tb = (hi - o[a]) / d[a];
+            if (ta > tb) std::swap(ta, tb);
+            t0 = std::max(t0, ta);
+            t1 = std::min(t1, tb);
+        }
+        if (t0 > t1) return false;
+
+        int cell[3], step[3];
+        double tMax[3], tDelta[3];
+        for (int a = 0; a < 3; ++a)
+        {
+            double p = o[a] + d[a] * t0;
+            cell[a] = std::min(m_max[a], std::max(m_min[a], int(std::floor(p + 0.5))));
+            step[a] = d[a] > 0 ? 1 : -1;
+            if (std::fabs(d[a]) < 1e-12) {
+                tMax[a] = tDelta[a] = std::numeric_limits<double>::infinity();
+            } else {
+                double boundary = cell[a] + 0.5 * step[a];
+                tMax[a] = t0 + (boundary - p) / d[a];
+                tDelta[a] = 1.0 / std::fabs(d[a]);
+            }
+        }
+        double t = t0;
+        for (;;)
+        {
+            size_t index = cellIndex(cell[0], cell[1], cell[2]);
+            if (m_bits[index >> 6] & (uint64_t(1) << (index & 63))) {
+                id = uint32_t(index) + 1;
+                for (int a = 0; a < 3; ++a) hit[a] = o[a] + d[a] * t;
+                return true;
+            }
+            int axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+            t = tMax[axis];
+            cell[axis] += step[axis];
+            if (cell[axis] < m_min[axis] || cell[axis] > m_max[axis]) return false;
+            tMax[axis] += tDelta[axis];
+        }
+    }
+
+private:
+    static size_t cellIndex(int x, int y, int z) { return size_t(x) | size_t(y) << 8 | size_t(z) << 16; }
+
+    std::vector<uint64_t> m_bits;
+    int m_min[3] = { 255, 255, 255 };
+    int m_max[3] = { 0, 0, 0 };
+};
+
+// A rendered frame with the voxel ID seen by each pixel (0 = none)
+struct Keyframe
+{
+    Camera camera;
+    std::vector<uint8_t> rgba;
+    std::vector<uint32_t> ids;
+};
+
+// Fills the ID buffer of a rendered keyframe
+inline void traceIds(const VoxelWorld& world, Keyframe& key)
+{
+    const Camera& cam = key.camera;
+    key.ids.assign(size_t(cam.width) * cam.height, 0);
+    for (uint32_t py = 0; py < cam.height; ++py)
+        for (uint32_t px = 0; px < cam.width; ++px)
+        {
+            double dir[3], hit[3];
+            uint32_t id;
+            cam.ray(px, py, dir);
+            if (world.cast(cam.eye, dir, id, hit)) key.ids[size_t(py) * cam.width + px] = id;
+        }
+}
+
+// Builds the frame seen by 'cam' at 't' (0 = at a, 1 = at b) into 'rgba'
+// Returns the fraction of voxel pixels that neither keyframe saw (0 if there are none)
+inline double synthesize(const VoxelWorld& world, const Keyframe& a, const Keyframe& b, const Camera& cam,
+                         double t, std::vector<uint8_t>& rgba)
+{
+    const size_t pixels = size_t(cam.width) * cam.height;
+    rgba.assign(pixels * 4, 0);
+    size_t voxelPixels = 0, missing = 0;
+    const bool sameSize = a.rgba.size() == pixels * 4 && b.rgba.size() == pixels * 4;
+    for (uint32_t py = 0; py < cam.height; ++py)
+        for (uint32_t px = 0; px < cam.width; ++px)
+        {
+            const size_t i = size_t(py) * cam.width + px;
+            uint8_t* out = &rgba[i * 4];
+            double dir[3], hit[3];
+            uint32_t id;
+            cam.ray(px, py, dir);
+            if (!world.cast(cam.eye, dir, id, hit))
+            {
+                if (sameSize)
+                    for (int c = 0; c < 4; ++c)
+                        out[c] = uint8_t(std::lround(a.rgba[i * 4 + c] * (1.0 - t) + b.rgba[i * 4 + c] * t));
+                continue;
+            }
+            ++voxelPixels;
+
+            // A keyframe supplies the color if it saw the same voxel at that point. The
+            // point can land just across a voxel edge in the keyframe, so the pixels
+            // around it are tried as well.
+            const uint8_t* from[2] = { nullptr, nullptr };
+            const uint8_t* nearest = nullptr;
+            const Keyframe* keys[2] = { &a, &b };
+            for (int k = 0; k < 2; ++k)
+            {
+                const Camera& kc = keys[k]->camera;
+                uint32_t kx, ky;
+                if (!kc.project(hit, kx, ky)) continue;
+                if (!nearest) nearest = &keys[k]->rgba[(size_t(ky) * kc.width + kx) * 4];
+                for (int n = 0; n < 9 && !from[k]; ++n)
+                {
+                    static const int dx[9] = { 0, -1, 1, 0, 0, -1, 1, -1, 1 };
+                    static const int dy[9] = { 0, 0, 0, -1, 1, -1, -1, 1, 1 };
+                    int64_t x = int64_t(kx) + dx[n], y = int64_t(ky) + dy[n];
+                    if (x < 0 || y < 0 || x >= kc.width || y >= kc.height) continue;
+                    size_t j = size_t(y) * kc.width + size_t(x);
+                    if (keys[k]->ids[j] == id) from[k] = &keys[k]->rgba[j * 4];
+                }
+            }
+            if (!from[0] && !from[1])
+            {
+                // Filled with whatever the keyframe shows there, the caller decides
+                // from the returned fraction whether that is good enough
+                ++missing;
+                if (nearest) std::copy(nearest, nearest + 4, out);
+                continue;
+            }
+            double wa = from[0] && from[1] ? 1.0 - t : (from[0] ? 1.0 : 0.0);
+            for (int c = 0; c < 4; ++c)
+                out[c] = uint8_t(std::lround((from[0] ? from[0][c] * wa : 0.0) + (from[1] ? from[1][c] * (1.0 - wa) : 0.0)));
+        }
+    return voxelPixels ? double(missing) / double(voxelPixels) : 0.0;
+}
+
+}} // namespace vox2bella::orbit
@@ -0,0 +1,254 @@
+// vox2bella_prefork.h - Process isolation for service modes without paying SDK startup per job
+//
+// A malformed .vox file that crashes the converter would take a threaded batch down
+// with it, and starting a fresh vox2bella per file pays the SDK start-up and scene
+// definition loading every time. The prefork pool sits in between:
+//
+// - The parent sets everything up once (SDK, a scene with its definitions loaded),
+//   then forks 'size' workers. They inherit that state copy-on-write, so a worker is
+//   ready as soon as fork() returns.
+// - Each worker waits on its pipe for one job line "<input>\t<output>\n", converts,
+//   writes "ok <voxels>\n" or "failed\n" back and exits. Using every worker once
+//   means no job sees what an earlier one left behind in the scene or the heap.
+// - The parent reaps the worker and forks a replacement straight away, so the next
+//   job finds a worker waiting. A worker that dies without answering fails its job
+//   with the signal that killed it, and only that job.
+//
+// The parent stays single threaded and never converts, which keeps fork() safe.
+// POSIX only; on Windows start() reports that the mode is unavailable.
+
+#pragma once
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <poll.h>       // For poll
+#include <sys/wait.h>   // For waitpid
+#include <unistd.h>     // For fork, pipe, read, write
+#endif
+
+namespace vox2bella { namespace prefork {
+
+struct Task
+{
+    uint64_t id = 0;
+    std::string input;
+    std::string output;
+};
+
+class Pool
+{
+public:
+    // Runs in the worker process: converts one file, sets 'voxels', returns true on success
+    using WorkFn = std::function<bool(const std::string& input, const std::string& output, size_t& voxels)>;
+    // Called in the parent for every finished task; 'crash' describes a worker that died
+    using DoneFn = std::function<void(const Task& task, bool ok, size_t voxels, const std::string& crash)>;
+    // Called in the parent when the input fd is readable, returns false at end of input
+    using InputFn = std::function<bool()>;
+
+    Pool(unsigned size, WorkFn work) : m_size(size ? size : 1), m_work(std::move(work)) {}
+    ~Pool() { stop(); }
+
+    // Forks the first workers
+    bool start(std::string& error)
+    {
+#if defined(_WIN32)
+        error = "prefork workers need fork(), which Windows doesn't have";
+        return false;
+#else
+        std::signal(SIGPIPE, SIG_IGN); // a dead worker's pipe must not kill the parent
+        for (unsigned i = 0; i < m_size; ++i)
+            if (!spawn(error)) return false;
+        return true;
+#endif
+    }
+
+    // Queued tasks are handed out in order, urgent ones before all others
+    void submit(const Task& task, bool urgent = false)
+    {
+        if (urgent) m_pending.insert(m_pending.begin() + m_urgent++, task);
+        else m_pending.push_back(task);
+    }
+
+    // Dispatch loop. Polls 'inputFd' (-1 for none) and calls onInput when it is readable.
+    // Returns once the input has ended and every task has finished.
+    void run(int inputFd, InputFn onInput, DoneFn done)
+    {
+#if !defined(_WIN32)
+        bool inputOpen = inputFd >= 0;
+        for (;;)
+        {
+            dispatch();
+            if (m_workers.empty()) {
+                std::cerr << "Error: no prefork workers left" << std::endl;
+                break;
+            }
+            bool busy = !m_pending.empty();
+            for (const Worker& w : m_workers) busy |= w.busy;
+            if (!busy && !inputOpen) break;
+
+            std::vector<pollfd> fds;
+            for (const Worker& w : m_workers)
+                if (w.busy) fds.push_back({ w.fromChild, POLLIN, 0 });
+            if (inputOpen) fds.push_back({ inputFd, POLLIN, 0 });
+            if (poll(fds.data(), nfds_t(fds.size()), -1) < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "Error: poll failed: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            for (const pollfd& p : fds)
+            {
+                if (!(p.revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                if (p.fd == inputFd) { if (!onInput()) inputOpen = false; continue; }
+                for (size_t i = 0; i < m_workers.size(); ++i)
+                    if (m_workers[i].fromChild == p.fd) { collect(i, done); break; }
+            }
+        }
+#endif
+    }
+
+    // Closes the idle workers' pipes, they exit when they read end of file
+    void stop()
+    {
+#if !defined(_WIN32)
+        for (Worker& w : m_workers)
+        {
+            ::close(w.toChild);
+            ::close(w.fromChild);
+            waitpid(w.pid, nullptr, 0);
+        }
+#endif
+        m_workers.clear();
+    }
+
+private:
+    struct Worker
+    {
+        int pid = -1;
+        int toChild = -1;
+        int fromChild = -1;
+        bool busy = false;
+        Task task;
+    };
+
+#if !defined(_WIN32)
+    bool spawn(std::string& error)
+    {
+        int jobPipe[2], resultPipe[2];
+        if (pipe(jobPipe) != 0) { error = std::string("pipe failed: ") + std::strerror(errno); return false; }
+        if (pipe(resultPipe) != 0) {
+            ::close(jobPipe[0]); ::close(jobPipe[1]);
+            error = std::string("pipe failed: ") + std::strerror(errno);
+            return false;
+        }
+        // Otherwise the child would print the parent's buffered output again
+        std::cout.flush();
+        std::fflush(nullptr);
+        pid_t pid = fork();
+        if (pid < 0) {
+            error = std::string("fork failed: ") + std::strerror(errno);
+            return false;
+        }
+        if (pid == 0)
+        {
+            // Only this worker's own pipe ends stay open
+            for (const Worker& w : m_workers) { ::close(w.toChild); ::close(w.fromChild); }
+            ::close(jobPipe[1]);
+            ::close(resultPipe[0]);
+            workerMain(jobPipe[0], resultPipe[1]);
+        }
+        ::close(jobPipe[0]);
+        ::close(resultPipe[1]);
+        Worker w;
+        w.pid = pid;
+        w.toChild = jobPipe[1];
+        w.fromChild = resultPipe[0];
+        m_workers.push_back(w);
+        return true;
+    }
+
+    [[noreturn]] void workerMain(int jobFd, int resultFd)
+    {
+        std::string line;
+        char c;
+        while (::read(jobFd, &c, 1) == 1 && c != '\n') line += c;
+        size_t tab = line.find('\t');
+        if (tab != std::string::npos)
+        {
+            size_t voxels = 0;
+            bool ok = m_work(line.substr(0, tab), line.substr(tab + 1), voxels);
+            std::string result = ok ? "ok " + std::to_string(voxels) + "\n" : std::string("failed\n");
+            std::cout.flush();
+            std::cerr.flush();
+            std::fflush(nullptr);
+            ssize_t written = ::write(resultFd, result.data(), result.size());
+            (void)written;
+        }
+        // Skip the SDK's static destructors, the parent still owns that state
+        _exit(0);
+    }
+
+    // Hands pending tasks to idle workers
+    void dispatch()
+    {
+        for (Worker& w : m_workers)
+        {
+            if (w.busy || m_pending.empty()) continue;
+            w.task = m_pending.front();
+            m_pending.pop_front();
+            if (m_urgent) --m_urgent;
+            std::string line = w.task.input + "\t" + w.task.output + "\n";
+            w.busy = true;
+            // A failed write shows up as a worker that exits without a result
+            ssize_t written = ::write(w.toChild, line.data(), line.size());
+            (void)written;
+        }
+    }
+
+    // Reads a busy worker's answer (or notices it died), then replaces the worker
+    void collect(size_t index, const DoneFn& done)
+    {
+        Worker w = m_workers[index];
+        std::string result;
+        char buffer[64];
+        ssize_t n;
+        while ((n = ::read(w.fromChild, buffer, sizeof(buffer))) > 0) result.append(buffer, size_t(n));
+        ::close(w.toChild);
+        ::close(w.fromChild);
+        int status = 0;
+        waitpid(w.pid, &status, 0);
+        m_workers.erase(m_workers.begin() + index);
+
+        std::string crash;
+        if (WIFSIGNALED(status))
+            crash = std::string("worker killed by signal ") + std::to_string(WTERMSIG(status)) + " (" + strsignal(WTERMSIG(status)) + ")";
+        else if (result.empty())
+            crash = "worker exited without a result";
+        bool ok = crash.empty() && result.compare(0, 3, "ok ") == 0;
+        size_t voxels = ok ? size_t(std::strtoull(result.c_str() + 3, nullptr, 10)) : 0;
+        done(w.task, ok, voxels, crash);
+
+        std::string error;
+        if (!spawn(error))
+            std::cerr << "Error: cannot replace worker: " << error << std::endl;
+    }
+#endif
+
+    unsigned m_size;
+    WorkFn m_work;
+    std::vector<Worker> m_workers;
+    std::deque<Task> m_pending;
+    size_t m_urgent = 0;    // urgent tasks at the front of m_pending
+};
+
+}} // namespace vox2bella::prefork
@@ -0,0 +1,310 @@
+// vox2bella_queue.h - Job queue in a shared directory, for spreading batches over nodes
+//
+// Render nodes that share a filesystem (NFS, SMB) but have no scheduler coordinate
+// through one directory:
+//
+//   <queue>/pending/<cost>-<stem>-<hash>.job   waiting, the file holds "<input>\n<output>\n"
+//   <queue>/claimed/<name>@<owner>             leased by a worker, <owner> is host.pid
+//   <queue>/recovering/<name>@<owner>@<by>     stale lease being checked by worker <by>
+//   <queue>/done/<name>, failed/<name>         finished jobs
+//   <queue>/clock/<owner>                      touched to read the file server's time
+//   <queue>/tmp/                               jobs being added
+//
+// Every state change is a rename, which the file server performs atomically: when
+// two workers claim the same job, exactly one rename succeeds. The lease file's
+// modification time is the heartbeat and is renewed while the job runs. A lease
+// that hasn't been renewed for a whole lease period belongs to a worker that died or
+// lost its mount, and any worker moves it back to pending/. Lease times are compared
+// with a file the worker touches itself, so the hosts' clocks don't need to agree.
+//
+// Checking a lease's time and renaming it are two steps, and the owner can renew it
+// in between. A stale lease is therefore first renamed to recovering/, where its owner
+// can no longer renew it, and its time is checked again there: if it was renewed it
+// goes back to claimed/, otherwise on to pending/. An owner whose renewal fails while
+// its lease sits in recovering/ keeps the job until the check is done.
+//
+// Pending names start with the job's estimated cost, zero-padded, so walking the
+// directory in reverse name order hands out the biggest jobs first on every node.
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>     // For gethostname, getpid
+#include <utime.h>      // For utime
+#else
+#include <process.h>    // For _getpid
+#endif
+
+namespace vox2bella { namespace queue {
+
+// "<host>.<pid>", with anything but letters, digits and '-' in the host name replaced
+inline std::string ownerId()
+{
+    char host[256] = {};
+    long pid;
+#if !defined(_WIN32)
+    if (gethostname(host, sizeof(host) - 1) != 0) host[0] = 0;
+    pid = long(getpid());
+#else
+    if (const char* name = std::getenv("COMPUTERNAME")) std::snprintf(host, sizeof(host), "%s", name);
+    pid = long(_getpid());
+#endif
+    std::string id;
+    for (const char* c = host; *c; ++c)
+        id += (std::isalnum(static_cast<unsigned char>(*c)) || *c == '-') ? *c : '_';
+    if (id.empty()) id = "host";
+    return id + "." + std::to_string(pid);
+}
+
+// Sets a file's modification time to now. On POSIX a null time asks the file server
+// for its own clock, which keeps leases comparable across hosts.
+inline bool touch(const std::string& path)
+{
+#if !defined(_WIN32)
+    return utime(path.c_str(), nullptr) == 0;
+#else
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    return !ec;
+#endif
+}
+
+// A job this worker holds the lease for
+struct Claim
+{
+    std::string name;     // file name in pending/
+    std::string lease;    // path of the lease file in claimed/
+    std::string input;
+    std::string output;
+    uint64_t cost = 0;
+};
+
+class SharedQueue
+{
+public:
+    // Creates the directory layout if needed
+    bool open(const std::string& dir, double leaseSeconds, std::string& error)
+    {
+        namespace fs = std::filesystem;
+        m_dir = dir;
+        m_leaseSeconds = leaseSeconds;
+        m_owner = ownerId();
+        for (const char* sub : { "pending", "claimed", "recovering", "done", "failed", "clock", "tmp" })
+        {
+            std::error_code ec;
+            fs::create_directories(fs::path(dir) / sub, ec);
+            if (ec) {
+                error = "cannot create " + (fs::path(dir) / sub).string() + ": " + ec.message();
+                return false;
+            }
+        }
+        m_clock = (fs::path(dir) / "clock" / m_owner).string();
+        std::ofstream clock(m_clock);
+        if (!(clock << m_owner << "\n")) {
+            error = "cannot write " + m_clock;
+            return false;
+        }
+        return true;
+    }
+
+    // Adds a job. It is written under tmp/ and renamed into pending/, so workers
+    // never read a half-written job file.
+    bool add(const std::string& input, const std::string& output, uint64_t cost, std::string& error)
+    {
+        namespace fs = std::filesystem;
+        // Same stem in different directories must not collide
+        uint32_t hash = 2166136261u;
+        for (char c : input) hash = (hash ^ uint8_t(c)) * 16777619u;
+        char prefix[32];
+        std::snprintf(prefix, sizeof(prefix), "%012llu-", static_cast<unsigned long long>(std::min<uint64_t>(cost, 999999999999ull)));
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), "-%08x.job", hash);
+        std::string name = prefix + fs::path(input).stem().string() + suffix;
+
+        fs::path tmp = fs::path(m_dir) / "tmp" / (name + "@" + m_owner);
+        {
+            std::ofstream file(tmp);
+            if (!(file << input << "\n" << output << "\n")) {
+                error = "cannot write " + tmp.string();
+                return false;
+            }
+        }
+        std::error_code ec;
+        fs::rename(tmp, fs::path(m_dir) / "pending" / name, ec);
+        if (ec) {
+            error = "cannot queue " + name + ": " + ec.message();
+            return false;
+        }
+        return true;
+    }
+
+    // Takes the lease on the biggest pending job, returns false if there is none
+    bool claim(Claim& out)
+    {
+        namespace fs = std::filesystem;
+        std::vector<std::string> names = list("pending");
+        std::sort(names.rbegin(), names.rend());
+        for (const std::string& name : names)
+        {
+            fs::path pending = fs::path(m_dir) / "pending" / name;
+            fs::path lease = fs::path(m_dir) / "claimed" / (name + "@" + m_owner);
+            // Touched first: the rename keeps the time, and an old time would look stale
+            if (!touch(pending.string())) continue;
+            std::error_code ec;
+            fs::rename(pending, lease, ec);
+            if (ec) continue; // another worker was faster
+
+            Claim claim;
+            claim.name = name;
+            claim.lease = lease.string();
+            claim.cost = std::strtoull(name.c_str(), nullptr, 10);
+            std::ifstream file(lease);
+            if (!std::getline(file, claim.input) || !std::getline(file, claim.output) || claim.input.empty()) {
+                std::cerr << "Error: bad job file " << name << std::endl;
+                fs::rename(lease, fs::path(m_dir) / "failed" / name, ec);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_held.push_back(claim.lease);
+            out = claim;
+            return true;
+        }
+        return false;
+    }
+
+    // Renews the leases of all jobs this worker holds
+    // A lease that can't be renewed was recovered by another worker and is dropped,
+    // unless that worker is still checking it (see recoverStale()). Returns the leases
+    // that were lost.
+    std::vector<std::string> heartbeat()
+    {
+        std::vector<std::string> recovering = list("recovering");
+        std::vector<std::string> lost;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_held.size();)
+        {
+            if (touch(m_held[i])) { ++i; continue; }
+            const std::string prefix = std::filesystem::path(m_held[i]).filename().string() + "@";
+            if (std::any_of(recovering.begin(), recovering.end(),
+                            [&](const std::string& name) { return name.compare(0, prefix.size(), prefix) == 0; })) { ++i; continue; }
+            lost.push_back(m_held[i]);
+            m_held.erase(m_held.begin() + i);
+        }
+        return lost;
+    }
+
+    bool held(const Claim& claim)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return std::find(m_held.begin(), m_held.end(), claim.lease) != m_held.end();
+    }
+
+    // Moves a finished job to done/ or failed/, returns false if the lease was lost
+    bool finish(const Claim& claim, bool ok)
+    {
+        namespace fs = std::filesystem;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_held.erase(std::remove(m_held.begin(), m_held.end(), claim.lease), m_held.end());
+        }
+        std::error_code ec;
+        fs::rename(claim.lease, fs::path(m_dir) / (ok ? "done" : "failed") / claim.name, ec);
+        return !ec;
+    }
+
+    // Moves leases that weren't renewed within the lease period back to pending/
+    // Returns "<name> from <owner>" for every job that was recovered
+    std::vector<std::string> recoverStale()
+    {
+        namespace fs = std::filesystem;
+        std::vector<std::string> recovered;
+        std::error_code ec;
+        if (!touch(m_clock)) return recovered;
+        fs::file_time_type now = fs::last_write_time(m_clock, ec);
+        if (ec) return recovered;
+        auto stale = [&](const fs::path& path) {
+            fs::file_time_type renewed = fs::last_write_time(path, ec);
+            return !ec && std::chrono::duration<double>(now - renewed).count() >= m_leaseSeconds;
+        };
+
+        for (const std::string& leaseName : list("claimed"))
+        {
+            fs::path lease = fs::path(m_dir) / "claimed" / leaseName;
+            if (!stale(lease)) continue;
+            // Out of the owner's reach first, the rename keeps the time of its last renewal
+            fs::path checking = fs::path(m_dir) / "recovering" / (leaseName + "@" + m_owner);
+            fs::rename(lease, checking, ec);
+            if (ec) continue; // recovered by another worker meanwhile
+            if (!stale(checking)) {
+                fs::rename(checking, lease, ec); // renewed just before the rename
+                continue;
+            }
+            if (toPending(checking, leaseName)) recovered.push_back(describe(leaseName));
+        }
+
+        // Left behind by a worker that died while checking a lease
+        for (const std::string& checkName : list("recovering"))
+        {
+            fs::path checking = fs::path(m_dir) / "recovering" / checkName;
+            const std::string leaseName = checkName.substr(0, checkName.rfind('@'));
+            if (stale(checking) && toPending(checking, leaseName)) recovered.push_back(describe(leaseName));
+        }
+        return recovered;
+    }
+
+    // Nothing pending and nothing leased by any worker
+    bool drained()
+    {
+        return list("pending").empty() && list("claimed").empty() && list("recovering").empty();
+    }
+
+    const std::string& owner() const { return m_owner; }
+    double leaseSeconds() const { return m_leaseSeconds; }
+
+private:
+    // Moves a checked lease to pending/ under its job's name
+    bool toPending(const std::filesystem::path& checking, const std::string& leaseName)
+    {
+        std::error_code ec;
+        std::filesystem::rename(checking, std::filesystem::path(m_dir) / "pending" / leaseName.substr(0, leaseName.rfind('@')), ec);
+        return !ec;
+    }
+
+    static std::string describe(const std::string& leaseName)
+    {
+        const size_t at = leaseName.rfind('@');
+        return leaseName.substr(0, at) + " from " + leaseName.substr(at + 1);
+    }
+
+    std::vector<std::string> list(const char* sub) const
+    {
+        std::vector<std::string> names;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(m_dir) / sub, ec))
+            names.push_back(entry.path().filename().string());
+        return names;
+    }
+
+    std::string m_dir;
+    std::string m_owner;
+    std::string m_clock;
+    double m_leaseSeconds = 60;
+    std::mutex m_mutex;
+    std::vector<std::string> m_held;   // lease paths of running jobs
+};
+
+}} // namespace vox2bella::queue
@@ -0,0 +1,590 @@
+// vox2bella_record.h - Recording and replay of the scene calls a conversion makes
+//
+// Parsing and the Bella API calls are interleaved during a conversion, so timing one
+// can't tell which of the two a change sped up. With a SceneLog in
+// ConvertOptions::record, the converter appends every node it creates or deletes,
+// every parent link and every input it sets to a compact binary log. replay() runs a log against
+// a fresh scene and times each kind of call, so scene-building strategies can be
+// compared on real workloads without parsing anything.
+//
+// Log layout, integers are LEB128 varints and floating point values little-endian:
+//
+//   "V2BLOG1\n"
+//   OpString  len, bytes                      next entry of the string table (types, input paths)
+//   OpCreate  type, name len, name bytes      creates the next node id
+//   OpParent  child, parent
+//   OpSet     node, path, value kind, value
+//   OpWrite   len, bytes                      writes the scene to that path
+//   OpDelete  node                            deletes a created node, its id isn't reused
+//
+// Node ids below NumRoots stand for nodes every scene already has, created nodes
+// are numbered from NumRoots on. Input paths are '/'-separated and numeric parts
+// are array indices, "steps/0/xform" is node["steps"][0]["xform"].
+//
+// The converter doesn't write to the log directly: its scene calls go through a
+// RecordingScene, which performs each call and records it in the same step, so the
+// log holds exactly what was done to the scene.
+//
+// SceneLog doesn't depend on the Bella SDK. RecordingScene and replay() do, and like
+// vox2bella_convert.h expect the SDK headers to be included first.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vox2bella { namespace record {
+
+enum Op : uint8_t { OpString = 1, OpCreate, OpParent, OpSet, OpWrite, OpDelete };
+
+enum ValueKind : uint8_t
+{
+    ValueInt, ValueReal, ValueBool, ValueString, ValueVec2, ValueRgba, ValueMat4, ValueNode,
+    ValuePoints,    // count, then x y z floats per point
+    ValuePolygons,  // count, then 4 varint indices per quad
+    NumValueKinds
+};
+
+// Nodes of the scene the log is replayed into
+enum Root : uint32_t { RootWorld, RootBeautyPass, RootCamera, RootCameraXform, NumRoots };
+
+const uint32_t NoNode = UINT32_MAX;
+static const char logMagic[8] = { 'V', '2', 'B', 'L', 'O', 'G', '1', '\n' };
+
+class SceneLog
+{
+public:
+    SceneLog() { m_bytes.assign(logMagic, logMagic + sizeof(logMagic)); }
+
+    // Records a new node, returns its id
+    uint32_t create(const char* type, const char* name)
+    {
+        uint32_t typeId = string(type);
+        m_bytes.push_back(OpCreate);
+        varint(typeId);
+        bytes(name, std::strlen(name));
+        uint32_t id = m_nextNode++;
+        m_nodes[name] = id;
+        ++m_ops;
+        return id;
+    }
+
+    // Id of a node created earlier, by name, or NoNode
+    uint32_t node(const char* name) const
+    {
+        auto found = m_nodes.find(name);
+        return found == m_nodes.end() ? NoNode : found->second;
+    }
+
+    // Records that a created node was deleted, 'name' no longer finds it
+    void remove(uint32_t node, const char* name)
+    {
+        if (node == NoNode || node < NumRoots) return;
+        m_bytes.push_back(OpDelete);
+        varint(node);
+        auto found = m_nodes.find(name);
+        if (found != m_nodes.end() && found->second == node) m_nodes.erase(found);
+        ++m_ops;
+    }
+
+    void parent(uint32_t child, uint32_t parent)
+    {
+        if (child == NoNode || parent == NoNode) return;
+        m_bytes.push_back(OpParent);
+        varint(child);
+        varint(parent);
+        ++m_ops;
+    }
+
+    void setInt(uint32_t node, const char* path, int64_t v)   { if (set(node, path, ValueInt)) varint((uint64_t(v) << 1) ^ uint64_t(v >> 63)); }
+    void setReal(uint32_t node, const char* path, double v)   { if (set(node, path, ValueReal)) doubles(&v, 1); }
+    void setBool(uint32_t node, const char* path, bool v)     { if (set(node, path, ValueBool)) m_bytes.push_back(v ? 1 : 0); }
+    void setString(uint32_t node, const char* path, const char* v) { if (set(node, path, ValueString)) bytes(v, std::strlen(v)); }
+    void setVec2(uint32_t node, const char* path, const double (&v)[2]) { if (set(node, path, ValueVec2)) doubles(v, 2); }
+    void setRgba(uint32_t node, const char* path, const double (&v)[4]) { if (set(node, path, ValueRgba)) doubles(v, 4); }
+    void setMat4(uint32_t node, const char* path, const double* m) { if (set(node, path, ValueMat4)) doubles(m, 16); }
+    void setNode(uint32_t node, const char* path, uint32_t target)
+    {
+        if (target != NoNode && set(node, path, ValueNode)) varint(target);
+    }
+    // 'xyz' holds 3 floats per point
+    void setPoints(uint32_t node, const char* path, const float* xyz, size_t count)
+    {
+        if (!set(node, path, ValuePoints)) return;
+        varint(count);
+        for (size_t i = 0; i < count * 3; ++i) putLE(xyz[i]);
+    }
+    // 'indices' holds 4 point indices per quad
+    void setPolygons(uint32_t node, const char* path, const uint32_t* indices, size_t count)
+    {
+        if (!set(node, path, ValuePolygons)) return;
+        varint(count);
+        for (size_t i = 0; i < count * 4; ++i) varint(indices[i]);
+    }
+
+    void write(const std::string& path)
+    {
+        m_bytes.push_back(OpWrite);
+        bytes(path.data(), path.size());
+        ++m_ops;
+    }
+
+    size_t ops() const { return m_ops; }
+    size_t size() const { return m_bytes.size(); }
+    const std::vector<uint8_t>& data() const { return m_bytes; }
+
+    bool save(const std::string& path, std::string& error) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.write(reinterpret_cast<const char*>(m_bytes.data()), std::streamsize(m_bytes.size()))) {
+            error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    uint32_t string(const char* s)
+    {
+        auto found = m_strings.find(s);
+        if (found != m_strings.end()) return found->second;
+        uint32_t id = uint32_t(m_strings.size());
+        m_strings.emplace(s, id);
+        m_bytes.push_back(OpString);
+        bytes(s, std::strlen(s));
+        return id;
+    }
+
+    bool set(uint32_t node, const char* path, ValueKind kind)
+    {
+        if (node == NoNode) return false;
+        uint32_t pathId = string(path);
+        m_bytes.push_back(OpSet);
+        varint(node);
+        varint(pathId);
+        m_bytes.push_back(kind);
+        ++m_ops;
+        return true;
+    }
+
+    void varint(uint64_t v)
+    {
+        while (v >= 0x80) { m_bytes.push_back(uint8_t(v) | 0x80); v >>= 7; }
+        m_bytes.push_back(uint8_t(v));
+    }
+
+    void bytes(const char* s, size_t n)
+    {
+        varint(n);
+        m_bytes.insert(m_bytes.end(), s, s + n);
+    }
+
+    template <class T> void putLE(T v)
+    {
+        uint8_t raw[sizeof(T)];
+        std::memcpy(raw, &v, sizeof(T));
+        // The log is little-endian, as are all the platforms vox2bella builds on
+        m_bytes.insert(m_bytes.end(), raw, raw + sizeof(T));
+    }
+
+    void doubles(const double* v, size_t n) { for (size_t i = 0; i < n; ++i) putLE(v[i]); }
+
+    std::vector<uint8_t> m_bytes;
+    std::unordered_map<std::string, uint32_t> m_strings;
+    std::unordered_map<std::string, uint32_t> m_nodes;
+    uint32_t m_nextNode = NumRoots;
+    size_t m_ops = 0;
+};
+
+// One part of an input path, a name or an array index (-1 for names)
+struct PathPart
+{
+    std::string name;
+    int index;
+};
+
+inline std::vector<PathPart> splitPath(const std::string& path)
+{
+    std::vector<PathPart> parts;
+    for (size_t from = 0; from <= path.size();)
+    {
+        size_t to = path.find('/', from);
+        if (to == std::string::npos) to = path.size();
+        std::string name = path.substr(from, to - from);
+        bool number = !name.empty() && name.find_first_not_of("0123456789") == std::string::npos;
+        parts.push_back({ name, number ? std::atoi(name.c_str()) : -1 });
+        from = to + 1;
+    }
+    return parts;
+}
+
+// The input of 'node' at a split path, the first part must be a name
+inline dl::bella_sdk::Input pathInput(const dl::bella_sdk::Node& node, const std::vector<PathPart>& parts)
+{
+    dl::bella_sdk::Input input = node[parts[0].name.c_str()];
+    for (size_t i = 1; i < parts.size(); ++i)
+        input = parts[i].index >= 0 ? input[parts[i].index] : input[parts[i].name.c_str()];
+    return input;
+}
+
+// A scene node and its id in the log, NoNode when nothing is recorded
+struct RecordedNode
+{
+    dl::bella_sdk::Node node;
+    uint32_t id = NoNode;
+};
+
+// Performs scene calls and appends them to a log, which may be nullptr
+class RecordingScene
+{
+public:
+    RecordingScene(dl::bella_sdk::Scene scene, SceneLog* log) : m_scene(scene), m_log(log) {}
+
+    dl::bella_sdk::Scene scene() const { return m_scene; }
+
+    RecordedNode root(Root root) const
+    {
+        switch (root)
+        {
+            case RootWorld:       return { m_scene.world(), RootWorld };
+            case RootBeautyPass:  return { m_scene.beautyPass(), RootBeautyPass };
+            case RootCamera:      return { m_scene.camera(), RootCamera };
+            default:              return { m_scene.cameraPath().parent().leaf(), RootCameraXform };
+        }
+    }
+
+    // A node created through a RecordingScene earlier, found in the log by name
+    RecordedNode existing(const dl::bella_sdk::Node& node) const
+    {
+        return { node, m_log ? m_log->node(node.name().buf()) : NoNode };
+    }
+
+    RecordedNode create(const char* type, const dl::String& name)
+    {
+        RecordedNode created{ m_scene.createNode(type, name, name) };
+        if (m_log) created.id = m_log->create(type, name.buf());
+        return created;
+    }
+
+    void remove(const RecordedNode& n)
+    {
+        if (m_log) m_log->remove(n.id, n.node.name().buf());
+        m_scene.deleteNode(n.node);
+    }
+
+    void parent(const RecordedNode& child, const RecordedNode& parent)
+    {
+        child.node.parentTo(parent.node);
+        if (m_log) m_log->parent(child.id, parent.id);
+    }
+
+    void setInt(const RecordedNode& n, const char* path, int64_t v)
+    {
+        input(n, path) = dl::Int(v);
+        if (m_log) m_log->setInt(n.id, path, v);
+    }
+    void setReal(const RecordedNode& n, const char* path, double v)
+    {
+        input(n, path) = v;
+        if (m_log) m_log->setReal(n.id, path, v);
+    }
+    void setBool(const RecordedNode& n, const char* path, bool v)
+    {
+        input(n, path) = v;
+        if (m_log) m_log->setBool(n.id, path, v);
+    }
+    void setVec2(const RecordedNode& n, const char* path, const dl::Vec2& v)
+    {
+        input(n, path) = v;
+        const double values[2] = { v.x, v.y };
+        if (m_log) m_log->setVec2(n.id, path, values);
+    }
+    void setRgba(const RecordedNode& n, const char* path, const dl::Rgba& v)
+    {
+        input(n, path) = v;
+        const double values[4] = { v.r, v.g, v.b, v.a };
+        if (m_log) m_log->setRgba(n.id, path, values);
+    }
+    void setMat4(const RecordedNode& n, const char* path, const dl::Mat4& m)
+    {
+        input(n, path) = m;
+        if (m_log) m_log->setMat4(n.id, path, m.m);
+    }
+    void setNode(const RecordedNode& n, const char* path, const RecordedNode& target)
+    {
+        input(n, path) = target.node;
+        if (m_log) m_log->setNode(n.id, path, target.id);
+    }
+    // 'xyz' holds 3 floats per point
+    void setPoints(const RecordedNode& n, const char* path, const float* xyz, size_t count)
+    {
+        dl::ds::Vector<dl::Pos3f> points;
+        points.reserve(count);
+        for (size_t i = 0; i < count; ++i) points.push_back(dl::Pos3f{ xyz[i * 3], xyz[i * 3 + 1], xyz[i * 3 + 2] });
+        input(n, path) = points;
+        if (m_log) m_log->setPoints(n.id, path, xyz, count);
+    }
+    // 'indices' holds 4 point indices per quad
+    void setPolygons(const RecordedNode& n, const char* path, const uint32_t* indices, size_t count)
+    {
+        dl::ds::Vector<dl::Vec4u> polygons;
+        polygons.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+            polygons.push_back(dl::Vec4u{ indices[i * 4], indices[i * 4 + 1], indices[i * 4 + 2], indices[i * 4 + 3] });
+        input(n, path) = polygons;
+        if (m_log) m_log->setPolygons(n.id, path, indices, count);
+    }
+
+private:
+    static dl::bella_sdk::Input input(const RecordedNode& n, const char* path) { return pathInput(n.node, splitPath(path)); }
+
+    dl::bella_sdk::Scene m_scene;
+    SceneLog* m_log;
+};
+
+// Reads a whole log file
+inline bool loadLog(const std::string& path, std::vector<uint8_t>& bytes, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) { error = "cannot open " + path; return false; }
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (bytes.size() < sizeof(logMagic) || std::memcmp(bytes.data(), logMagic, sizeof(logMagic)) != 0) {
+        error = path + " is not a vox2bella scene log";
+        return false;
+    }
+    return true;
+}
+
+// Time spent in each kind of call during a replay
+struct ReplayStats
+{
+    size_t creates = 0, parents = 0, deletes = 0, writes = 0;
+    size_t sets[NumValueKinds] = {};
+    double createSeconds = 0, parentSeconds = 0, deleteSeconds = 0, writeSeconds = 0;
+    double setSeconds[NumValueKinds] = {};
+    double decodeSeconds = 0;   // reading the log and building values, not spent in the SDK
+    double totalSeconds = 0;
+};
+
+inline const char* valueKindName(ValueKind kind)
+{
+    static const char* names[NumValueKinds] = { "int", "real", "bool", "string", "vec2", "rgba", "mat4", "node", "points", "polygons" };
+    return names[kind];
+}
+
+// Cursor over the bytes of a log, every read fails once the end is passed
+struct LogReader
+{
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (p >= end) { ok = false; return 0; }
+            uint8_t b = *p++;
+            v |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    std::string bytes()
+    {
+        uint64_t n = varint();
+        if (!ok || uint64_t(end - p) < n) { ok = false; return std::string(); }
+        std::string s(reinterpret_cast<const char*>(p), size_t(n));
+        p += n;
+        return s;
+    }
+
+    template <class T> T get()
+    {
+        T v{};
+        if (size_t(end - p) < sizeof(T)) { ok = false; return v; }
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+};
+
+// Runs the calls of a log against 'scene', which must have its definitions loaded.
+// Writes go to the recorded path, or to 'writePath' if it is not empty.
+inline bool replay(dl::bella_sdk::Scene scene, const std::vector<uint8_t>& log, const std::string& writePath,
+                   ReplayStats& stats, std::string& error)
+{
+    using Clock = std::chrono::steady_clock;
+    auto seconds = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double>(b - a).count(); };
+    const Clock::time_point start = Clock::now();
+
+    // Input paths split once
+    std::vector<std::vector<PathPart>> paths;
+    std::vector<std::string> strings;
+    std::vector<dl::bella_sdk::Node> nodes = {
+        scene.world(), scene.beautyPass(), scene.camera(), scene.cameraPath().parent().leaf()
+    };
+
+    LogReader in{ log.data() + sizeof(logMagic), log.data() + log.size() };
+    double sdkSeconds = 0;
+    auto node = [&](uint64_t id) -> const dl::bella_sdk::Node* {
+        if (id >= nodes.size()) { in.ok = false; return nullptr; }
+        return &nodes[size_t(id)];
+    };
+    while (in.ok && in.p < in.end)
+    {
+        const uint8_t op = *in.p++;
+        if (op == OpString)
+        {
+            std::string s = in.bytes();
+            strings.push_back(s);
+            paths.push_back(splitPath(s));
+        }
+        else if (op == OpCreate)
+        {
+            uint64_t type = in.varint();
+            std::string name = in.bytes();
+            if (!in.ok || type >= strings.size()) { in.ok = false; break; }
+            Clock::time_point t0 = Clock::now();
+            nodes.push_back(scene.createNode(strings[size_t(type)].c_str(), dl::String(name.c_str()), dl::String(name.c_str())));
+            double dt = seconds(t0, Clock::now());
+            stats.createSeconds += dt;
+            sdkSeconds += dt;
+            ++stats.creates;
+        }
+        else if (op == OpParent)
+        {
+            const dl::bella_sdk::Node* child = node(in.varint());
+            const dl::bella_sdk::Node* parent = node(in.varint());
+            if (!in.ok) break;
+            Clock::time_point t0 = Clock::now();
+            child->parentTo(*parent);
+            double dt = seconds(t0, Clock::now());
+            stats.parentSeconds += dt;
+            sdkSeconds += dt;
+            ++stats.parents;
+        }
+        else if (op == OpSet)
+        {
+            const dl::bella_sdk::Node* target = node(in.varint());
+            uint64_t path = in.varint();
+            uint8_t kind = in.get<uint8_t>();
+            if (!in.ok || path >= paths.size() || paths[size_t(path)].empty() || paths[size_t(path)][0].index >= 0 || kind >= NumValueKinds) {
+                in.ok = false;
+                break;
+            }
+
+            // Values are decoded before the clock starts
+            dl::Int intValue = 0;
+            double reals[16] = {};
+            bool boolValue = false;
+            std::string stringValue;
+            const dl::bella_sdk::Node* nodeValue = nullptr;
+            dl::ds::Vector<dl::Pos3f> points;
+            dl::ds::Vector<dl::Vec4u> polygons;
+            switch (ValueKind(kind))
+            {
+                case ValueInt:    { uint64_t z = in.varint(); intValue = dl::Int(int64_t(z >> 1) ^ -int64_t(z & 1)); break; }
+                case ValueReal:   reals[0] = in.get<double>(); break;
+                case ValueBool:   boolValue = in.get<uint8_t>() != 0; break;
+                case ValueString: stringValue = in.bytes(); break;
+                case ValueVec2:   for (int i = 0; i < 2; ++i) reals[i] = in.get<double>(); break;
+                case ValueRgba:   for (int i = 0; i < 4; ++i) reals[i] = in.get<double>(); break;
+                case ValueMat4:   for (int i = 0; i < 16; ++i) reals[i] = in.get<double>(); break;
+                case ValueNode:   nodeValue = node(in.varint()); break;
+                case ValuePoints:
+                {
+                    uint64_t count = in.varint();
+                    if (!in.ok || uint64_t(in.end - in.p) / 12 < count) { in.ok = false; break; }
+                    points.reserve(size_t(count));
+                    for (uint64_t i = 0; i < count; ++i) {
+                        float x = in.get<float>(), y = in.get<float>(), z = in.get<float>();
+                        points.push_back(dl::Pos3f{ x, y, z });
+                    }
+                    break;
+                }
+                case ValuePolygons:
+                {
+                    uint64_t count = in.varint();
+                    if (!in.ok || uint64_t(in.end - in.p) / 4 < count) { in.ok = false; break; }
+                    polygons.reserve(size_t(count));
+                    for (uint64_t i = 0; i < count; ++i) {
+                        unsigned a = unsigned(in.varint()), b = unsigned(in.varint()), c = unsigned(in.varint()), d = unsigned(in.varint());
+                        polygons.push_back(dl::Vec4u{ a, b, c, d });
+                    }
+                    break;
+                }
+                default: break;
+            }
+            if (!in.ok) break;
+
+            Clock::time_point t0 = Clock::now();
+            dl::bella_sdk::Input input = pathInput(*target, paths[size_t(path)]);
+            switch (ValueKind(kind))
+            {
+                case ValueInt:      input = intValue; break;
+                case ValueReal:     input = reals[0]; break;
+                case ValueBool:     input = boolValue; break;
+                case ValueString:   input = dl::String(stringValue.c_str()); break;
+                case ValueVec2:     input = dl::Vec2{ reals[0], reals[1] }; break;
+                case ValueRgba:     input = dl::Rgba{ reals[0], reals[1], reals[2], reals[3] }; break;
+                case ValueMat4:     { dl::Mat4 m; std::memcpy(m.m, reals, sizeof(reals)); input = m; break; }
+                case ValueNode:     input = *nodeValue; break;
+                case ValuePoints:   input = points; break;
+                case ValuePolygons: input = polygons; break;
+                default: break;
+            }
+            double dt = seconds(t0, Clock::now());
+            stats.setSeconds[kind] += dt;
+            sdkSeconds += dt;
+            ++stats.sets[kind];
+        }
+        else if (op == OpWrite)
+        {
+            std::string path = in.bytes();
+            if (!in.ok) break;
+            Clock::time_point t0 = Clock::now();
+            bool written = scene.write(dl::String((writePath.empty() ? path : writePath).c_str()));
+            double dt = seconds(t0, Clock::now());
+            stats.writeSeconds += dt;
+            sdkSeconds += dt;
+            ++stats.writes;
+            if (!written) {
+                error = "cannot write " + (writePath.empty() ? path : writePath);
+                return false;
+            }
+        }
+        else if (op == OpDelete)
+        {
+            uint64_t id = in.varint();
+            const dl::bella_sdk::Node* deleted = node(id);
+            if (!in.ok || id < NumRoots) { in.ok = false; break; }
+            Clock::time_point t0 = Clock::now();
+            scene.deleteNode(*deleted);
+            double dt = seconds(t0, Clock::now());
+            stats.deleteSeconds += dt;
+            sdkSeconds += dt;
+            ++stats.deletes;
+        }
+        else in.ok = false;
+    }
+    stats.totalSeconds = seconds(start, Clock::now());
+    stats.decodeSeconds = stats.totalSeconds - sdkSeconds;
+    if (!in.ok) {
+        error = "damaged scene log at byte " + std::to_string(in.p - log.data());
+        return false;
+    }
+    return true;
+}
+
+}} // namespace vox2bella::record
@@ -0,0 +1,180 @@
+// vox2bella_shm.h - Read voxel data straight out of a POSIX shared-memory segment
+//
+// A running editor can publish its voxels in a shared-memory segment instead of
+// saving a .vox file. vox2bella maps the segment read-only and converts directly
+// from the mapped bytes, so there is no file to write and no chunk parsing to do.
+//
+// Segment layout (version 1), all fields little-endian:
+//
+//   offset  size   field
+//   0       4      magic       "V2BS"
+//   4       4      version     1
+//   8       4      layout      0 = packed XYZI, 1 = dense grid
+//   12      4      flags       bit 0: palette below is valid (else the default palette is used)
+//   16      4      sizeX       model dimensions, 1..256 each (same limits as a .vox SIZE chunk)
+//   20      4      sizeY
+//   24      4      sizeZ
+//   28      4      numVoxels   packed layout: number of 4-byte XYZI records (ignored for dense)
+//   32      4      sequence    even = stable, odd = editor is writing (seqlock style)
+//   36      12     reserved    must be zero
+//   48      1024   palette     256 x uint32 0xAABBGGRR, indexed directly by color index (entry 0 unused)
+//   1072    ...    payload     packed: numVoxels x {x, y, z, colorIndex} bytes, exactly like an XYZI chunk
+//                              dense:  sizeX*sizeY*sizeZ color index bytes, x fastest then y then z, 0 = empty
+//
+// The editor bumps 'sequence' to an odd value before touching the segment and back
+// to an even value when done. We refuse to start on an odd sequence and warn if the
+// sequence moved while we were converting. The header is copied once and only the
+// copy is validated and used, so an editor writing meanwhile can change voxel bytes
+// but not the sizes or counts the payload reads are bounded by.
+
+#pragma once
+
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#if !defined(_WIN32)
+#include <fcntl.h>      // For shm_open flags
+#include <sys/mman.h>   // For shm_open, mmap, munmap
+#include <sys/stat.h>   // For fstat
+#include <unistd.h>     // For close
+#endif
+
+namespace vox2bella { namespace shm {
+
+enum Layout : uint32_t
+{
+    LayoutPackedXYZI = 0,
+    LayoutDenseGrid  = 1,
+};
+
+const uint32_t FlagHasPalette = 1u << 0;
+
+// Fixed-size header at the start of every segment, see layout table above
+struct SegmentHeader
+{
+    char     magic[4];       // "V2BS"
+    uint32_t version;        // 1
+    uint32_t layout;         // Layout enum
+    uint32_t flags;          // FlagHasPalette
+    uint32_t sizeX;
+    uint32_t sizeY;
+    uint32_t sizeZ;
+    uint32_t numVoxels;
+    uint32_t sequence;
+    uint32_t reserved[3];
+    uint32_t palette[256];
+};
+static_assert(sizeof(SegmentHeader) == 1072, "shared-memory header layout is part of the public contract");
+
+// Maps a segment read-only and validates it against the documented layout
+// The mapping stays alive until the object is destroyed, payload() points into it
+class SegmentReader
+{
+public:
+    SegmentReader() = default;
+    SegmentReader(const SegmentReader&) = delete;
+    SegmentReader& operator=(const SegmentReader&) = delete;
+    ~SegmentReader() { close(); }
+
+    // Returns false and fills 'error' if the segment is missing or malformed
+    bool open(const std::string& name, std::string& error)
+    {
+#if defined(_WIN32)
+        error = "shared-memory input is only supported on POSIX systems";
+        return false;
+#else
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+        {
+            error = "cannot open shared-memory segment " + name + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SegmentHeader)))
+        {
+            ::close(fd);
+            error = "shared-memory segment " + name + " is smaller than its header";
+            return false;
+        }
+        m_size = static_cast<size_t>(st.st_size);
+        void* base = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the segment alive
+        if (base == MAP_FAILED)
+        {
+            m_size = 0;
+            error = "cannot map shared-memory segment " + name + ": " + std::strerror(errno);
+            return false;
+        }
+        m_base = static_cast<const uint8_t*>(base);
+        return validate(error);
+#endif
+    }
+
+    void close()
+    {
+#if !defined(_WIN32)
+        if (m_base) munmap(const_cast<uint8_t*>(m_base), m_size);
+#endif
+        m_base = nullptr;
+        m_size = 0;
+    }
+
+    // The header as validated by open(), not the live segment
+    const SegmentHeader& header() const { return m_header; }
+    const uint8_t* payload() const { return m_base + sizeof(SegmentHeader); }
+
+    // True if the editor has not touched the segment since open() validated it
+    bool unchanged() const
+    {
+        return readSequence() == m_sequence;
+    }
+
+private:
+    uint32_t readSequence() const
+    {
+        return reinterpret_cast<const volatile SegmentHeader*>(m_base)->sequence;
+    }
+
+    bool validate(std::string& error)
+    {
+        std::memcpy(&m_header, m_base, sizeof(SegmentHeader));
+        const SegmentHeader& h = m_header;
+        m_sequence = h.sequence;
+        if (std::memcmp(h.magic, "V2BS", 4) != 0) { error = "bad magic, expected V2BS"; return false; }
+        if (h.version != 1) { error = "unsupported segment version " + std::to_string(h.version); return false; }
+        if (m_sequence & 1u) { error = "segment is being written by the editor (odd sequence)"; return false; }
+        if (h.sizeX < 1 || h.sizeX > 256 || h.sizeY < 1 || h.sizeY > 256 || h.sizeZ < 1 || h.sizeZ > 256)
+        {
+            error = "dimensions must be 1..256 on each axis";
+            return false;
+        }
+        if (h.reserved[0] || h.reserved[1] || h.reserved[2]) { error = "reserved header fields must be zero"; return false; }
+
+        // Make sure the payload the header promises actually fits inside the mapping
+        uint64_t payloadBytes = 0;
+        if (h.layout == LayoutPackedXYZI)
+            payloadBytes = uint64_t(h.numVoxels) * 4;
+        else if (h.layout == LayoutDenseGrid)
+            payloadBytes = uint64_t(h.sizeX) * h.sizeY * h.sizeZ;
+        else
+        {
+            error = "unknown layout " + std::to_string(h.layout);
+            return false;
+        }
+        if (sizeof(SegmentHeader) + payloadBytes > m_size)
+        {
+            error = "payload runs past the end of the segment";
+            return false;
+        }
+        return true;
+    }
+
+    const uint8_t* m_base = nullptr;
+    size_t m_size = 0;
+    SegmentHeader m_header = {};
+    uint32_t m_sequence = 0;
+};
+
+}} // namespace vox2bella::shm
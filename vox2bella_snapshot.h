@@ -0,0 +1,210 @@
+// vox2bella_snapshot.h - Progressive snapshots of a running render
+//
+// A long still render only produces its image at the end. The Snapshotter listens
+// to the engine's image updates, holds on to the latest one and notes when a
+// snapshot is due: after a number of seconds and/or after a number of progressive
+// updates (each update is one refinement pass of the image). The thread waiting for
+// the render then copies that image out and writes it as a PNG, replacing the
+// previous snapshot atomically, so a reviewer opening the file never sees a
+// half-written image. Updates in between cost no copy.
+//
+// PNGs are written with uncompressed deflate blocks. That keeps this header free of
+// image libraries, and writing is fast enough to do every few seconds.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vox2bella { namespace snapshot {
+
+inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    // Built once, thread-safe as a function-local static
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Encodes 8-bit RGBA pixels (top row first) as a PNG in memory
+inline void encodePng(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& png)
+{
+    auto put32 = [](std::vector<uint8_t>& out, uint32_t v) {
+        out.push_back(uint8_t(v >> 24)); out.push_back(uint8_t(v >> 16));
+        out.push_back(uint8_t(v >> 8));  out.push_back(uint8_t(v));
+    };
+    auto chunk = [&](const char* type, const std::vector<uint8_t>& body) {
+        put32(png, uint32_t(body.size()));
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), body.begin(), body.end());
+        put32(png, crc32(png.data() + start, png.size() - start));
+    };
+
+    png.assign({ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' });
+    std::vector<uint8_t> ihdr;
+    put32(ihdr, width);
+    put32(ihdr, height);
+    ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 }); // 8 bits, RGBA, deflate, no filter method, no interlace
+    chunk("IHDR", ihdr);
+
+    // zlib stream of stored blocks: every scanline starts with filter type 0
+    const size_t rowBytes = size_t(width) * 4 + 1;
+    const size_t rawBytes = rowBytes * height;
+    std::vector<uint8_t> idat;
+    idat.reserve(rawBytes + rawBytes / 65535 * 5 + 16);
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+    uint32_t a = 1, b = 0; // adler32
+    size_t blockLeft = 0, remaining = rawBytes;
+    auto emit = [&](uint8_t byte) {
+        if (blockLeft == 0) {
+            blockLeft = remaining < 65535 ? remaining : 65535;
+            remaining -= blockLeft;
+            idat.push_back(remaining == 0 ? 1 : 0);
+            idat.push_back(uint8_t(blockLeft)); idat.push_back(uint8_t(blockLeft >> 8));
+            idat.push_back(uint8_t(~blockLeft)); idat.push_back(uint8_t(~blockLeft >> 8));
+        }
+        idat.push_back(byte);
+        --blockLeft;
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    };
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        emit(0);
+        const uint8_t* row = rgba + size_t(y) * width * 4;
+        for (size_t i = 0; i < size_t(width) * 4; ++i) emit(row[i]);
+    }
+    put32(idat, (b << 16) | a);
+    chunk("IDAT", idat);
+    chunk("IEND", {});
+}
+
+// Writes the PNG next to 'path' and renames it into place
+inline bool writePng(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> png;
+    encodePng(rgba, width, height, png);
+    std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(png.data(), 1, png.size(), f) == png.size();
+    ok = (std::fclose(f) == 0) && ok;
+    // std::filesystem::rename replaces the target on Windows too, std::rename doesn't
+    std::error_code ec;
+    if (ok) std::filesystem::rename(tmp, path, ec);
+    return ok && !ec;
+}
+
+// Subscribe to the engine while rendering, call writePending() from the waiting thread
+class Snapshotter : public dl::bella_sdk::EngineObserver
+{
+public:
+    // intervalSeconds and everyUpdates of 0 disable that trigger
+    // An empty path never writes, the last image can still be read with latest()
+    Snapshotter(const std::string& path, double intervalSeconds, unsigned everyUpdates)
+        : m_path(path), m_interval(intervalSeconds), m_everyUpdates(everyUpdates) {}
+
+    // Starts counting for a new render and forgets the previous render's image
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_last = std::chrono::steady_clock::now();
+        m_updates = 0;
+        m_pending = false;
+        // A keyframe the engine sends no image for must not get the previous one's
+        m_image = dl::Image();
+        m_haveImage = false;
+    }
+
+    void onImage(dl::String /*pass*/, dl::Image image) override
+    {
+        if (!image.rgba8() || image.width() == 0 || image.height() == 0) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_updates;
+        auto now = std::chrono::steady_clock::now();
+        bool due = (m_interval > 0 && std::chrono::duration<double>(now - m_last).count() >= m_interval)
+                || (m_everyUpdates > 0 && m_updates % m_everyUpdates == 0);
+        // Only the image handle is kept, its pixels are copied once a snapshot is written.
+        // The latest one always replaces it, so the final snapshot matches the finished render.
+        m_image = image;
+        m_haveImage = true;
+        if (due) {
+            m_pending = true;
+            m_last = now;
+        }
+    }
+
+    // Writes the snapshot if one is due, or unconditionally with 'force' (end of render)
+    // Returns true if a file was written
+    bool writePending(bool force = false)
+    {
+        std::vector<uint8_t> pixels;
+        uint32_t width, height;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if ((!m_pending && !force) || !m_haveImage || m_path.empty()) return false;
+            m_pending = false;
+            copyImage(pixels, width, height);
+        }
+        if (!writePng(m_path, pixels.data(), width, height)) {
+            std::cerr << "Warning: could not write snapshot " << m_path << std::endl;
+            return false;
+        }
+        ++m_written;
+        return true;
+    }
+
+    // Copies the most recent image, returns false if the engine hasn't sent one
+    bool latest(std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_haveImage) return false;
+        copyImage(pixels, width, height);
+        return true;
+    }
+
+    unsigned written() const { return m_written; }
+    const std::string& path() const { return m_path; }
+
+private:
+    // Copies m_image as 8-bit RGBA, called with m_mutex held
+    void copyImage(std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height) const
+    {
+        static_assert(sizeof(dl::Rgba8) == 4, "snapshots copy 8-bit RGBA pixels");
+        const uint8_t* rgba = reinterpret_cast<const uint8_t*>(m_image.rgba8());
+        width = uint32_t(m_image.width());
+        height = uint32_t(m_image.height());
+        pixels.assign(rgba, rgba + size_t(width) * height * 4);
+    }
+
+    std::string m_path;
+    double m_interval;
+    unsigned m_everyUpdates;
+    std::mutex m_mutex;
+    std::chrono::steady_clock::time_point m_last = std::chrono::steady_clock::now();
+    unsigned m_updates = 0;
+    bool m_pending = false;
+    dl::Image m_image;              // latest update
+    bool m_haveImage = false;
+    unsigned m_written = 0;
+};
+
+}} // namespace vox2bella::snapshot
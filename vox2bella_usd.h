@@ -0,0 +1,271 @@
+// vox2bella_usd.h - Compact instanced USD export
+//
+// Writes a .vox scene as a text USD layer (.usda) that DCC tools load quickly:
+//
+//   /World                      Xform, Z up like MagicaVoxel, custom vox:palette
+//     /Placements               PointInstancer, one instance per model placement
+//       /Prototypes/model<i>    Mesh, each model exactly once, face-culled quads
+//
+// Each prototype mesh is centred the way MagicaVoxel centres a model on its
+// transform. Faces carry the palette index they came from (primvars:paletteIndex)
+// and its color (primvars:displayColor), both with uniform interpolation. The
+// instancer holds positions, orientations and scales from the scene graph; the
+// rotations MagicaVoxel allows can mirror, which USD expresses as a negative scale.
+// Hidden objects and layers become invisibleIds.
+//
+// The layer is plain text, so this needs neither the Bella SDK nor a USD runtime.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vox2bella_vox.h"
+
+namespace vox2bella { namespace usd {
+
+// Buffered writer for the USD text, flushed to the FILE in large blocks
+class TextOut
+{
+public:
+    explicit TextOut(FILE* f) : m_file(f) { m_buffer.reserve(1 << 20); }
+    ~TextOut() { flush(); }
+
+    TextOut& operator<<(const char* s) { m_buffer += s; return check(); }
+    TextOut& operator<<(const std::string& s) { m_buffer += s; return check(); }
+    TextOut& operator<<(int v) { char b[16]; std::snprintf(b, sizeof(b), "%d", v); m_buffer += b; return check(); }
+    TextOut& operator<<(uint32_t v) { char b[16]; std::snprintf(b, sizeof(b), "%u", v); m_buffer += b; return check(); }
+    TextOut& operator<<(float v) { char b[32]; std::snprintf(b, sizeof(b), "%g", v); m_buffer += b; return check(); }
+
+    bool flush()
+    {
+        if (!m_buffer.empty() && std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size()) m_ok = false;
+        m_buffer.clear();
+        return m_ok;
+    }
+
+private:
+    TextOut& check()
+    {
+        if (m_buffer.size() >= (1 << 20)) flush();
+        return *this;
+    }
+
+    FILE* m_file;
+    std::string m_buffer;
+    bool m_ok = true;
+};
+
+// Writes "[a, b, c]" with a line break every few items to keep lines readable
+template <class T, class Fn>
+inline void writeArray(TextOut& out, const std::vector<T>& items, Fn item)
+{
+    out << "[";
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (i) out << ((i % 16) ? ", " : ",\n            ");
+        item(items[i]);
+    }
+    out << "]";
+}
+
+// One model's face-culled mesh with shared corner points
+struct ModelMesh
+{
+    std::vector<float> points;          // x,y,z per unique corner
+    std::vector<int> faceVertexIndices; // 4 per face
+    std::vector<int> paletteIndex;      // 1 per face
+};
+
+// The model's records must lie inside its SIZE (see vox::ModelRef::recordsInside)
+inline void buildModelMesh(const vox::ModelRef& model, const uint8_t* data, ModelMesh& mesh)
+{
+    const uint8_t* records = data + model.xyziOffset;
+    const int sx = int(model.sizeX), sy = int(model.sizeY), sz = int(model.sizeZ);
+    vox::VoxelGrid grid;
+    vox::fillGrid(records, model.numVoxels, model.sizeX, model.sizeY, model.sizeZ, grid);
+
+    // Corners are shared between neighbouring faces, keyed by their packed grid position
+    std::unordered_map<uint32_t, int> cornerIndex;
+    const float pivot[3] = { float(sx / 2), float(sy / 2), float(sz / 2) };
+    for (uint32_t i = 0; i < model.numVoxels; ++i)
+    {
+        const uint8_t* v = records + size_t(i) * 4;
+        vox::exposedFaces(grid, v, [&](int d) {
+            for (int k = 0; k < 4; ++k)
+            {
+                uint32_t cx = v[0] + vox::faceCorners[d][k][0];
+                uint32_t cy = v[1] + vox::faceCorners[d][k][1];
+                uint32_t cz = v[2] + vox::faceCorners[d][k][2];
+                uint32_t key = cx | cy << 9 | cz << 18;
+                auto found = cornerIndex.find(key);
+                int index;
+                if (found == cornerIndex.end()) {
+                    index = int(mesh.points.size() / 3);
+                    cornerIndex.emplace(key, index);
+                    mesh.points.push_back(float(cx) - pivot[0]);
+                    mesh.points.push_back(float(cy) - pivot[1]);
+                    mesh.points.push_back(float(cz) - pivot[2]);
+                } else {
+                    index = found->second;
+                }
+                mesh.faceVertexIndices.push_back(index);
+            }
+            mesh.paletteIndex.push_back(v[3]);
+        });
+    }
+}
+
+// Quaternion (real, i, j, k) and scale for a signed permutation matrix
+// Mirroring matrices are split into a proper rotation and a scale of -1 on X
+inline void placementTransform(const int32_t (&m)[3][3], float (&q)[4], float (&scale)[3])
+{
+    int det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+            - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+            + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    float r[3][3];
+    scale[0] = det < 0 ? -1.0f : 1.0f;
+    scale[1] = scale[2] = 1.0f;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            r[i][j] = float(m[i][j]) * (j == 0 ? scale[0] : 1.0f);
+
+    float trace = r[0][0] + r[1][1] + r[2][2];
+    if (trace > 0) {
+        float s = std::sqrt(trace + 1.0f) * 2.0f;
+        q[0] = 0.25f * s;
+        q[1] = (r[2][1] - r[1][2]) / s;
+        q[2] = (r[0][2] - r[2][0]) / s;
+        q[3] = (r[1][0] - r[0][1]) / s;
+    } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        float s = std::sqrt(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+        q[0] = (r[2][1] - r[1][2]) / s;
+        q[1] = 0.25f * s;
+        q[2] = (r[0][1] + r[1][0]) / s;
+        q[3] = (r[0][2] + r[2][0]) / s;
+    } else if (r[1][1] > r[2][2]) {
+        float s = std::sqrt(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+        q[0] = (r[0][2] - r[2][0]) / s;
+        q[1] = (r[0][1] + r[1][0]) / s;
+        q[2] = 0.25f * s;
+        q[3] = (r[1][2] + r[2][1]) / s;
+    } else {
+        float s = std::sqrt(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+        q[0] = (r[1][0] - r[0][1]) / s;
+        q[1] = (r[0][2] + r[2][0]) / s;
+        q[2] = (r[1][2] + r[2][1]) / s;
+        q[3] = 0.25f * s;
+    }
+}
+
+// Writes the parsed scene to 'path', returns false with 'error' set on failure
+// 'data' is the buffer the parser read, 'sourceName' is noted in the layer's doc string
+// Voxels outside their model's SIZE fail the export before anything is written, like
+// they fail a conversion
+inline bool writeUsda(const std::string& path, const vox::ChunkParser& parser, const uint8_t* data,
+                      const std::string& sourceName, std::string& error)
+{
+    for (size_t m = 0; m < parser.models.size(); ++m)
+        if (!parser.models[m].recordsInside(data)) {
+            error = "voxel outside its model bounds in model " + std::to_string(m);
+            return false;
+        }
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        error = "cannot create " + path;
+        return false;
+    }
+
+    std::vector<vox::Placement> placements;
+    vox::scenePlacements(parser, placements);
+
+    bool ok;
+    {
+        TextOut out(f);
+        out << "#usda 1.0\n(\n    defaultPrim = \"World\"\n    upAxis = \"Z\"\n"
+            << "    doc = \"Converted from " << sourceName << " by vox2bella\"\n)\n\n";
+        out << "def Xform \"World\"\n{\n";
+
+        // Palette as 0..1 RGBA, indexed by primvars:paletteIndex
+        std::vector<uint32_t> palette(parser.palette, parser.palette + 256);
+        out << "    custom color4f[] vox:palette = ";
+        writeArray(out, palette, [&](uint32_t c) {
+            out << "(" << float(c & 0xFF) / 255.0f << ", " << float((c >> 8) & 0xFF) / 255.0f << ", "
+                << float((c >> 16) & 0xFF) / 255.0f << ", " << float((c >> 24) & 0xFF) / 255.0f << ")";
+        });
+        out << "\n\n";
+
+        out << "    def PointInstancer \"Placements\"\n    {\n";
+        std::vector<uint32_t> modelIndices(parser.models.size());
+        for (size_t m = 0; m < modelIndices.size(); ++m) modelIndices[m] = uint32_t(m);
+        out << "        rel prototypes = ";
+        writeArray(out, modelIndices, [&](uint32_t m) { out << "</World/Placements/Prototypes/model" << m << ">"; });
+        out << "\n        int[] protoIndices = ";
+        writeArray(out, placements, [&](const vox::Placement& p) { out << p.model; });
+        out << "\n        point3f[] positions = ";
+        writeArray(out, placements, [&](const vox::Placement& p) {
+            out << "(" << p.translation[0] << ", " << p.translation[1] << ", " << p.translation[2] << ")";
+        });
+        out << "\n        quath[] orientations = ";
+        writeArray(out, placements, [&](const vox::Placement& p) {
+            float q[4], s[3];
+            placementTransform(p.rotation, q, s);
+            out << "(" << q[0] << ", " << q[1] << ", " << q[2] << ", " << q[3] << ")";
+        });
+        out << "\n        float3[] scales = ";
+        writeArray(out, placements, [&](const vox::Placement& p) {
+            float q[4], s[3];
+            placementTransform(p.rotation, q, s);
+            out << "(" << s[0] << ", " << s[1] << ", " << s[2] << ")";
+        });
+        std::vector<uint32_t> hidden;
+        for (size_t i = 0; i < placements.size(); ++i)
+            if (placements[i].hidden) hidden.push_back(uint32_t(i));
+        out << "\n        int64[] invisibleIds = ";
+        writeArray(out, hidden, [&](uint32_t i) { out << i; });
+        out << "\n\n        def Scope \"Prototypes\"\n        {\n";
+
+        // Each model exactly once, however many times it is placed
+        for (size_t m = 0; m < parser.models.size(); ++m)
+        {
+            ModelMesh mesh;
+            buildModelMesh(parser.models[m], data, mesh);
+            std::vector<int> counts(mesh.paletteIndex.size(), 4);
+            std::vector<uint32_t> corners(mesh.points.size() / 3);
+            for (size_t i = 0; i < corners.size(); ++i) corners[i] = uint32_t(i);
+
+            out << "            def Mesh \"model" << uint32_t(m) << "\"\n            {\n";
+            out << "                uniform token subdivisionScheme = \"none\"\n";
+            out << "                int[] faceVertexCounts = ";
+            writeArray(out, counts, [&](int c) { out << c; });
+            out << "\n                int[] faceVertexIndices = ";
+            writeArray(out, mesh.faceVertexIndices, [&](int i) { out << i; });
+            out << "\n                point3f[] points = ";
+            writeArray(out, corners, [&](uint32_t i) {
+                out << "(" << mesh.points[i * 3] << ", " << mesh.points[i * 3 + 1] << ", " << mesh.points[i * 3 + 2] << ")";
+            });
+            out << "\n                int[] primvars:paletteIndex = ";
+            writeArray(out, mesh.paletteIndex, [&](int i) { out << i; });
+            out << " (\n                    interpolation = \"uniform\"\n                )\n";
+            out << "                color3f[] primvars:displayColor = ";
+            writeArray(out, mesh.paletteIndex, [&](int i) {
+                uint32_t c = parser.palette[i];
+                out << "(" << float(c & 0xFF) / 255.0f << ", " << float((c >> 8) & 0xFF) / 255.0f << ", " << float((c >> 16) & 0xFF) / 255.0f << ")";
+            });
+            out << " (\n                    interpolation = \"uniform\"\n                )\n";
+            out << "            }\n";
+        }
+        out << "        }\n    }\n}\n";
+        ok = out.flush();
+    }
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) error = "cannot write " + path;
+    return ok;
+}
+
+}} // namespace vox2bella::usd
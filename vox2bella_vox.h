@@ -0,0 +1,1157 @@
+// vox2bella_vox.h - Buffer based, resumable reader for MagicaVoxel .vox files
+//
+// The reader never copies voxel data: it walks the chunk headers of a .vox file that
+// is already in memory and records where each model's XYZI records start. Decoding
+// and meshing then read the records straight out of the buffer.
+//
+// DICT structures (used by MATL, nTRN, nGRP, nSHP, LAYR, rOBJ and rCAM) are decoded
+// by DictReader into std::string_views that point into the file buffer, and the
+// well-known keys are turned into DictKey integers at compile time, so scene-graph
+// heavy files parse without allocating per node.
+//
+// Parsing can be done a few chunks at a time (see ChunkParser::parse), which lets
+// the incremental converter spread a large file over several editor frames.
+// Nothing in here depends on the Bella SDK.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vox2bella { namespace vox {
+
+// Struct: A custom data type that groups multiple variables together
+// This struct defines the header format for .vox files
+struct VoxHeader 
+{
+    char magic[4];    // "VOX " - Identifier string that marks a valid .vox file
+    uint32_t version; // Version number of the file format (uint32_t is a 32-bit unsigned integer)
+};
+
+// Struct for chunk headers in the .vox file
+// A chunk is a section of data in the file with a specific purpose
+struct ChunkHeader 
+{
+    char id[4];              // 4-character identifier for the chunk type (e.g., "SIZE", "XYZI")
+    uint32_t contentBytes;   // Number of bytes of content in this chunk
+    uint32_t childrenBytes;  // Number of bytes in child chunks
+};
+
+// Default color palette used if a .vox file doesn't provide its own
+// This is an array of 256 unsigned integers, where each integer represents an RGBA color
+// Format: 0xAABBGGRR (red in the lowest byte), entry N is the color of color index N
+inline const uint32_t defaultPalette[256] = {
+    0x00000000, 0xffffffff, 0xffccffff, 0xff99ffff, 0xff66ffff, 0xff33ffff, 0xff00ffff, 0xffffccff, 0xffccccff, 0xff99ccff, 0xff66ccff, 0xff33ccff, 0xff00ccff, 0xffff99ff, 0xffcc99ff, 0xff9999ff,
+    0xff6699ff, 0xff3399ff, 0xff0099ff, 0xffff66ff, 0xffcc66ff, 0xff9966ff, 0xff6666ff, 0xff3366ff, 0xff0066ff, 0xffff33ff, 0xffcc33ff, 0xff9933ff, 0xff6633ff, 0xff3333ff, 0xff0033ff, 0xffff00ff,
+    0xffcc00ff, 0xff9900ff, 0xff6600ff, 0xff3300ff, 0xff0000ff, 0xffffffcc, 0xffccffcc, 0xff99ffcc, 0xff66ffcc, 0xff33ffcc, 0xff00ffcc, 0xffffcccc, 0xffcccccc, 0xff99cccc, 0xff66cccc, 0xff33cccc,
+    0xff00cccc, 0xffff99cc, 0xffcc99cc, 0xff9999cc, 0xff6699cc, 0xff3399cc, 0xff0099cc, 0xffff66cc, 0xffcc66cc, 0xff9966cc, 0xff6666cc, 0xff3366cc, 0xff0066cc, 0xffff33cc, 0xffcc33cc, 0xff9933cc,
+    0xff6633cc, 0xff3333cc, 0xff0033cc, 0xffff00cc, 0xffcc00cc, 0xff9900cc, 0xff6600cc, 0xff3300cc, 0xff0000cc, 0xffffff99, 0xffccff99, 0xff99ff99, 0xff66ff99, 0xff33ff99, 0xff00ff99, 0xffffcc99,
+    0xffcccc99, 0xff99cc99, 0xff66cc99, 0xff33cc99, 0xff00cc99, 0xffff9999, 0xffcc9999, 0xff999999, 0xff669999, 0xff339999, 0xff009999, 0xffff6699, 0xffcc6699, 0xff996699, 0xff666699, 0xff336699,
+    0xff006699, 0xffff3399, 0xffcc3399, 0xff993399, 0xff663399, 0xff333399, 0xff003399, 0xffff0099, 0xffcc0099, 0xff990099, 0xff660099, 0xff330099, 0xff000099, 0xffffff66, 0xffccff66, 0xff99ff66,
+    0xff66ff66, 0xff33ff66, 0xff00ff66, 0xffffcc66, 0xffcccc66, 0xff99cc66, 0xff66cc66, 0xff33cc66, 0xff00cc66, 0xffff9966, 0xffcc9966, 0xff999966, 0xff669966, 0xff339966, 0xff009966, 0xffff6666,
+    0xffcc6666, 0xff996666, 0xff666666, 0xff336666, 0xff006666, 0xffff3366, 0xffcc3366, 0xff993366, 0xff663366, 0xff333366, 0xff003366, 0xffff0066, 0xffcc0066, 0xff990066, 0xff660066, 0xff330066,
+    0xff000066, 0xffffff33, 0xffccff33, 0xff99ff33, 0xff66ff33, 0xff33ff33, 0xff00ff33, 0xffffcc33, 0xffcccc33, 0xff99cc33, 0xff66cc33, 0xff33cc33, 0xff00cc33, 0xffff9933, 0xffcc9933, 0xff999933,
+    0xff669933, 0xff339933, 0xff009933, 0xffff6633, 0xffcc6633, 0xff996633, 0xff666633, 0xff336633, 0xff006633, 0xffff3333, 0xffcc3333, 0xff993333, 0xff663333, 0xff333333, 0xff003333, 0xffff0033,
+    0xffcc0033, 0xff990033, 0xff660033, 0xff330033, 0xff000033, 0xffffff00, 0xffccff00, 0xff99ff00, 0xff66ff00, 0xff33ff00, 0xff00ff00, 0xffffcc00, 0xffcccc00, 0xff99cc00, 0xff66cc00, 0xff33cc00,
+    0xff00cc00, 0xffff9900, 0xffcc9900, 0xff999900, 0xff669900, 0xff339900, 0xff009900, 0xffff6600, 0xffcc6600, 0xff996600, 0xff666600, 0xff336600, 0xff006600, 0xffff3300, 0xffcc3300, 0xff993300,
+    0xff663300, 0xff333300, 0xff003300, 0xffff0000, 0xffcc0000, 0xff990000, 0xff660000, 0xff330000, 0xff0000ee, 0xff0000dd, 0xff0000bb, 0xff0000aa, 0xff000088, 0xff000077, 0xff000055, 0xff000044,
+    0xff000022, 0xff000011, 0xff00ee00, 0xff00dd00, 0xff00bb00, 0xff00aa00, 0xff008800, 0xff007700, 0xff005500, 0xff004400, 0xff002200, 0xff001100, 0xffee0000, 0xffdd0000, 0xffbb0000, 0xffaa0000,
+    0xff880000, 0xff770000, 0xff550000, 0xff440000, 0xff220000, 0xff110000, 0xffeeeeee, 0xffdddddd, 0xffbbbbbb, 0xffaaaaaa, 0xff888888, 0xff777777, 0xff555555, 0xff444444, 0xff222222, 0xff111111
+};
+
+// Reads a little-endian uint32 from a possibly unaligned address
+inline uint32_t readU32(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+// Strings that appear as DICT keys (and a few as values) in MagicaVoxel files
+// Looking them up gives a small integer, so the parser can switch on it
+enum DictKey : uint8_t
+{
+    KeyUnknown = 0,
+    // scene graph
+    Key_t, Key_r, Key_f, Key_name, Key_hidden, Key_loop,
+    // materials
+    Key_type, Key_weight, Key_rough, Key_spec, Key_ior, Key_att, Key_flux, Key_emit, Key_ldr,
+    Key_trans, Key_alpha, Key_d, Key_metal, Key_plastic, Key_sp, Key_g, Key_media, Key_media_type,
+    // material type values
+    Key_diffuse, Key_glass, Key_blend,
+    // rCAM
+    Key_mode, Key_focus, Key_angle, Key_radius, Key_frustum, Key_fov,
+    KeyCount
+};
+
+// FNV-1a, usable in constant expressions so the switch below is built by the compiler
+constexpr uint32_t fnv1a(std::string_view s)
+{
+    uint32_t h = 2166136261u;
+    for (char c : s) h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    return h;
+}
+
+// Maps a key to its DictKey, KeyUnknown for anything else
+constexpr DictKey dictKey(std::string_view s)
+{
+    #define VOX_KEY(str, id) case fnv1a(str): return s == str ? id : KeyUnknown;
+    switch (fnv1a(s))
+    {
+        VOX_KEY("_t", Key_t) VOX_KEY("_r", Key_r) VOX_KEY("_f", Key_f) VOX_KEY("_name", Key_name)
+        VOX_KEY("_hidden", Key_hidden) VOX_KEY("_loop", Key_loop)
+        VOX_KEY("_type", Key_type) VOX_KEY("_weight", Key_weight) VOX_KEY("_rough", Key_rough)
+        VOX_KEY("_spec", Key_spec) VOX_KEY("_ior", Key_ior) VOX_KEY("_att", Key_att) VOX_KEY("_flux", Key_flux)
+        VOX_KEY("_emit", Key_emit) VOX_KEY("_ldr", Key_ldr) VOX_KEY("_trans", Key_trans) VOX_KEY("_alpha", Key_alpha)
+        VOX_KEY("_d", Key_d) VOX_KEY("_metal", Key_metal) VOX_KEY("_plastic", Key_plastic) VOX_KEY("_sp", Key_sp)
+        VOX_KEY("_g", Key_g) VOX_KEY("_media", Key_media) VOX_KEY("_media_type", Key_media_type)
+        VOX_KEY("_diffuse", Key_diffuse) VOX_KEY("_glass", Key_glass) VOX_KEY("_blend", Key_blend)
+        VOX_KEY("_mode", Key_mode) VOX_KEY("_focus", Key_focus) VOX_KEY("_angle", Key_angle)
+        VOX_KEY("_radius", Key_radius) VOX_KEY("_frustum", Key_frustum) VOX_KEY("_fov", Key_fov)
+        default: return KeyUnknown;
+    }
+    #undef VOX_KEY
+}
+static_assert(dictKey("_name") == Key_name && dictKey("_nam") == KeyUnknown, "DICT key table");
+
+// One key/value pair, both views point into the file buffer
+struct DictEntry
+{
+    DictKey key = KeyUnknown;
+    std::string_view name;
+    std::string_view value;
+};
+
+// Bounds-checked reader for a DICT: [int32 count] then count x ([int32 len][bytes] [int32 len][bytes])
+class DictReader
+{
+public:
+    // p points at the DICT, 'available' is how many bytes may be read from there
+    DictReader(const uint8_t* p, size_t available) : m_p(p), m_end(p + available)
+    {
+        if (available < 4) { m_ok = false; return; }
+        m_remaining = readU32(p);
+        m_p += 4;
+    }
+
+    // Returns false at the end or if the DICT is damaged (check ok())
+    bool next(DictEntry& entry)
+    {
+        if (!m_ok || m_remaining == 0) return false;
+        if (!readString(entry.name) || !readString(entry.value)) { m_ok = false; return false; }
+        entry.key = dictKey(entry.name);
+        --m_remaining;
+        return true;
+    }
+
+    // Skips the remaining pairs, afterwards end() is the first byte after the DICT
+    bool skip()
+    {
+        DictEntry entry;
+        while (next(entry)) {}
+        return m_ok;
+    }
+
+    bool ok() const { return m_ok; }
+    const uint8_t* end() const { return m_p; }
+
+private:
+    bool readString(std::string_view& out)
+    {
+        if (m_end - m_p < 4) return false;
+        uint32_t length = readU32(m_p);
+        if (length > size_t(m_end - m_p) - 4) return false;
+        out = std::string_view(reinterpret_cast<const char*>(m_p + 4), length);
+        m_p += 4 + length;
+        return true;
+    }
+
+    const uint8_t* m_p;
+    const uint8_t* m_end;
+    uint32_t m_remaining = 0;
+    bool m_ok = true;
+};
+
+// Number parsing without allocating, values in DICTs are short decimal strings
+inline float dictFloat(std::string_view s)
+{
+    char buf[32];
+    size_t n = std::min(s.size(), sizeof(buf) - 1);
+    std::memcpy(buf, s.data(), n);
+    buf[n] = 0;
+    return std::strtof(buf, nullptr);
+}
+
+// Parses up to 'count' whitespace separated integers, returns how many were found
+inline int dictInts(std::string_view s, int32_t* out, int count)
+{
+    int found = 0;
+    size_t i = 0;
+    while (found < count && i < s.size())
+    {
+        while (i < s.size() && s[i] == ' ') ++i;
+        bool negative = i < s.size() && s[i] == '-';
+        if (negative) ++i;
+        if (i >= s.size() || s[i] < '0' || s[i] > '9') break;
+        int64_t v = 0;
+        while (i < s.size() && s[i] >= '0' && s[i] <= '9') v = v * 10 + (s[i++] - '0');
+        out[found++] = static_cast<int32_t>(negative ? -v : v);
+    }
+    return found;
+}
+
+// Same for floats, used by rCAM vectors
+inline int dictFloats(std::string_view s, float* out, int count)
+{
+    char buf[128];
+    size_t n = std::min(s.size(), sizeof(buf) - 1);
+    std::memcpy(buf, s.data(), n);
+    buf[n] = 0;
+    const char* p = buf;
+    int found = 0;
+    while (found < count)
+    {
+        char* end = nullptr;
+        float v = std::strtof(p, &end);
+        if (end == p) break;
+        out[found++] = v;
+        p = end;
+    }
+    return found;
+}
+
+enum MaterialType : uint8_t
+{
+    MaterialDiffuse, MaterialMetal, MaterialGlass, MaterialEmit, MaterialBlend, MaterialMedia
+};
+
+// Struct to store material properties from a MATL chunk
+// Properties that were not in the file keep MagicaVoxel's defaults, 'present' has
+// bit (1 << key) set for every DictKey that was found
+struct Material
+{
+    int32_t materialId = 0;     // ID number for this material (the palette index it applies to)
+    MaterialType type = MaterialDiffuse;
+    uint64_t present = 0;
+    float weight = 1.0f, rough = 0.1f, spec = 0.5f, ior = 0.3f, att = 0.0f, flux = 0.0f;
+    float emit = 0.0f, ldr = 0.0f, trans = 0.0f, alpha = 0.0f, density = 0.0f;
+    float metal = 0.0f, plastic = 0.0f, sp = 0.0f, g = 0.0f;
+
+    bool has(DictKey key) const { return (present >> key) & 1u; }
+};
+
+// Scene graph nodes, see the MagicaVoxel format description for nTRN/nGRP/nSHP
+// Only the first animation frame of a transform is kept
+struct TransformNode
+{
+    int32_t nodeId = -1;
+    std::string_view name;      // _name, empty if unnamed
+    bool hidden = false;        // _hidden
+    int32_t childId = -1;
+    int32_t layerId = -1;
+    uint8_t rotation = 4;       // _r, packed rotation, 4 = identity
+    int32_t translation[3] = { 0, 0, 0 }; // _t
+    uint32_t numFrames = 0;
+};
+
+struct GroupNode
+{
+    int32_t nodeId = -1;
+    bool hidden = false;
+    uint32_t firstChild = 0;    // into ChunkParser::groupChildren
+    uint32_t numChildren = 0;
+};
+
+struct ShapeNode
+{
+    int32_t nodeId = -1;
+    uint32_t firstModel = 0;    // into ChunkParser::shapeModels
+    uint32_t numModels = 0;
+};
+
+// Where a scene graph node id is defined, see ChunkParser::nodeIndex
+enum NodeKind : uint8_t { NodeTransform, NodeGroup, NodeShape };
+struct NodeEntry
+{
+    int32_t nodeId = -1;
+    NodeKind kind = NodeTransform;
+    uint32_t index = 0;         // into ChunkParser::transforms, groups or shapes
+};
+
+struct Layer
+{
+    int32_t layerId = -1;
+    std::string_view name;
+    bool hidden = false;
+};
+
+// rCAM: a saved camera from the MagicaVoxel renderer
+struct CameraInfo
+{
+    int32_t cameraId = -1;
+    std::string_view mode;      // _mode, e.g. "pers"
+    float focus[3] = { 0, 0, 0 };
+    float angle[3] = { 0, 0, 0 };
+    float radius = 0.0f;
+    float frustum = 0.0f;
+    int32_t fov = 0;
+};
+
+// rOBJ: renderer settings, kept as a raw DICT span so callers can walk it with DictReader
+struct RenderObject
+{
+    std::string_view type;      // _type, e.g. "_bounce"
+    size_t dictOffset = 0;
+    size_t dictBytes = 0;
+};
+
+// One model: its dimensions from the SIZE chunk and where its XYZI records live
+struct ModelRef
+{
+    uint32_t sizeX = 0, sizeY = 0, sizeZ = 0;
+    size_t   xyziOffset = 0;   // offset of the first {x,y,z,colorIndex} record in the file buffer
+    uint32_t numVoxels = 0;
+
+    // True if every XYZI record in 'data' (the file buffer) lies inside the SIZE box
+    bool recordsInside(const uint8_t* data) const
+    {
+        const uint8_t* records = data + xyziOffset;
+        for (uint32_t i = 0; i < numVoxels; ++i)
+        {
+            const uint8_t* v = records + size_t(i) * 4;
+            if (v[0] >= sizeX || v[1] >= sizeY || v[2] >= sizeZ) return false;
+        }
+        return true;
+    }
+};
+
+// Walks the chunks of a .vox file held in memory
+// Usage: begin() once, then parse() until done(), then read the public members
+class ChunkParser
+{
+public:
+    // Filled in while parsing
+    std::vector<ModelRef> models;
+    std::vector<Material> materials;
+    uint32_t palette[256];
+    bool hasPalette = false;
+
+    // Scene graph, indices into the pools below avoid per-node allocations
+    std::vector<TransformNode> transforms;
+    std::vector<GroupNode> groups;
+    std::vector<ShapeNode> shapes;
+    std::vector<int32_t> groupChildren;   // child node ids of all groups
+    std::vector<int32_t> shapeModels;     // model ids of all shapes
+    std::vector<Layer> layers;
+    std::vector<CameraInfo> cameras;
+    std::vector<RenderObject> renderObjects;
+    // Every transform, group and shape sorted by node id, built once parsing is done
+    // so the scene graph walks look nodes up instead of scanning all of them
+    std::vector<NodeEntry> nodeIndex;
+
+    // Checks the file header, the buffer must stay alive while the results are used
+    bool begin(const uint8_t* data, size_t size, std::string& error)
+    {
+        m_data = data;
+        m_size = size;
+        m_offset = sizeof(VoxHeader);
+        m_pendingSize = false;
+        models.clear();
+        materials.clear();
+        transforms.clear();
+        groups.clear();
+        shapes.clear();
+        groupChildren.clear();
+        shapeModels.clear();
+        layers.clear();
+        cameras.clear();
+        renderObjects.clear();
+        nodeIndex.clear();
+        m_indexed = false;
+        std::memcpy(palette, defaultPalette, sizeof(palette));
+        hasPalette = false;
+
+        // Validate that this is actually a VOX file by checking the magic number
+        if (size < sizeof(VoxHeader) || std::memcmp(data, "VOX ", 4) != 0)
+        {
+            error = "Invalid file format.";
+            return false;
+        }
+        return true;
+    }
+
+    bool done() const { return m_offset >= m_size; }
+    size_t offset() const { return m_offset; }
+    size_t size() const { return m_size; }
+
+    // Parses up to maxChunks more chunks, returns false with 'error' set if the file is damaged
+    //
+    // Chunks are visited in file order. A chunk's children start right after its content,
+    // so a flat walk over the headers visits MAIN and then every child chunk in turn.
+    bool parse(size_t maxChunks, std::string& error)
+    {
+        for (size_t n = 0; n < maxChunks && !done(); ++n)
+        {
+            if (m_size - m_offset < sizeof(ChunkHeader))
+            {
+                error = "truncated chunk header at offset " + std::to_string(m_offset);
+                return false;
+            }
+            const uint8_t* header = m_data + m_offset;
+            uint32_t contentBytes = readU32(header + 4);
+            size_t contentOffset = m_offset + sizeof(ChunkHeader);
+            if (contentBytes > m_size - contentOffset)
+            {
+                error = "chunk " + std::string(reinterpret_cast<const char*>(header), 4) + " runs past the end of the file";
+                return false;
+            }
+            if (!readChunk(header, m_data + contentOffset, contentBytes, contentOffset, error))
+                return false;
+            m_offset = contentOffset + contentBytes;
+        }
+        if (done() && !m_indexed) indexNodes();
+        return true;
+    }
+
+    // Entries [first, second) of nodeIndex with this id, a damaged file can repeat ids
+    std::pair<size_t, size_t> nodesWithId(int32_t nodeId) const
+    {
+        auto less = [](const NodeEntry& a, const NodeEntry& b) { return a.nodeId < b.nodeId; };
+        NodeEntry key;
+        key.nodeId = nodeId;
+        auto range = std::equal_range(nodeIndex.begin(), nodeIndex.end(), key, less);
+        return { size_t(range.first - nodeIndex.begin()), size_t(range.second - nodeIndex.begin()) };
+    }
+
+    // Collects the models below every transform called 'name' (nTRN _name), including
+    // models inside named groups. Call after parsing is done. Returns false if no
+    // transform has that name.
+    bool modelsNamed(std::string_view name, std::vector<uint32_t>& out) const
+    {
+        bool found = false;
+        std::vector<uint8_t> visited(nodeIndex.size(), 0);
+        for (const TransformNode& t : transforms)
+        {
+            if (t.name != name) continue;
+            found = true;
+            collectModels(t.childId, out, visited, 0);
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return found;
+    }
+
+private:
+    void indexNodes()
+    {
+        nodeIndex.clear();
+        nodeIndex.reserve(transforms.size() + groups.size() + shapes.size());
+        for (size_t i = 0; i < transforms.size(); ++i) nodeIndex.push_back({ transforms[i].nodeId, NodeTransform, uint32_t(i) });
+        for (size_t i = 0; i < groups.size(); ++i) nodeIndex.push_back({ groups[i].nodeId, NodeGroup, uint32_t(i) });
+        for (size_t i = 0; i < shapes.size(); ++i) nodeIndex.push_back({ shapes[i].nodeId, NodeShape, uint32_t(i) });
+        std::stable_sort(nodeIndex.begin(), nodeIndex.end(), [](const NodeEntry& a, const NodeEntry& b) { return a.nodeId < b.nodeId; });
+        m_indexed = true;
+    }
+
+    // Walks the scene graph below nodeId. MagicaVoxel graphs are trees, so every node
+    // is walked at most once ('visited' is per nodeIndex entry), which also stops
+    // cycles and shared children in damaged files. The depth limit bounds the stack.
+    void collectModels(int32_t nodeId, std::vector<uint32_t>& out, std::vector<uint8_t>& visited, int depth) const
+    {
+        if (depth > 64) return;
+        const std::pair<size_t, size_t> range = nodesWithId(nodeId);
+        for (size_t n = range.first; n < range.second; ++n)
+        {
+            if (visited[n]) continue;
+            visited[n] = 1;
+            const NodeEntry& e = nodeIndex[n];
+            if (e.kind == NodeTransform)
+                collectModels(transforms[e.index].childId, out, visited, depth + 1);
+            else if (e.kind == NodeGroup)
+            {
+                const GroupNode& g = groups[e.index];
+                for (uint32_t i = 0; i < g.numChildren; ++i)
+                    collectModels(groupChildren[g.firstChild + i], out, visited, depth + 1);
+            }
+            else
+            {
+                const ShapeNode& sh = shapes[e.index];
+                for (uint32_t i = 0; i < sh.numModels; ++i)
+                {
+                    int32_t modelId = shapeModels[sh.firstModel + i];
+                    if (modelId >= 0 && size_t(modelId) < models.size()) out.push_back(uint32_t(modelId));
+                }
+            }
+        }
+    }
+
+    bool readChunk(const uint8_t* header, const uint8_t* content, uint32_t contentBytes, size_t contentOffset, std::string& error)
+    {
+        // Process the chunk based on its ID
+        // Different chunk types contain different data and need special handling
+        if (std::memcmp(header, "SIZE", 4) == 0)
+        {
+            // SIZE chunk contains the dimensions of the voxel model (width, height, depth)
+            if (contentBytes < 12) { error = "SIZE chunk too small"; return false; }
+            ModelRef model;
+            model.sizeX = readU32(content);
+            model.sizeY = readU32(content + 4);
+            model.sizeZ = readU32(content + 8);
+            // MagicaVoxel models are at most 256 on a side, the grids are sized from this
+            if (model.sizeX > 256 || model.sizeY > 256 || model.sizeZ > 256) { error = "SIZE larger than 256 on an axis"; return false; }
+            models.push_back(model);
+            m_pendingSize = true;
+        }
+        else if (std::memcmp(header, "XYZI", 4) == 0)
+        {
+            // XYZI chunk contains the voxel data - locations and colors of each voxel
+            // First 4 bytes contain the number of voxels, then 4 bytes per voxel
+            if (!m_pendingSize) { error = "XYZI chunk without a SIZE chunk"; return false; }
+            if (contentBytes < 4) { error = "XYZI chunk too small"; return false; }
+            uint32_t numVoxels = readU32(content);
+            if (uint64_t(numVoxels) * 4 > contentBytes - 4) { error = "XYZI voxel count exceeds chunk size"; return false; }
+            models.back().xyziOffset = contentOffset + 4;
+            models.back().numVoxels = numVoxels;
+            m_pendingSize = false;
+        }
+        else if (std::memcmp(header, "RGBA", 4) == 0)
+        {
+            // RGBA chunk holds 256 colors, entry i is the color of color index i+1
+            if (contentBytes < 1024) { error = "RGBA chunk too small"; return false; }
+            for (int i = 0; i < 256; ++i)
+                palette[(i + 1) & 255] = readU32(content + i * 4);
+            hasPalette = true;
+        }
+        else if (std::memcmp(header, "MATL", 4) == 0)
+        {
+            // MATL chunk contains material definitions: [material id] then a DICT
+            if (contentBytes < 4) { error = "MATL chunk too small"; return false; }
+            Material material;
+            material.materialId = static_cast<int32_t>(readU32(content));
+            DictReader dict(content + 4, contentBytes - 4);
+            if (!readMaterial(dict, material)) { error = "damaged MATL dictionary"; return false; }
+            materials.push_back(material);
+        }
+        else if (std::memcmp(header, "nTRN", 4) == 0)
+        {
+            // [node id][DICT][child id][reserved][layer id][frame count][frame DICTs...]
+            const uint8_t* end = content + contentBytes;
+            if (contentBytes < 4) { error = "nTRN chunk too small"; return false; }
+            TransformNode node;
+            node.nodeId = static_cast<int32_t>(readU32(content));
+            DictReader attrs(content + 4, contentBytes - 4);
+            DictEntry entry;
+            while (attrs.next(entry))
+            {
+                if (entry.key == Key_name) node.name = entry.value;
+                else if (entry.key == Key_hidden) node.hidden = entry.value == "1";
+            }
+            const uint8_t* p = attrs.end();
+            if (!attrs.ok() || end - p < 16) { error = "damaged nTRN chunk"; return false; }
+            node.childId = static_cast<int32_t>(readU32(p));
+            node.layerId = static_cast<int32_t>(readU32(p + 8));
+            node.numFrames = readU32(p + 12);
+            p += 16;
+            for (uint32_t f = 0; f < node.numFrames; ++f)
+            {
+                DictReader frame(p, size_t(end - p));
+                while (frame.next(entry))
+                {
+                    if (f != 0) continue; // animation frames beyond the first are not used
+                    if (entry.key == Key_r) node.rotation = static_cast<uint8_t>(dictFloat(entry.value));
+                    else if (entry.key == Key_t) dictInts(entry.value, node.translation, 3);
+                }
+                if (!frame.ok()) { error = "damaged nTRN frame"; return false; }
+                p = frame.end();
+            }
+            transforms.push_back(node);
+        }
+        else if (std::memcmp(header, "nGRP", 4) == 0)
+        {
+            // [node id][DICT][child count][child ids...]
+            const uint8_t* end = content + contentBytes;
+            if (contentBytes < 4) { error = "nGRP chunk too small"; return false; }
+            GroupNode node;
+            node.nodeId = static_cast<int32_t>(readU32(content));
+            DictReader attrs(content + 4, contentBytes - 4);
+            DictEntry entry;
+            while (attrs.next(entry))
+                if (entry.key == Key_hidden) node.hidden = entry.value == "1";
+            const uint8_t* p = attrs.end();
+            if (!attrs.ok() || end - p < 4) { error = "damaged nGRP chunk"; return false; }
+            node.numChildren = readU32(p);
+            p += 4;
+            if (uint64_t(node.numChildren) * 4 > uint64_t(end - p)) { error = "nGRP child list runs past its chunk"; return false; }
+            node.firstChild = static_cast<uint32_t>(groupChildren.size());
+            for (uint32_t i = 0; i < node.numChildren; ++i)
+                groupChildren.push_back(static_cast<int32_t>(readU32(p + i * 4)));
+            groups.push_back(node);
+        }
+        else if (std::memcmp(header, "nSHP", 4) == 0)
+        {
+            // [node id][DICT][model count] then per model [model id][DICT]
+            const uint8_t* end = content + contentBytes;
+            if (contentBytes < 4) { error = "nSHP chunk too small"; return false; }
+            ShapeNode node;
+            node.nodeId = static_cast<int32_t>(readU32(content));
+            DictReader attrs(content + 4, contentBytes - 4);
+            const uint8_t* p = attrs.skip() ? attrs.end() : nullptr;
+            if (!p || end - p < 4) { error = "damaged nSHP chunk"; return false; }
+            node.numModels = readU32(p);
+            p += 4;
+            node.firstModel = static_cast<uint32_t>(shapeModels.size());
+            for (uint32_t i = 0; i < node.numModels; ++i)
+            {
+                if (end - p < 4) { error = "nSHP model list runs past its chunk"; return false; }
+                shapeModels.push_back(static_cast<int32_t>(readU32(p)));
+                DictReader modelAttrs(p + 4, size_t(end - p) - 4);
+                if (!modelAttrs.skip()) { error = "damaged nSHP model dictionary"; return false; }
+                p = modelAttrs.end();
+            }
+            shapes.push_back(node);
+        }
+        else if (std::memcmp(header, "LAYR", 4) == 0)
+        {
+            // [layer id][DICT][reserved]
+            if (contentBytes < 4) { error = "LAYR chunk too small"; return false; }
+            Layer layer;
+            layer.layerId = static_cast<int32_t>(readU32(content));
+            DictReader attrs(content + 4, contentBytes - 4);
+            DictEntry entry;
+            while (attrs.next(entry))
+            {
+                if (entry.key == Key_name) layer.name = entry.value;
+                else if (entry.key == Key_hidden) layer.hidden = entry.value == "1";
+            }
+            if (!attrs.ok()) { error = "damaged LAYR dictionary"; return false; }
+            layers.push_back(layer);
+        }
+        else if (std::memcmp(header, "rCAM", 4) == 0)
+        {
+            // [camera id][DICT]
+            if (contentBytes < 4) { error = "rCAM chunk too small"; return false; }
+            CameraInfo camera;
+            camera.cameraId = static_cast<int32_t>(readU32(content));
+            DictReader attrs(content + 4, contentBytes - 4);
+            DictEntry entry;
+            while (attrs.next(entry))
+            {
+                switch (entry.key)
+                {
+                    case Key_mode:    camera.mode = entry.value; break;
+                    case Key_focus:   dictFloats(entry.value, camera.focus, 3); break;
+                    case Key_angle:   dictFloats(entry.value, camera.angle, 3); break;
+                    case Key_radius:  camera.radius = dictFloat(entry.value); break;
+                    case Key_frustum: camera.frustum = dictFloat(entry.value); break;
+                    case Key_fov:     camera.fov = static_cast<int32_t>(dictFloat(entry.value)); break;
+                    default: break;
+                }
+            }
+            if (!attrs.ok()) { error = "damaged rCAM dictionary"; return false; }
+            cameras.push_back(camera);
+        }
+        else if (std::memcmp(header, "rOBJ", 4) == 0)
+        {
+            // A single DICT
+            RenderObject object;
+            object.dictOffset = contentOffset;
+            object.dictBytes = contentBytes;
+            DictReader attrs(content, contentBytes);
+            DictEntry entry;
+            while (attrs.next(entry))
+                if (entry.key == Key_type) object.type = entry.value;
+            if (!attrs.ok()) { error = "damaged rOBJ dictionary"; return false; }
+            renderObjects.push_back(object);
+        }
+        // MAIN, PACK, NOTE, IMAP, MATT... are skipped for now
+        return true;
+    }
+
+    static bool readMaterial(DictReader& dict, Material& material)
+    {
+        DictEntry entry;
+        while (dict.next(entry))
+        {
+            material.present |= uint64_t(1) << entry.key;
+            switch (entry.key)
+            {
+                case Key_type:
+                    switch (dictKey(entry.value))
+                    {
+                        case Key_metal: material.type = MaterialMetal; break;
+                        case Key_glass: material.type = MaterialGlass; break;
+                        case Key_emit:  material.type = MaterialEmit;  break;
+                        case Key_blend: material.type = MaterialBlend; break;
+                        case Key_media: material.type = MaterialMedia; break;
+                        default:        material.type = MaterialDiffuse; break;
+                    }
+                    break;
+                case Key_weight:  material.weight  = dictFloat(entry.value); break;
+                case Key_rough:   material.rough   = dictFloat(entry.value); break;
+                case Key_spec:    material.spec    = dictFloat(entry.value); break;
+                case Key_ior:     material.ior     = dictFloat(entry.value); break;
+                case Key_att:     material.att     = dictFloat(entry.value); break;
+                case Key_flux:    material.flux    = dictFloat(entry.value); break;
+                case Key_emit:    material.emit    = dictFloat(entry.value); break;
+                case Key_ldr:     material.ldr     = dictFloat(entry.value); break;
+                case Key_trans:   material.trans   = dictFloat(entry.value); break;
+                case Key_alpha:   material.alpha   = dictFloat(entry.value); break;
+                case Key_d:       material.density = dictFloat(entry.value); break;
+                case Key_metal:   material.metal   = dictFloat(entry.value); break;
+                case Key_plastic: material.plastic = dictFloat(entry.value); break;
+                case Key_sp:      material.sp      = dictFloat(entry.value); break;
+                case Key_g:       material.g       = dictFloat(entry.value); break;
+                default: break;
+            }
+        }
+        return dict.ok();
+    }
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_offset = 0;
+    bool m_pendingSize = false;  // a SIZE chunk is waiting for its XYZI chunk
+    bool m_indexed = false;      // nodeIndex is built
+};
+
+// Face directions and the corners of each face of the unit cube, wound
+// counter-clockwise seen from outside. Shared by every writer that builds meshes.
+inline const int8_t faceDirs[6][3] = { {1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1} };
+inline const uint8_t faceCorners[6][4][3] = {
+    { {1,0,0}, {1,1,0}, {1,1,1}, {1,0,1} },
+    { {0,0,0}, {0,0,1}, {0,1,1}, {0,1,0} },
+    { {0,1,0}, {0,1,1}, {1,1,1}, {1,1,0} },
+    { {0,0,0}, {1,0,0}, {1,0,1}, {0,0,1} },
+    { {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} },
+    { {0,0,0}, {0,1,0}, {1,1,0}, {1,0,0} },
+};
+
+// Dense color grid of one model, one byte per cell, 0 = empty. Cell (x,y,z) lives at
+// x + y*sizeX + z*sizeX*sizeY, so the z neighbour of a cell is a whole slice away.
+// Kept as the reference layout for the benchmark, the converter uses TiledGrid.
+class LinearGrid
+{
+public:
+    void assign(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ)
+    {
+        m_size[0] = int(sizeX); m_size[1] = int(sizeY); m_size[2] = int(sizeZ);
+        m_cells.assign(size_t(sizeX) * sizeY * sizeZ, 0);
+    }
+    void clear() { m_cells.clear(); m_cells.shrink_to_fit(); m_size[0] = m_size[1] = m_size[2] = 0; }
+
+    int sizeX() const { return m_size[0]; }
+    int sizeY() const { return m_size[1]; }
+    int sizeZ() const { return m_size[2]; }
+    uint64_t volume() const { return uint64_t(m_size[0]) * m_size[1] * m_size[2]; }
+    size_t storage() const { return m_cells.size(); }
+    bool contains(int x, int y, int z) const { return x >= 0 && y >= 0 && z >= 0 && x < m_size[0] && y < m_size[1] && z < m_size[2]; }
+
+    // Position of a cell in storage(), for side tables with the same layout
+    size_t index(int x, int y, int z) const { return x + size_t(y) * m_size[0] + size_t(z) * m_size[0] * m_size[1]; }
+    uint8_t get(int x, int y, int z) const { return m_cells[index(x, y, z)]; }
+    void set(int x, int y, int z, uint8_t c) { m_cells[index(x, y, z)] = c; }
+
+    // The cell next to (x,y,z) in faceDirs[d], empty outside the grid
+    uint8_t neighbour(int x, int y, int z, int d) const
+    {
+        x += faceDirs[d][0]; y += faceDirs[d][1]; z += faceDirs[d][2];
+        return contains(x, y, z) ? get(x, y, z) : 0;
+    }
+
+    // All six neighbours of a cell inside the grid, in faceDirs order
+    void neighbours(int x, int y, int z, uint8_t (&n)[6]) const
+    {
+        const size_t i = index(x, y, z), row = size_t(m_size[0]), slice = row * m_size[1];
+        n[0] = x + 1 < m_size[0] ? m_cells[i + 1] : 0;
+        n[1] = x > 0 ? m_cells[i - 1] : 0;
+        n[2] = y + 1 < m_size[1] ? m_cells[i + row] : 0;
+        n[3] = y > 0 ? m_cells[i - row] : 0;
+        n[4] = z + 1 < m_size[2] ? m_cells[i + slice] : 0;
+        n[5] = z > 0 ? m_cells[i - slice] : 0;
+    }
+
+    // index() of the six neighbours, in faceDirs order. Only meaningful for neighbours
+    // inside the grid.
+    void neighbourIndices(int x, int y, int z, size_t (&n)[6]) const
+    {
+        const size_t i = index(x, y, z), row = size_t(m_size[0]), slice = row * m_size[1];
+        n[0] = i + 1; n[1] = i - 1;
+        n[2] = i + row; n[3] = i - row;
+        n[4] = i + slice; n[5] = i - slice;
+    }
+
+    uint8_t at(size_t i) const { return m_cells[i]; }
+
+    // Calls fn(x, y, z, i) for every cell in storage order, i is its index()
+    template <class Fn>
+    void forEachCell(Fn fn) const
+    {
+        size_t i = 0;
+        for (int z = 0; z < m_size[2]; ++z)
+            for (int y = 0; y < m_size[1]; ++y)
+                for (int x = 0; x < m_size[0]; ++x)
+                    fn(x, y, z, i++);
+    }
+
+private:
+    int m_size[3] = { 0, 0, 0 };
+    std::vector<uint8_t> m_cells;
+};
+
+// The same grid stored as 4x4x4 tiles of 64 bytes, one cache line each. Tiles follow
+// each other x fastest, and the cells of a tile are in Morton order (x, y and z bits
+// interleaved), so most neighbours of a cell share its cache line where the linear
+// layout puts the y and z neighbours a row and a slice away. The cells are surrounded
+// by a one cell border that stays empty, so neighbours() reads cells outside the model
+// as empty without a bounds test, and the tiles round the rest up to whole tiles.
+class TiledGrid
+{
+public:
+    void assign(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ)
+    {
+        reshape(sizeX, sizeY, sizeZ);
+        allocate(m_tiles[2]);
+    }
+
+    // Like assign() but without the cells, allocate() adds them a layer of tiles at a
+    // time so that clearing a big grid can be spread over several calls
+    void reshape(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ)
+    {
+        m_size[0] = int(sizeX); m_size[1] = int(sizeY); m_size[2] = int(sizeZ);
+        for (int a = 0; a < 3; ++a) m_tiles[a] = (m_size[a] + 2 + 3) / 4;
+        m_cells.clear();
+        m_cells.reserve(size_t(m_tiles[0]) * m_tiles[1] * m_tiles[2] * 64);
+        // index() is the sum of one offset per axis: the tile's start plus the stored
+        // coordinate's 2 low bits spread to every third bit (b1 b0 -> b1 0 0 b0).
+        // Entry c is for coordinate c - 1, the border included.
+        static const uint8_t spread[4] = { 0, 1, 8, 9 };
+        const size_t tileStride[3] = { 64, size_t(m_tiles[0]) * 64, size_t(m_tiles[0]) * m_tiles[1] * 64 };
+        for (int a = 0; a < 3; ++a)
+        {
+            m_offset[a].resize(size_t(m_size[a]) + 2);
+            for (int c = 0; c < m_size[a] + 2; ++c)
+                m_offset[a][size_t(c)] = size_t(c >> 2) * tileStride[a] + (size_t(spread[c & 3]) << a);
+        }
+    }
+
+    // Appends up to 'layers' empty layers of tiles (4 z-slices each) after reshape()
+    // Returns true once the grid is complete
+    bool allocate(int layers)
+    {
+        const size_t layer = size_t(m_tiles[0]) * m_tiles[1] * 64, total = layer * m_tiles[2];
+        m_cells.resize(std::min(total, m_cells.size() + layer * size_t(layers)), 0);
+        return m_cells.size() == total;
+    }
+    void clear()
+    {
+        m_cells.clear(); m_cells.shrink_to_fit();
+        for (std::vector<size_t>& offsets : m_offset) offsets.clear();
+        m_size[0] = m_size[1] = m_size[2] = 0;
+        m_tiles[0] = m_tiles[1] = m_tiles[2] = 0;
+    }
+
+    int sizeX() const { return m_size[0]; }
+    int sizeY() const { return m_size[1]; }
+    int sizeZ() const { return m_size[2]; }
+    uint64_t volume() const { return uint64_t(m_size[0]) * m_size[1] * m_size[2]; }
+    size_t storage() const { return m_cells.size(); }
+    bool contains(int x, int y, int z) const { return x >= 0 && y >= 0 && z >= 0 && x < m_size[0] && y < m_size[1] && z < m_size[2]; }
+
+    size_t index(int x, int y, int z) const { return m_offset[0][size_t(x + 1)] + m_offset[1][size_t(y + 1)] + m_offset[2][size_t(z + 1)]; }
+    uint8_t get(int x, int y, int z) const { return m_cells[index(x, y, z)]; }
+    void set(int x, int y, int z, uint8_t c) { m_cells[index(x, y, z)] = c; }
+
+    uint8_t neighbour(int x, int y, int z, int d) const
+    {
+        return get(x + faceDirs[d][0], y + faceDirs[d][1], z + faceDirs[d][2]);
+    }
+
+    void neighbours(int x, int y, int z, uint8_t (&n)[6]) const
+    {
+        const size_t* ox = m_offset[0].data() + x + 1;
+        const size_t* oy = m_offset[1].data() + y + 1;
+        const size_t* oz = m_offset[2].data() + z + 1;
+        n[0] = m_cells[ox[1] + *oy + *oz];
+        n[1] = m_cells[ox[-1] + *oy + *oz];
+        n[2] = m_cells[*ox + oy[1] + *oz];
+        n[3] = m_cells[*ox + oy[-1] + *oz];
+        n[4] = m_cells[*ox + *oy + oz[1]];
+        n[5] = m_cells[*ox + *oy + oz[-1]];
+    }
+
+    void neighbourIndices(int x, int y, int z, size_t (&n)[6]) const
+    {
+        const size_t* ox = m_offset[0].data() + x + 1;
+        const size_t* oy = m_offset[1].data() + y + 1;
+        const size_t* oz = m_offset[2].data() + z + 1;
+        n[0] = ox[1] + *oy + *oz; n[1] = ox[-1] + *oy + *oz;
+        n[2] = *ox + oy[1] + *oz; n[3] = *ox + oy[-1] + *oz;
+        n[4] = *ox + *oy + oz[1]; n[5] = *ox + *oy + oz[-1];
+    }
+
+    uint8_t at(size_t i) const { return m_cells[i]; }
+
+    // Calls fn(x, y, z, i) for every cell in storage order, the border is skipped
+    template <class Fn>
+    void forEachCell(Fn fn) const
+    {
+        size_t i = 0;
+        for (int tz = 0; tz < m_tiles[2]; ++tz)
+            for (int ty = 0; ty < m_tiles[1]; ++ty)
+                for (int tx = 0; tx < m_tiles[0]; ++tx)
+                    for (int m = 0; m < 64; ++m, ++i)
+                    {
+                        // Inverse of the spread in assign()
+                        int x = tx * 4 + (m & 1) + (m >> 2 & 2) - 1;
+                        int y = ty * 4 + (m >> 1 & 1) + (m >> 3 & 2) - 1;
+                        int z = tz * 4 + (m >> 2 & 1) + (m >> 4 & 2) - 1;
+                        if (contains(x, y, z)) fn(x, y, z, i);
+                    }
+    }
+
+private:
+    int m_size[3] = { 0, 0, 0 };
+    int m_tiles[3] = { 0, 0, 0 };
+    std::vector<size_t> m_offset[3];   // per axis, see assign()
+    std::vector<uint8_t> m_cells;
+};
+
+// The layout the converter and the writers use
+using VoxelGrid = TiledGrid;
+
+// Sets the cells of records [begin, end), so a grid can be filled over several calls
+template <class Grid>
+inline void setRecords(const uint8_t* records, uint32_t begin, uint32_t end, Grid& grid)
+{
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const uint8_t* v = records + size_t(i) * 4;
+        grid.set(v[0], v[1], v[2], v[3]);
+    }
+}
+
+// Fills a color index per cell, 0 = empty
+// Records must already be inside the model bounds, a later record wins over an earlier one
+template <class Grid>
+inline void fillGrid(const uint8_t* records, uint32_t numVoxels, uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ, Grid& grid)
+{
+    grid.assign(sizeX, sizeY, sizeZ);
+    setRecords(records, 0, numVoxels, grid);
+}
+
+// Calls fn(face) for every face of the voxel record v whose neighbour cell is empty
+// Duplicate records that lost their cell to a later record produce no faces
+template <class Grid, class Fn>
+inline void exposedFaces(const Grid& grid, const uint8_t* v, Fn fn)
+{
+    const int x = v[0], y = v[1], z = v[2];
+    if (grid.get(x, y, z) != v[3]) return;
+    uint8_t n[6];
+    grid.neighbours(x, y, z, n);
+    for (int d = 0; d < 6; ++d)
+        if (n[d] == 0) fn(d);
+}
+
+// Counts the empty cells that can't be reached from outside the model through other
+// empty cells (6-connected), i.e. rooms and cavities fully enclosed by voxels.
+// The flood fill can be spread over several calls: begin(), then step() until it
+// returns true. The grid must not change in between.
+template <class Grid>
+class EnclosedCounter
+{
+public:
+    void begin(const Grid& grid)
+    {
+        m_grid = &grid;
+        m_reached.assign(grid.storage(), 0);    // same layout as the grid
+        m_stack.clear();
+        m_side = 0;
+        m_cell = 0;
+        m_visited = m_occupied = 0;
+    }
+
+    // Does about 'budget' cells of work, returns true once the counts are final
+    bool step(size_t budget = SIZE_MAX)
+    {
+        const Grid& grid = *m_grid;
+        const int sizeX = grid.sizeX(), sizeY = grid.sizeY(), sizeZ = grid.sizeZ();
+        // Seed with every empty cell on the six sides, one side per call
+        auto seed = [&](int x, int y, int z) { visit(x, y, z, grid.index(x, y, z)); };
+        if (m_side < 6)
+        {
+            switch (m_side++)
+            {
+                case 0: for (int a = 0; a < sizeX; ++a) for (int b = 0; b < sizeY; ++b) seed(a, b, 0); break;
+                case 1: for (int a = 0; a < sizeX; ++a) for (int b = 0; b < sizeY; ++b) seed(a, b, sizeZ - 1); break;
+                case 2: for (int a = 0; a < sizeX; ++a) for (int b = 0; b < sizeZ; ++b) seed(a, 0, b); break;
+                case 3: for (int a = 0; a < sizeX; ++a) for (int b = 0; b < sizeZ; ++b) seed(a, sizeY - 1, b); break;
+                case 4: for (int a = 0; a < sizeY; ++a) for (int b = 0; b < sizeZ; ++b) seed(0, a, b); break;
+                default: for (int a = 0; a < sizeY; ++a) for (int b = 0; b < sizeZ; ++b) seed(sizeX - 1, a, b); break;
+            }
+            return false;
+        }
+        for (size_t n = 0; n < budget && !m_stack.empty(); ++n)
+        {
+            uint32_t packed = m_stack.back();
+            m_stack.pop_back();
+            int x = int(packed & 1023), y = int(packed >> 10 & 1023), z = int(packed >> 20);
+            size_t next[6];
+            grid.neighbourIndices(x, y, z, next);
+            for (int d = 0; d < 6; ++d)
+            {
+                int nx = x + faceDirs[d][0], ny = y + faceDirs[d][1], nz = z + faceDirs[d][2];
+                if (grid.contains(nx, ny, nz)) visit(nx, ny, nz, next[d]);
+            }
+        }
+        if (!m_stack.empty()) return false;
+        // Occupied cells, the layout's padding is empty so the whole storage can be summed
+        const size_t end = std::min(grid.storage(), m_cell + std::min<size_t>(budget, SIZE_MAX - m_cell));
+        for (; m_cell < end; ++m_cell) m_occupied += grid.at(m_cell) != 0;
+        return m_cell == grid.storage();
+    }
+
+    // Cells that hold a voxel, duplicate records counted once
+    uint64_t occupied() const { return m_occupied; }
+    uint64_t enclosed() const { return m_grid->volume() - m_occupied - m_visited; }
+
+private:
+    void visit(int x, int y, int z, size_t i)
+    {
+        if (m_grid->at(i) == 0 && !m_reached[i]) {
+            m_reached[i] = 1;
+            ++m_visited;
+            m_stack.push_back(uint32_t(x) | uint32_t(y) << 10 | uint32_t(z) << 20);
+        }
+    }
+
+    const Grid* m_grid = nullptr;
+    std::vector<uint8_t> m_reached;
+    std::vector<uint32_t> m_stack;      // packed x | y << 10 | z << 20
+    int m_side = 0;                     // sides seeded so far
+    size_t m_cell = 0;                  // storage cells summed so far
+    uint64_t m_visited = 0, m_occupied = 0;
+};
+
+// The same in one call
+template <class Grid>
+inline uint64_t enclosedCells(const Grid& grid)
+{
+    EnclosedCounter<Grid> counter;
+    counter.begin(grid);
+    while (!counter.step()) {}
+    return counter.enclosed();
+}
+
+// One placed copy of a model after walking the scene graph
+// A voxel at v lands at rotation * (v - floor(size / 2)) + translation, which is how
+// MagicaVoxel centres a model on its transform
+struct Placement
+{
+    uint32_t model = 0;
+    int32_t rotation[3][3] = { {1,0,0}, {0,1,0}, {0,0,1} };
+    int32_t translation[3] = { 0, 0, 0 };
+    bool hidden = false;        // a transform, group or layer on the way is hidden
+};
+
+// Unpacks an nTRN _r byte into a row-major rotation matrix
+// bits 0-1: column of the non-zero entry in row 0, bits 2-3: same for row 1,
+// bits 4-6: sign of rows 0-2 (set = negative). Row 2 takes the remaining column.
+inline void decodeRotation(uint8_t packed, int32_t (&m)[3][3])
+{
+    int c0 = packed & 3, c1 = (packed >> 2) & 3;
+    if (c0 > 2 || c1 > 2 || c0 == c1) { c0 = 0; c1 = 1; } // damaged value, use identity
+    int c2 = 3 - c0 - c1;
+    int cols[3] = { c0, c1, c2 };
+    for (int r = 0; r < 3; ++r)
+    {
+        m[r][0] = m[r][1] = m[r][2] = 0;
+        m[r][cols[r]] = (packed >> (4 + r)) & 1 ? -1 : 1;
+    }
+}
+
+// Walks the scene graph from the root transform and lists every model placement
+// Files without a scene graph place each model once at the origin. Call after
+// parsing is done, the walk uses ChunkParser::nodeIndex.
+inline void scenePlacements(const ChunkParser& parser, std::vector<Placement>& out)
+{
+    out.clear();
+    if (parser.transforms.empty())
+    {
+        for (size_t m = 0; m < parser.models.size(); ++m)
+        {
+            Placement p;
+            p.model = uint32_t(m);
+            out.push_back(p);
+        }
+        return;
+    }
+
+    // Hidden layer ids, sorted for lookups
+    std::vector<int32_t> hiddenLayers;
+    for (const Layer& layer : parser.layers)
+        if (layer.hidden) hiddenLayers.push_back(layer.layerId);
+    std::sort(hiddenLayers.begin(), hiddenLayers.end());
+    auto layerHidden = [&](int32_t layerId) { return std::binary_search(hiddenLayers.begin(), hiddenLayers.end(), layerId); };
+
+    // Recursive walk over parser.nodeIndex. MagicaVoxel graphs are trees, so every node
+    // is walked at most once, which also stops cycles and repeated children in damaged
+    // files. The depth limit bounds the stack.
+    std::vector<uint8_t> visited(parser.nodeIndex.size(), 0);
+    std::function<void(int32_t, const Placement&, int)> walk = [&](int32_t nodeId, const Placement& parent, int depth) {
+        if (depth > 64) return;
+        const std::pair<size_t, size_t> range = parser.nodesWithId(nodeId);
+        for (size_t n = range.first; n < range.second; ++n)
+        {
+            if (visited[n]) continue;
+            visited[n] = 1;
+            const NodeEntry& e = parser.nodeIndex[n];
+            if (e.kind == NodeTransform)
+            {
+                const TransformNode& t = parser.transforms[e.index];
+                int32_t local[3][3];
+                decodeRotation(t.rotation, local);
+                Placement world;
+                world.hidden = parent.hidden || t.hidden || layerHidden(t.layerId);
+                for (int r = 0; r < 3; ++r)
+                {
+                    world.translation[r] = parent.translation[r];
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        world.rotation[r][c] = parent.rotation[r][0] * local[0][c] + parent.rotation[r][1] * local[1][c] + parent.rotation[r][2] * local[2][c];
+                        world.translation[r] += parent.rotation[r][c] * t.translation[c];
+                    }
+                }
+                walk(t.childId, world, depth + 1);
+            }
+            else if (e.kind == NodeGroup)
+            {
+                const GroupNode& g = parser.groups[e.index];
+                Placement group = parent;
+                group.hidden = parent.hidden || g.hidden;
+                for (uint32_t i = 0; i < g.numChildren; ++i)
+                    walk(parser.groupChildren[g.firstChild + i], group, depth + 1);
+            }
+            else
+            {
+                const ShapeNode& sh = parser.shapes[e.index];
+                for (uint32_t i = 0; i < sh.numModels; ++i)
+                {
+                    int32_t modelId = parser.shapeModels[sh.firstModel + i];
+                    if (modelId < 0 || size_t(modelId) >= parser.models.size()) continue;
+                    Placement p = parent;
+                    p.model = uint32_t(modelId);
+                    out.push_back(p);
+                }
+            }
+        }
+    };
+    walk(0, Placement(), 0);
+}
+
+}} // namespace vox2bella::vox
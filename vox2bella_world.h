@@ -0,0 +1,322 @@
+// vox2bella_world.h - Sparse world grid that several threads fill at the same time
+//
+// -em:world places every model where the scene graph puts it and merges them into one
+// world-space grid, so faces between touching models are culled and each color is a
+// single mesh for the whole scene. The placements are rasterised in parallel, one task
+// per placement, into a shared BrickMap:
+//
+// - The world is split into 8x8x8 bricks. A brick is found through an open-addressing
+//   table (linear probing) of 64-bit keys. A new brick claims an empty slot with a
+//   compare-and-swap, so inserts of different bricks never wait for each other and
+//   lookups take no lock at all.
+// - Cells are 32-bit atomics holding the placement's order (its position in the scene
+//   graph walk, plus one) and the color. A write only replaces a cell of the same or an
+//   earlier placement. The result is the same as rasterising the placements one after
+//   another in scene graph order, whatever the threads' timing, as long as each
+//   placement is written by a single thread.
+// - The table and the brick storage are sized up front from an upper bound of the
+//   bricks the placements can touch (brickBound), there is no rehashing.
+//
+// Nothing in here depends on the Bella SDK.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "vox2bella_vox.h"
+
+namespace vox2bella { namespace world {
+
+const int BrickCells = 512;    // 8x8x8, x fastest
+
+struct Brick
+{
+    std::atomic<uint32_t> cells[BrickCells];   // order << 8 | color, 0 = empty
+};
+
+// Brick coordinates of a world coordinate, rounding down for negative ones
+inline int32_t brickOf(int32_t c) { return c >= 0 ? c >> 3 : ~(~c >> 3); }
+inline int cellOf(int32_t x, int32_t y, int32_t z) { return int(uint32_t(x) & 7) | int(uint32_t(y) & 7) << 3 | int(uint32_t(z) & 7) << 6; }
+
+// A brick and where it is, for walking the map
+struct BrickRef
+{
+    int32_t bx = 0, by = 0, bz = 0;
+    const Brick* brick = nullptr;
+};
+
+class BrickMap
+{
+public:
+    // maxBricks: most distinct bricks that will ever be written
+    explicit BrickMap(size_t maxBricks)
+        : m_maxBricks(std::min<size_t>(std::max<size_t>(maxBricks, 1), UINT32_MAX - 1))
+    {
+        size_t slots = 16;
+        while (slots < m_maxBricks * 2) slots *= 2;   // at most half full
+        m_mask = slots - 1;
+        m_keys.reset(new std::atomic<uint64_t>[slots]);
+        m_index.reset(new std::atomic<uint32_t>[slots]);
+        for (size_t i = 0; i < slots; ++i) { m_keys[i].store(0, std::memory_order_relaxed); m_index[i].store(0, std::memory_order_relaxed); }
+        m_numChunks = (m_maxBricks + ChunkBricks - 1) / ChunkBricks;
+        m_chunks.reset(new std::atomic<Brick*>[m_numChunks]);
+        for (size_t i = 0; i < m_numChunks; ++i) m_chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+    ~BrickMap()
+    {
+        for (size_t i = 0; i < m_numChunks; ++i) delete[] m_chunks[i].load();
+    }
+    BrickMap(const BrickMap&) = delete;
+    BrickMap& operator=(const BrickMap&) = delete;
+
+    // Thread-safe. Returns false if more than maxBricks bricks were needed.
+    bool write(int32_t x, int32_t y, int32_t z, uint32_t order, uint8_t color)
+    {
+        Brick* brick = insert(brickOf(x), brickOf(y), brickOf(z));
+        if (!brick) return false;
+        write(*brick, cellOf(x, y, z), order, color);
+        return true;
+    }
+
+    // Thread-safe, for callers that keep the brick of consecutive writes
+    static void write(Brick& brick, int cell, uint32_t order, uint8_t color)
+    {
+        std::atomic<uint32_t>& c = brick.cells[cell];
+        const uint32_t value = order << 8 | color;
+        uint32_t old = c.load(std::memory_order_relaxed);
+        while ((old >> 8) <= order)
+            if (c.compare_exchange_weak(old, value, std::memory_order_relaxed)) break;
+    }
+
+    // The brick at brick coordinates (bx, by, bz), created if needed, nullptr when full
+    Brick* insert(int32_t bx, int32_t by, int32_t bz)
+    {
+        const uint64_t k = key(bx, by, bz);
+        for (size_t slot = hash(k) & m_mask;; slot = (slot + 1) & m_mask)
+        {
+            uint64_t found = m_keys[slot].load(std::memory_order_acquire);
+            if (found == 0)
+            {
+                if (m_used.load(std::memory_order_relaxed) >= m_maxBricks) return nullptr;
+                if (!m_keys[slot].compare_exchange_strong(found, k, std::memory_order_acq_rel)) {
+                    if (found != k) continue; // another brick took the slot, keep probing
+                } else {
+                    // The slot is ours, give it a brick
+                    size_t index = m_used.fetch_add(1, std::memory_order_relaxed);
+                    if (index >= m_maxBricks) {
+                        m_index[slot].store(Full, std::memory_order_release);
+                        return nullptr;
+                    }
+                    Brick* brick = brickAt(uint32_t(index), true);
+                    m_index[slot].store(uint32_t(index + 1), std::memory_order_release);
+                    return brick;
+                }
+            }
+            if (found == k)
+            {
+                // Claimed by another thread that may not have published its brick yet,
+                // which is only ever a few instructions away
+                uint32_t index;
+                while ((index = m_index[slot].load(std::memory_order_acquire)) == 0) {}
+                return index == Full ? nullptr : brickAt(index - 1, false);
+            }
+        }
+    }
+
+    // Lock-free lookup, nullptr if nothing was written to that brick
+    const Brick* find(int32_t bx, int32_t by, int32_t bz) const
+    {
+        const uint64_t k = key(bx, by, bz);
+        for (size_t slot = hash(k) & m_mask;; slot = (slot + 1) & m_mask)
+        {
+            uint64_t found = m_keys[slot].load(std::memory_order_acquire);
+            if (found == 0) return nullptr;
+            if (found != k) continue;
+            uint32_t index = m_index[slot].load(std::memory_order_acquire);
+            return index && index != Full ? brickAt(index - 1, false) : nullptr;
+        }
+    }
+
+    // Color at a world coordinate, 0 = empty
+    uint8_t color(int32_t x, int32_t y, int32_t z) const
+    {
+        const Brick* brick = find(brickOf(x), brickOf(y), brickOf(z));
+        return brick ? uint8_t(brick->cells[cellOf(x, y, z)].load(std::memory_order_relaxed)) : 0;
+    }
+
+    size_t bricks() const { return std::min<size_t>(m_used.load(), m_maxBricks); }
+
+    // Every brick, ordered by position (z, then y, then x) so walks don't depend on
+    // which thread inserted first. Not to be called while writes are running.
+    std::vector<BrickRef> sortedBricks() const
+    {
+        std::vector<BrickRef> out;
+        for (size_t slot = 0; slot <= m_mask; ++slot)
+        {
+            uint64_t k = m_keys[slot].load(std::memory_order_acquire);
+            uint32_t index = m_index[slot].load(std::memory_order_acquire);
+            if (k == 0 || index == 0 || index == Full) continue;
+            BrickRef ref;
+            unpack(k, ref.bx, ref.by, ref.bz);
+            ref.brick = brickAt(index - 1, false);
+            out.push_back(ref);
+        }
+        std::sort(out.begin(), out.end(), [](const BrickRef& a, const BrickRef& b) {
+            return a.bz != b.bz ? a.bz < b.bz : a.by != b.by ? a.by < b.by : a.bx < b.bx;
+        });
+        return out;
+    }
+
+private:
+    static const size_t ChunkBricks = 256;   // bricks are allocated 512 KB at a time
+    static const uint32_t Full = UINT32_MAX;  // slot claimed after the bricks ran out
+
+    // 21 bits per axis, biased so negative coordinates pack too; never 0
+    static uint64_t key(int32_t bx, int32_t by, int32_t bz)
+    {
+        const uint64_t bias = 1u << 20, mask = (1u << 21) - 1;
+        return ((uint64_t(bx + int32_t(bias)) & mask) | (uint64_t(by + int32_t(bias)) & mask) << 21
+              | (uint64_t(bz + int32_t(bias)) & mask) << 42) + 1;
+    }
+    static void unpack(uint64_t k, int32_t& bx, int32_t& by, int32_t& bz)
+    {
+        const int32_t bias = 1 << 20;
+        const uint64_t mask = (1u << 21) - 1;
+        k -= 1;
+        bx = int32_t(k & mask) - bias;
+        by = int32_t(k >> 21 & mask) - bias;
+        bz = int32_t(k >> 42 & mask) - bias;
+    }
+    static size_t hash(uint64_t k)
+    {
+        // splitmix64 finaliser, neighbouring bricks land far apart
+        k ^= k >> 30; k *= 0xbf58476d1ce4e5b9ull;
+        k ^= k >> 27; k *= 0x94d049bb133111ebull;
+        return size_t(k ^ (k >> 31));
+    }
+
+    // Bricks live in fixed chunks that are allocated by whichever thread needs one first
+    Brick* brickAt(uint32_t index, bool create) const
+    {
+        std::atomic<Brick*>& chunk = m_chunks[index / ChunkBricks];
+        Brick* bricks = chunk.load(std::memory_order_acquire);
+        if (!bricks && create)
+        {
+            Brick* fresh = new Brick[ChunkBricks];
+            for (size_t b = 0; b < ChunkBricks; ++b)
+                for (std::atomic<uint32_t>& c : fresh[b].cells) c.store(0, std::memory_order_relaxed);
+            if (chunk.compare_exchange_strong(bricks, fresh, std::memory_order_acq_rel)) bricks = fresh;
+            else delete[] fresh;
+        }
+        while (!bricks) bricks = chunk.load(std::memory_order_acquire); // being allocated
+        return &bricks[index % ChunkBricks];
+    }
+
+    size_t m_maxBricks;
+    size_t m_mask = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_keys;    // 0 = free slot
+    std::unique_ptr<std::atomic<uint32_t>[]> m_index;   // brick index + 1, 0 until published, or Full
+    std::unique_ptr<std::atomic<Brick*>[]> m_chunks;
+    size_t m_numChunks = 0;
+    std::atomic<size_t> m_used{ 0 };
+};
+
+// The voxels of one model, records in model coordinates
+struct ModelVoxels
+{
+    const uint8_t* records = nullptr;
+    uint32_t numVoxels = 0;
+    uint32_t size[3] = { 0, 0, 0 };
+};
+
+// World coordinates of the model's corner cells (0 and size - 1 on every axis)
+inline void placedBounds(const vox::Placement& p, const ModelVoxels& model, int32_t (&lo)[3], int32_t (&hi)[3])
+{
+    for (int r = 0; r < 3; ++r)
+    {
+        lo[r] = hi[r] = p.translation[r];
+        for (int c = 0; c < 3; ++c)
+        {
+            int32_t pivot = int32_t(model.size[c] / 2);
+            int32_t a = p.rotation[r][c] * (0 - pivot), b = p.rotation[r][c] * (int32_t(model.size[c]) - 1 - pivot);
+            lo[r] += std::min(a, b);
+            hi[r] += std::max(a, b);
+        }
+    }
+}
+
+// Most bricks one placement can touch: the bricks of its box, or one per voxel
+inline size_t brickBound(const vox::Placement& p, const ModelVoxels& model)
+{
+    if (model.numVoxels == 0) return 0;
+    int32_t lo[3], hi[3];
+    placedBounds(p, model, lo, hi);
+    size_t box = 1;
+    for (int a = 0; a < 3; ++a) box *= size_t(brickOf(hi[a]) - brickOf(lo[a]) + 1);
+    return std::min<size_t>(box, model.numVoxels);
+}
+
+// Writes one placement of a model into the map. 'order' is the placement's position in
+// the scene graph walk plus one. Returns false if the map ran out of bricks.
+// A voxel at v lands at rotation * (v - floor(size / 2)) + translation, see vox::Placement.
+inline bool rasterise(BrickMap& map, const vox::Placement& p, uint32_t order, const ModelVoxels& model)
+{
+    const int32_t pivot[3] = { int32_t(model.size[0] / 2), int32_t(model.size[1] / 2), int32_t(model.size[2] / 2) };
+    Brick* brick = nullptr;
+    int32_t cached[3] = { 0, 0, 0 };
+    for (uint32_t i = 0; i < model.numVoxels; ++i)
+    {
+        const uint8_t* v = model.records + size_t(i) * 4;
+        int32_t w[3], b[3];
+        for (int r = 0; r < 3; ++r)
+        {
+            w[r] = p.translation[r] + p.rotation[r][0] * (v[0] - pivot[0]) + p.rotation[r][1] * (v[1] - pivot[1])
+                 + p.rotation[r][2] * (v[2] - pivot[2]);
+            b[r] = brickOf(w[r]);
+        }
+        // Consecutive records are usually in the same brick
+        if (!brick || b[0] != cached[0] || b[1] != cached[1] || b[2] != cached[2])
+        {
+            brick = map.insert(b[0], b[1], b[2]);
+            if (!brick) return false;
+            std::copy(b, b + 3, cached);
+        }
+        BrickMap::write(*brick, cellOf(w[0], w[1], w[2]), order, v[3]);
+    }
+    return true;
+}
+
+// Calls fn(x, y, z, color, face) for every face of a voxel in 'ref' whose neighbour is
+// empty, faces as in vox::faceDirs. Not to be called while writes are running.
+template <class Fn>
+inline void exposedFaces(const BrickMap& map, const BrickRef& ref, Fn fn)
+{
+    // The six neighbouring bricks, looked up once
+    const Brick* next[6];
+    for (int d = 0; d < 6; ++d)
+        next[d] = map.find(ref.bx + vox::faceDirs[d][0], ref.by + vox::faceDirs[d][1], ref.bz + vox::faceDirs[d][2]);
+    auto colorAt = [](const Brick* b, int cell) { return b ? uint8_t(b->cells[cell].load(std::memory_order_relaxed)) : uint8_t(0); };
+
+    for (int cell = 0; cell < BrickCells; ++cell)
+    {
+        const uint8_t color = colorAt(ref.brick, cell);
+        if (color == 0) continue;
+        const int c[3] = { cell & 7, cell >> 3 & 7, cell >> 6 };
+        for (int d = 0; d < 6; ++d)
+        {
+            int n[3] = { c[0] + vox::faceDirs[d][0], c[1] + vox::faceDirs[d][1], c[2] + vox::faceDirs[d][2] };
+            bool inside = n[0] >= 0 && n[0] < 8 && n[1] >= 0 && n[1] < 8 && n[2] >= 0 && n[2] < 8;
+            const Brick* b = inside ? ref.brick : next[d];
+            int ncell = (n[0] & 7) | (n[1] & 7) << 3 | (n[2] & 7) << 6;
+            if (colorAt(b, ncell) == 0)
+                fn(ref.bx * 8 + c[0], ref.by * 8 + c[1], ref.bz * 8 + c[2], color, d);
+        }
+    }
+}
+
+}} // namespace vox2bella::world